@@ -1,7 +1,9 @@
 #include <dirent.h>
 #include <stdlib.h>
+#include <sched.h>
+#include <time.h>
 
-#include "etask_tree.h"
+#include "eraft_utils.h"
 #include "eraft_taskis.h"
 #include "eraft_api.h"
 #include "liblogger.h"
@@ -41,22 +43,78 @@ struct eraft_group *erapi_add_group(struct eraft_context *ctx, char *cluster, in
 	char *db_path, int db_size,
 	ERAFT_LOG_APPLY_WFCB wfcb, ERAFT_LOG_APPLY_RFCB rfcb)
 {
-	struct eraft_evts *evts = &ctx->evts;
+	return erapi_add_group_with_snapshot(ctx, cluster, selfidx, db_path, db_size, wfcb, rfcb, NULL, NULL);
+}
 
-	struct eraft_group *group = eraft_group_make(cluster, selfidx, db_path, db_size, wfcb, rfcb);
+struct eraft_group *erapi_add_group_with_snapshot(struct eraft_context *ctx, char *cluster, int selfidx,
+	char *db_path, int db_size,
+	ERAFT_LOG_APPLY_WFCB wfcb, ERAFT_LOG_APPLY_RFCB rfcb,
+	ERAFT_SNAPSHOT_SAVE_FCB save_fcb, ERAFT_SNAPSHOT_LOAD_FCB load_fcb)
+{
+	struct erapi_group_args args = {
+		.cluster        = cluster,
+		.selfidx        = selfidx,
+		.db_path        = db_path,
+		.db_size        = db_size,
+		.wfcb           = wfcb,
+		.rfcb           = rfcb,
+		.save_fcb       = save_fcb,
+		.load_fcb       = load_fcb,
+	};
+	struct eraft_group *group = NULL;
+
+	erapi_add_groups(ctx, &args, 1, &group);
+	return group;
+}
 
-	group->evts = evts;
+int erapi_add_groups(struct eraft_context *ctx, struct erapi_group_args *args, int count, struct eraft_group **groups)
+{
+	struct eraft_evts       *evts = &ctx->evts;
+	struct timespec         begin, end;
 
-	struct etask                    *etask = etask_make(NULL);
-	struct eraft_taskis_group_add   *task = eraft_taskis_group_add_make(cluster, eraft_evts_dispose_dotask, evts, group, etask);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
 
-	eraft_tasker_once_give(&evts->tasker, (struct eraft_dotask *)task);
+	/*各group在日志线程中并行打开日志和恢复状态*/
+	struct eraft_taskis_group_load **loads = calloc(count, sizeof(*loads));
 
-	etask_sleep(etask);
-	etask_free(etask);
+	for (int i = 0; i < count; i++) {
+		struct erapi_group_args *arg = &args[i];
 
-	eraft_taskis_group_add_free(task);
-	return group;
+		loads[i] = eraft_taskis_group_load_make(arg->cluster, eraft_evts_dispose_dotask, evts,
+				arg->selfidx, arg->db_path, arg->db_size, arg->wfcb, arg->rfcb,
+				arg->save_fcb, arg->load_fcb, etask_make(NULL));
+
+		eraft_evts_load_group(evts, (struct eraft_dotask *)loads[i]);
+	}
+
+	for (int i = 0; i < count; i++) {
+		etask_sleep(loads[i]->etask);
+		etask_free(loads[i]->etask);
+
+		groups[i] = loads[i]->group;
+		eraft_taskis_group_load_free(loads[i]);
+	}
+
+	free(loads);
+
+	/*加入raft线程*/
+	for (int i = 0; i < count; i++) {
+		struct etask                    *etask = etask_make(NULL);
+		struct eraft_taskis_group_add   *task = eraft_taskis_group_add_make(args[i].cluster, eraft_evts_dispose_dotask, evts, groups[i], etask);
+
+		eraft_tasker_once_give(&evts->tasker, (struct eraft_dotask *)task);
+
+		etask_sleep(etask);
+		etask_free(etask);
+
+		eraft_taskis_group_add_free(task);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("%d groups restart in %ld ms\n", count,
+		(end.tv_sec - begin.tv_sec) * 1000 + (end.tv_nsec - begin.tv_nsec) / 1000000);
+	return 0;
 }
 
 void erapi_del_group(struct eraft_context *ctx, char *cluster)
@@ -75,45 +133,153 @@ void erapi_del_group(struct eraft_context *ctx, char *cluster)
 }
 
 int erapi_write_request(struct eraft_context *ctx, char *cluster, struct iovec *request)
+{
+	return erapi_write_requests_twait(ctx, cluster, request, 1, -1);
+}
+
+int erapi_write_requests(struct eraft_context *ctx, char *cluster, struct iovec *requests, int count)
+{
+	return erapi_write_requests_twait(ctx, cluster, requests, count, -1);
+}
+
+int erapi_write_request_twait(struct eraft_context *ctx, char *cluster, struct iovec *request, int msec)
+{
+	return erapi_write_requests_twait(ctx, cluster, request, 1, msec);
+}
+
+/*超时后交出任务,返回false表示已完成,需要等待唤醒*/
+static bool __request_write_detach(struct eraft_taskis_request_write *task, int *result)
+{
+	while (1) {
+		/*还未加入日志,raft线程会丢弃*/
+		if (ATOMIC_CASB(&task->state, ERAFT_REQUEST_PENDING, ERAFT_REQUEST_DETACHED)) {
+			*result = ERAFT_ERR_TIME_OUT;
+			return true;
+		}
+
+		/*已加入日志,结果未知*/
+		if (ATOMIC_CASB(&task->state, ERAFT_REQUEST_SUBMITTED, ERAFT_REQUEST_DETACHED)) {
+			*result = ERAFT_ERR_IN_DOUBT;
+			return true;
+		}
+
+		if (ATOMIC_GET(&task->state) == ERAFT_REQUEST_DONE) {
+			return false;
+		}
+
+		/*raft线程正在复制请求数据,很快结束*/
+		sched_yield();
+	}
+}
+
+int erapi_write_requests_twait(struct eraft_context *ctx, char *cluster, struct iovec *requests, int count, int msec)
 {
 	struct eraft_evts                       *evts = &ctx->evts;
 	struct etask                            *etask = etask_make(NULL);
-	struct eraft_taskis_request_write       *task = eraft_taskis_request_write_make(cluster, eraft_evts_dispose_dotask, evts, request, etask);
+	struct eraft_taskis_request_write       *task = eraft_taskis_request_write_make(cluster, eraft_evts_dispose_dotask, evts, requests, NULL, count, etask, NULL, NULL);
 
 	eraft_tasker_once_give(&evts->tasker, (struct eraft_dotask *)task);
 
-	etask_sleep(etask);
-	etask_free(etask);
+	/* When we receive an request from the client we need to block until the
+	 * request has been committed or failed. */
+	if (msec < 0) {
+		etask_sleep(etask);
+	} else if (!etask_twait(etask, msec)) {
+		int result = 0;
 
-	int result = eraft_errno_by_raft(task->result);
+		/*task和etask由raft线程回收*/
+		if (__request_write_detach(task, &result)) {
+			return result;
+		}
 
-	if (result == 0) {
-		/* When we receive an request from the client we need to block until the
-		 * request has been committed. This efd is used to wake us up. */
-		int ret = etask_tree_await_task(evts->wait_idx_tree, &task->idx, sizeof(task->idx), task->efd, -1);
-		assert(ret == 0);
+		etask_sleep(etask);
 	}
 
-	result = eraft_errno_by_raft(task->result);
+	etask_free(etask);
+
+	int result = task->result;
 
 	eraft_taskis_request_write_free(task);
 	return result;
 }
 
+int erapi_write_request_async(struct eraft_context *ctx, char *cluster, struct iovec *request, ERAFT_WRITE_DONE_FCB fcb, void *usr)
+{
+	return erapi_write_requests_async(ctx, cluster, request, 1, fcb, usr);
+}
+
+int erapi_write_requests_async(struct eraft_context *ctx, char *cluster, struct iovec *requests, int count, ERAFT_WRITE_DONE_FCB fcb, void *usr)
+{
+	assert(fcb);
+
+	struct eraft_evts                       *evts = &ctx->evts;
+	struct eraft_taskis_request_write       *task = eraft_taskis_request_write_make(cluster, eraft_evts_dispose_dotask, evts, requests, NULL, count, NULL, fcb, usr);
+
+	eraft_tasker_once_give(&evts->tasker, (struct eraft_dotask *)task);
+	return 0;
+}
+
+int erapi_write_iobufs_async(struct eraft_context *ctx, char *cluster, struct eraft_iobuf **iobufs, int count, ERAFT_WRITE_DONE_FCB fcb, void *usr)
+{
+	assert(fcb);
+
+	struct eraft_evts                       *evts = &ctx->evts;
+	struct eraft_taskis_request_write       *task = eraft_taskis_request_write_make(cluster, eraft_evts_dispose_dotask, evts, NULL, iobufs, count, NULL, fcb, usr);
+
+	eraft_tasker_once_give(&evts->tasker, (struct eraft_dotask *)task);
+	return 0;
+}
+
 int erapi_read_request(struct eraft_context *ctx, char *cluster, struct iovec *request)
+{
+	return erapi_read_request_arena(ctx, cluster, request, NULL, NULL, -1);
+}
+
+int erapi_read_request_twait(struct eraft_context *ctx, char *cluster, struct iovec *request, int msec)
+{
+	return erapi_read_request_arena(ctx, cluster, request, NULL, NULL, msec);
+}
+
+int erapi_read_request_arena(struct eraft_context *ctx, char *cluster, struct iovec *request,
+	struct eraft_arena *arena, struct iovec *response, int msec)
 {
 	struct eraft_evts                       *evts = &ctx->evts;
 	struct etask                            *etask = etask_make(NULL);
-	struct eraft_taskis_request_read        *task = eraft_taskis_request_read_make(cluster, eraft_evts_dispose_dotask, evts, request, etask);
+	struct eraft_taskis_request_read        *task = eraft_taskis_request_read_make(cluster, eraft_evts_dispose_dotask, evts, request, arena, etask);
+
+	if (response) {
+		response->iov_base = NULL;
+		response->iov_len = 0;
+	}
 
 	eraft_tasker_once_give(&evts->tasker, (struct eraft_dotask *)task);
 
-	etask_sleep(etask);
+	if (msec < 0) {
+		etask_sleep(etask);
+	} else if (!etask_twait(etask, msec)) {
+		/*读回调开始前都可取消,task和etask由raft线程或应用线程回收*/
+		if (ATOMIC_CASB(&task->state, ERAFT_REQUEST_PENDING, ERAFT_REQUEST_DETACHED) ||
+			ATOMIC_CASB(&task->state, ERAFT_REQUEST_MERGING, ERAFT_REQUEST_DETACHED)) {
+			return ERAFT_ERR_TIME_OUT;
+		}
+
+		/*读回调正在使用request,等待完成*/
+		etask_sleep(etask);
+	}
+
 	etask_free(etask);
 
 	int result = eraft_errno_by_raft(task->result);
 
+	if (response && (result == 0)) {
+		*response = task->response;
+	}
+
 	eraft_taskis_request_read_free(task);
 	return result;
 }
 
+void erapi_get_slab_stat(struct eraft_slab_stat *stat)
+{
+	eraft_slab_get_stat(stat);
+}
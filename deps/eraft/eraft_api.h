@@ -3,6 +3,8 @@
 #include "eraft_errno.h"
 #include "eraft_confs.h"
 #include "eraft_context.h"
+#include "eraft_iobuf.h"
+#include "eraft_slab.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,6 +26,30 @@ struct eraft_group      *erapi_add_group(struct eraft_context *ctx, char *cluste
 	char *db_path, int db_size,
 	ERAFT_LOG_APPLY_WFCB wfcb, ERAFT_LOG_APPLY_RFCB rfcb);
 
+/*
+ * 加载或创建一个带状态机快照的eraft group.
+ * 加载时先用最新的快照恢复状态机, 之后定期在应用线程中生成快照并删除之前的日志.
+ */
+struct eraft_group      *erapi_add_group_with_snapshot(struct eraft_context *ctx, char *cluster, int selfidx,
+	char *db_path, int db_size,
+	ERAFT_LOG_APPLY_WFCB wfcb, ERAFT_LOG_APPLY_RFCB rfcb,
+	ERAFT_SNAPSHOT_SAVE_FCB save_fcb, ERAFT_SNAPSHOT_LOAD_FCB load_fcb);
+
+struct erapi_group_args
+{
+	char                    *cluster;
+	int                     selfidx;
+	char                    *db_path;
+	int                     db_size;
+	ERAFT_LOG_APPLY_WFCB    wfcb;
+	ERAFT_LOG_APPLY_RFCB    rfcb;
+	ERAFT_SNAPSHOT_SAVE_FCB save_fcb;	/*不使用快照时为NULL*/
+	ERAFT_SNAPSHOT_LOAD_FCB load_fcb;
+};
+
+/* 批量加载或创建eraft group, 在日志线程中并行打开, 结果按顺序写入groups */
+int erapi_add_groups(struct eraft_context *ctx, struct erapi_group_args *args, int count, struct eraft_group **groups);
+
 /* 删除一个eraft group */
 void erapi_del_group(struct eraft_context *ctx, char *cluster);
 
@@ -32,17 +58,86 @@ void erapi_del_group(struct eraft_context *ctx, char *cluster);
  * errno:
  *      ERAFT_ERR_NOT_LEADER
  *      ERAFT_ERR_TIME_OUT
+ *      ERAFT_ERR_IN_DOUBT      提交前leader切换或group删除, 可能提交也可能丢弃
  */
 int erapi_write_request(struct eraft_context *ctx, char *cluster, struct iovec *request);
 
 /*
- * 读数据
+ * 限时写数据, msec为等待毫秒数, 小于0时一直等待.
+ * 超时后请求由raft线程回收, request可立即释放.
+ * errno:
+ *      ERAFT_ERR_NOT_LEADER
+ *      ERAFT_ERR_TIME_OUT      未写入日志, 确定失败
+ *      ERAFT_ERR_IN_DOUBT      已写入日志, 可能提交也可能丢弃
+ */
+int erapi_write_request_twait(struct eraft_context *ctx, char *cluster, struct iovec *request, int msec);
+
+/*
+ * 异步写数据, 不阻塞调用线程.
+ * 提交或失败时在raft线程中调用fcb, fcb内不可阻塞.
+ * request在fcb被调用前必须保持有效.
+ * fcb result:
+ *      ERAFT_ERR_NOT_LEADER
+ *      ERAFT_ERR_IN_DOUBT
+ */
+int erapi_write_request_async(struct eraft_context *ctx, char *cluster, struct iovec *request, ERAFT_WRITE_DONE_FCB fcb, void *usr);
+
+/*
+ * 批量写数据, count条数据作为一个任务提交, 写入连续的日志并共用一次完成通知.
+ * 全部提交后返回.
+ * errno:
+ *      ERAFT_ERR_NOT_LEADER
+ *      ERAFT_ERR_TIME_OUT
+ *      ERAFT_ERR_IN_DOUBT
+ */
+int erapi_write_requests(struct eraft_context *ctx, char *cluster, struct iovec *requests, int count);
+
+/*
+ * 限时批量写数据, 超时语义同erapi_write_request_twait.
+ */
+int erapi_write_requests_twait(struct eraft_context *ctx, char *cluster, struct iovec *requests, int count, int msec);
+
+/*
+ * 异步批量写数据, fcb的idx为最后一条数据的日志索引.
+ */
+int erapi_write_requests_async(struct eraft_context *ctx, char *cluster, struct iovec *requests, int count, ERAFT_WRITE_DONE_FCB fcb, void *usr);
+
+/*
+ * 零拷贝异步批量写数据, 接管每个iobuf的一个引用, iobufs数组调用后即可复用.
+ * 缓冲区在日志, 落盘和网络发送中共享, 不再使用时通过iobuf的fcb释放.
+ * fcb的request为NULL.
+ */
+int erapi_write_iobufs_async(struct eraft_context *ctx, char *cluster, struct eraft_iobuf **iobufs, int count, ERAFT_WRITE_DONE_FCB fcb, void *usr);
+
+/*
+ * 读数据, leader和follower都可以读.
+ * follower向leader查询确认过的commit_idx, 本地应用到该位置后执行读回调.
  * errno:
  *      ERAFT_ERR_NOT_LEADER
  *      ERAFT_ERR_TIME_OUT
  */
 int erapi_read_request(struct eraft_context *ctx, char *cluster, struct iovec *request);
 
+/*
+ * 限时读数据, 读回调开始执行前的读请求超时即取消, 包括等待leader确认或本地应用的读;
+ * 读回调已开始执行时等待其完成.
+ * errno:
+ *      ERAFT_ERR_NOT_LEADER
+ *      ERAFT_ERR_TIME_OUT      未执行读回调
+ */
+int erapi_read_request_twait(struct eraft_context *ctx, char *cluster, struct iovec *request, int msec);
+
+/*
+ * 读数据并取回结果, 读回调从arena分配内存写入结果, 不再复制.
+ * 返回0时response指向arena中的数据, 读回调未填写时为空.
+ * 超时语义同erapi_read_request_twait, 超时返回后arena不会再被使用.
+ */
+int erapi_read_request_arena(struct eraft_context *ctx, char *cluster, struct iovec *request,
+	struct eraft_arena *arena, struct iovec *response, int msec);
+
+/* 获取任务对象的分配计数 */
+void erapi_get_slab_stat(struct eraft_slab_stat *stat);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 调用者提供的内存区, 读回调从中分配响应数据, 结果不再复制.
+ * 只追加分配, 读返回后由调用者整体重置复用.
+ */
+struct eraft_arena
+{
+	char    *base;
+	size_t  size;
+	size_t  used;
+};
+
+static inline void eraft_arena_init(struct eraft_arena *arena, void *base, size_t size)
+{
+	arena->base = base;
+	arena->size = size;
+	arena->used = 0;
+}
+
+static inline void eraft_arena_reset(struct eraft_arena *arena)
+{
+	arena->used = 0;
+}
+
+/* 按8字节对齐分配, 空间不足返回NULL */
+static inline void *eraft_arena_alloc(struct eraft_arena *arena, size_t size)
+{
+	if (!arena) {
+		return NULL;
+	}
+
+	size_t off = (arena->used + 7) & ~(size_t)7;
+
+	if ((off > arena->size) || (size > arena->size - off)) {
+		return NULL;
+	}
+
+	arena->used = off + size;
+	return arena->base + off;
+}
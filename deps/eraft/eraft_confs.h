@@ -7,7 +7,29 @@
 
 #define MAX_GROUP_IDENTITY_LEN  128
 
+#define MAX_RETAIN_WINDOW       32	/*每个group同时落盘的最大批次数*/
+#define DEFAULT_RETAIN_WINDOW   4
+
+#define DEFAULT_BATCH_MAX_ENTRIES       1024		/*单次合并的最大日志条数*/
+#define DEFAULT_BATCH_MAX_BYTES         (4 << 20)	/*单次合并的最大字节数*/
+#define DEFAULT_BATCH_LINGER_USEC       200		/*凑批的最长等待时间*/
+
+#define DEFAULT_LEASE_DRIFT_MSEC        200		/*租约读的时钟漂移余量*/
+
+#define DEFAULT_JOURNAL_SEGMENT_SIZE    (64 << 20)	/*默认日志存储的段文件大小*/
+#define DEFAULT_JOURNAL_BLOCK_SIZE      4096		/*O_DIRECT写入的对齐大小*/
+#define DEFAULT_JOURNAL_SPARE_SEGMENTS  4		/*保留复用的空闲段文件个数*/
+#define DEFAULT_JOURNAL_TRIM_STEP       10000		/*已应用的日志每满此条数删除一次*/
+#define DEFAULT_JOURNAL_TRIM_RETAIN     10000		/*删除时保留最近已应用的日志条数,供落后的follower追赶*/
+#define DEFAULT_SNAPSHOT_STEP           100000		/*距上次快照应用满此条数后生成新快照*/
+#define DEFAULT_SNAPSHOT_CHUNK_SIZE     (1 << 20)	/*InstallSnapshot每次发送的字节数*/
+#define DEFAULT_IOURING_ENTRIES         256		/*io_uring提交队列长度*/
+#define DEFAULT_JOURNAL_TYPE            ERAFT_JOURNAL_TYPE_BDB	/*group使用的日志存储*/
+
 // #define JUST_FOR_TEST
 // #define TEST_NETWORK_ONLY
 #define USE_LIBEVCORO
+#define USE_PARALLEL_RETAIN	/*leader落盘与复制给follower并行*/
+#define USE_READ_INDEX		/*读请求通过一轮心跳确认leader身份,不经过日志*/
+#define USE_JOURNAL_DIRECT	/*默认日志存储以O_DIRECT写入,文件系统不支持时自动关闭*/
 
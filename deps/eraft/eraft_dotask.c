@@ -1,4 +1,5 @@
 #include "eraft_dotask.h"
+#include "eraft_slab.h"
 
 void eraft_dotask_init(struct eraft_dotask *task, int type, char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr)
 {
@@ -6,13 +7,13 @@ void eraft_dotask_init(struct eraft_dotask *task, int type, char *identity, ERAF
 	task->type = type;
 
 	/*设置属性*/
-	task->identity = strdup(identity);
+	task->identity = eraft_slab_strdup(identity);
 	task->_fcb = _fcb;
 	task->_usr = _usr;
 }
 
 void eraft_dotask_free(struct eraft_dotask *task)
 {
-	free(task->identity);
+	eraft_slab_free(task->identity);
 }
 
@@ -4,7 +4,8 @@ enum
 {
 	ERAFT_ERR_NOT_LEADER = -2,	/* 本节点不是leader */
 	ERAFT_ERR_SNAPSHOT_IN_PROGRESS = -3,
-	ERAFT_ERR_TIME_OUT = -4,	/* 请求超时 */
+	ERAFT_ERR_TIME_OUT = -4,	/* 请求超时,请求未执行 */
+	ERAFT_ERR_IN_DOUBT = -5,	/* 请求超时,日志已写入,可能提交也可能丢弃 */
 };
 
 int eraft_errno_by_raft(int err);
@@ -1,7 +1,7 @@
-#include "etask_tree.h"
 #include "eraft_evts.h"
 #include "eraft_taskis.h"
 #include "eraft_confs.h"
+#include "eraft_errno.h"
 
 typedef enum
 {
@@ -27,6 +27,15 @@ typedef enum
 	MSG_REQUESTVOTE_RESPONSE,
 	MSG_APPENDENTRIES,
 	MSG_APPENDENTRIES_RESPONSE,
+	/* ReadIndex heartbeat, confirm leadership without touching the log */
+	MSG_READINDEX,
+	MSG_READINDEX_RESPONSE,
+	/* Follower read, ask leader for a confirmed commit index */
+	MSG_COMMITIDX,
+	MSG_COMMITIDX_RESPONSE,
+	/* InstallSnapshot chunk, the snapshot data follows the message */
+	MSG_SNAPSHOT,
+	MSG_SNAPSHOT_RESPONSE,
 } peer_message_type_e;
 
 #include "eraft_network.h"
@@ -70,6 +79,12 @@ typedef struct
 		msg_requestvote_response_t      rvr;
 		msg_appendentries_t             ae;
 		msg_appendentries_response_t    aer;
+		msg_readindex_t                 ri;
+		msg_readindex_response_t        rir;
+		msg_commitidx_t                 ci;
+		msg_commitidx_response_t        cir;
+		msg_snapshot_t                  sn;
+		msg_snapshot_response_t         snr;
 	};
 	int     padding[100];
 } msg_t;
@@ -83,6 +98,67 @@ typedef struct
 	char    host[IPV4_HOST_LEN];
 } entry_cfg_change_t;
 
+#ifdef USE_PARALLEL_RETAIN
+static void __retain_replicate(struct eraft_group *group);
+static void __retain_retry(struct eraft_group *group);
+#endif
+#ifdef USE_READ_INDEX
+static void __read_index_periodic(struct eraft_group *group);
+#endif
+
+/*落盘窗口已满时排队的配置变更日志*/
+struct cfg_wait
+{
+	struct list_node                        node;
+	raft_batch_t                            *batch;
+	struct eraft_taskis_request_write       *object;
+};
+
+static int __cfg_change_retain(struct eraft_group *group, raft_batch_t *bat, struct eraft_taskis_request_write *object)
+{
+	int e = raft_retain_entries(group->raft, bat, object);	// FIXME: raft thread may hung by this.
+
+	if (0 != e) {
+		return -1;
+	}
+
+#ifdef USE_PARALLEL_RETAIN
+	__retain_replicate(group);
+#endif
+
+	return 0;
+}
+
+/*窗口空出后优先加入排队的配置变更*/
+static void __cfg_wait_flush(struct eraft_group *group)
+{
+	while (!list_empty(&group->cfg_wait_list) && (group->retain_ring.count < MAX_RETAIN_WINDOW)) {
+		struct cfg_wait *wait = list_first_entry(&group->cfg_wait_list, struct cfg_wait, node);
+
+		list_del(&wait->node);
+
+		if (__cfg_change_retain(group, wait->batch, wait->object) != 0) {
+			printf("cfg failed!\n");
+		}
+
+		free(wait);
+	}
+}
+
+static void __cfg_wait_clean(struct eraft_group *group)
+{
+	while (!list_empty(&group->cfg_wait_list)) {
+		struct cfg_wait *wait = list_first_entry(&group->cfg_wait_list, struct cfg_wait, node);
+
+		list_del(&wait->node);
+		raft_entry_free(raft_batch_take_entry(wait->batch, 0));
+		raft_batch_free(wait->batch);
+		etask_free(wait->object->etask);
+		eraft_taskis_request_write_free(wait->object);
+		free(wait);
+	}
+}
+
 static int __append_cfg_change(struct eraft_group *group,
 	raft_logtype_e change_type,
 	char *host,
@@ -111,16 +187,22 @@ static int __append_cfg_change(struct eraft_group *group,
 	raft_batch_join_entry(bat, 0, ety);
 
 	struct etask                            *etask = etask_make(NULL);
-	struct eraft_taskis_request_write       *object = eraft_taskis_request_write_make(group->identity, eraft_evts_dispose_dotask, evts, &request, etask);
-	int                                     e = raft_retain_entries(group->raft, bat, object);	// FIXME: raft thread may hung by this.
-	// etask_sleep(etask);
-	// etask_free(etask);
+	struct eraft_taskis_request_write       *object = eraft_taskis_request_write_make(group->identity, eraft_evts_dispose_dotask, evts, &request, NULL, 1, etask, NULL, NULL);
 
-	if (0 != e) {
-		return -1;
+	/*无人等待,完成时释放*/
+	object->state = ERAFT_REQUEST_DETACHED;
+
+	/*与写请求共用落盘窗口,窗口已满或已有排队时按顺序等待*/
+	if ((group->retain_ring.count >= MAX_RETAIN_WINDOW) || !list_empty(&group->cfg_wait_list)) {
+		struct cfg_wait *wait = calloc(1, sizeof(*wait));
+
+		wait->batch = bat;
+		wait->object = object;
+		list_add_tail(&wait->node, &group->cfg_wait_list);
+		return 0;
 	}
 
-	return 0;
+	return __cfg_change_retain(group, bat, object);
 }
 
 int __raft_log_get_node_id(
@@ -358,6 +440,54 @@ static int _on_transmit_fcb(eraft_connection_t *conn, char *data, uint64_t size,
 		}
 		break;
 
+		case MSG_READINDEX:
+		{
+			struct eraft_taskis_net_readindex *task = eraft_taskis_net_readindex_make(group->identity, eraft_evts_dispose_dotask, evts, &m.ri, node);
+			eraft_tasker_once_give(&evts->tasker, (struct eraft_dotask *)task);
+		}
+		break;
+
+		case MSG_READINDEX_RESPONSE:
+		{
+			struct eraft_taskis_net_readindex_response *task = eraft_taskis_net_readindex_response_make(group->identity, eraft_evts_dispose_dotask, evts, &m.rir, node);
+			eraft_tasker_once_give(&evts->tasker, (struct eraft_dotask *)task);
+		}
+		break;
+
+		case MSG_COMMITIDX:
+		{
+			struct eraft_taskis_net_commitidx *task = eraft_taskis_net_commitidx_make(group->identity, eraft_evts_dispose_dotask, evts, &m.ci, node);
+			eraft_tasker_once_give(&evts->tasker, (struct eraft_dotask *)task);
+		}
+		break;
+
+		case MSG_COMMITIDX_RESPONSE:
+		{
+			struct eraft_taskis_net_commitidx_response *task = eraft_taskis_net_commitidx_response_make(group->identity, eraft_evts_dispose_dotask, evts, &m.cir, node);
+			eraft_tasker_once_give(&evts->tasker, (struct eraft_dotask *)task);
+		}
+		break;
+
+		case MSG_SNAPSHOT:
+		{
+			if (size < sizeof(msg_t) + m.sn.len) {
+				printf("snapshot chunk truncated\n");
+				break;
+			}
+
+			/*与appendentries同一队列,保持顺序*/
+			struct eraft_taskis_net_snapshot *task = eraft_taskis_net_snapshot_make(group->identity, eraft_evts_dispose_dotask, evts, &m.sn, data + sizeof(msg_t), node);
+			eraft_tasker_each_give(&group->peer_tasker, (struct eraft_dotask *)task);
+		}
+		break;
+
+		case MSG_SNAPSHOT_RESPONSE:
+		{
+			struct eraft_taskis_net_snapshot_response *task = eraft_taskis_net_snapshot_response_make(group->identity, eraft_evts_dispose_dotask, evts, &m.snr, node);
+			eraft_tasker_once_give(&evts->tasker, (struct eraft_dotask *)task);
+		}
+		break;
+
 		default:
 			printf("unknown msg\n");
 			exit(0);
@@ -365,6 +495,93 @@ static int _on_transmit_fcb(eraft_connection_t *conn, char *data, uint64_t size,
 	return 0;
 }
 
+/*term和voted_for落盘前缓存的消息*/
+struct meta_wait
+{
+	struct list_node        node;
+	eraft_connection_t      *conn;
+	msg_t                   msg;
+};
+
+static void __log_journal_give(struct eraft_group *group, struct eraft_dotask *task);
+static void __snapshot_apply_give(struct eraft_group *group, struct eraft_dotask *task);
+
+/*交给日志线程写入当前的term,voted_for和commit_idx,同一轮处理中的多次修改合并为一次写入*/
+static void __meta_save_give(struct eraft_group *group)
+{
+	struct eraft_meta *meta = &group->meta;
+
+	if (meta->saving) {
+		return;
+	}
+
+	struct eraft_taskis_meta_save *object = eraft_taskis_meta_save_make(group->identity, eraft_evts_dispose_dotask, group->evts,
+			group->evts, dup(meta->fd), meta->seq + 1, meta->term, meta->voted_for, meta->commit_idx);
+
+	meta->pending = meta->dirty;
+	meta->dirty = false;
+	meta->saving = true;
+	__log_journal_give(group, (struct eraft_dotask *)object);
+}
+
+static bool __meta_durable(struct eraft_group *group)
+{
+	return !group->meta.dirty && !group->meta.pending;
+}
+
+/*term和voted_for落盘后才能发出消息,之前的消息按顺序缓存*/
+static void __transmit_durable(struct eraft_group *group, eraft_connection_t *conn, msg_t *msg)
+{
+	struct eraft_evts *evts = group->evts;
+
+	if (__meta_durable(group)) {
+		struct iovec bufs[1];
+		bufs[0].iov_base = (char *)msg;
+		bufs[0].iov_len = sizeof(msg_t);
+		eraft_network_transmit_connection(&evts->network, conn, bufs, 1);
+		return;
+	}
+
+	struct meta_wait *wait = malloc(sizeof(*wait));
+
+	wait->conn = conn;
+	wait->msg = *msg;
+	list_add_tail(&wait->node, &group->meta_wait_list);
+
+	__meta_save_give(group);
+}
+
+/*落盘完成,发送缓存的消息*/
+static void __meta_wait_flush(struct eraft_group *group)
+{
+	struct eraft_evts *evts = group->evts;
+
+	while (!list_empty(&group->meta_wait_list)) {
+		struct meta_wait *wait = list_first_entry(&group->meta_wait_list, struct meta_wait, node);
+
+		list_del(&wait->node);
+
+		if (eraft_network_usable_connection(&evts->network, wait->conn)) {
+			struct iovec bufs[1];
+			bufs[0].iov_base = (char *)&wait->msg;
+			bufs[0].iov_len = sizeof(msg_t);
+			eraft_network_transmit_connection(&evts->network, wait->conn, bufs, 1);
+		}
+
+		free(wait);
+	}
+}
+
+static void __meta_wait_clean(struct eraft_group *group)
+{
+	while (!list_empty(&group->meta_wait_list)) {
+		struct meta_wait *wait = list_first_entry(&group->meta_wait_list, struct meta_wait, node);
+
+		list_del(&wait->node);
+		free(wait);
+	}
+}
+
 /** Raft callback for sending request vote message */
 static int __raft_send_requestvote(
 	raft_server_t           *raft,
@@ -390,10 +607,7 @@ static int __raft_send_requestvote(
 	snprintf(msg.identity, sizeof(msg.identity), "%s", group->identity);
 	msg.rv = *m;
 
-	struct iovec bufs[1];
-	bufs[0].iov_base = (char *)&msg;
-	bufs[0].iov_len = sizeof(msg_t);
-	eraft_network_transmit_connection(&evts->network, conn, bufs, 1);
+	__transmit_durable(group, conn, &msg);
 	return 0;
 }
 
@@ -421,13 +635,23 @@ int __raft_send_requestvote_response(
 	snprintf(msg.identity, sizeof(msg.identity), "%s", group->identity);
 	msg.rvr = *m;
 
-	struct iovec bufs[1];
-	bufs[0].iov_base = (char *)&msg;
-	bufs[0].iov_len = sizeof(msg_t);
-	eraft_network_transmit_connection(&evts->network, conn, bufs, 1);
+	__transmit_durable(group, conn, &msg);
 	return 0;
 }
 
+/*leader本地未落盘的日志不计入提交*/
+static raft_index_t __safe_commit_idx(struct eraft_group *group)
+{
+	raft_index_t commit_idx = raft_get_commit_idx(group->raft);
+
+	if (group->retain_ring.count) {
+		raft_index_t durable_idx = group->retain_ring.start_idx[group->retain_ring.head] - 1;
+		commit_idx = MIN(commit_idx, durable_idx);
+	}
+
+	return commit_idx;
+}
+
 /** Raft callback for sending appendentries message */
 static int __raft_send_appendentries(
 	raft_server_t           *raft,
@@ -447,6 +671,12 @@ static int __raft_send_appendentries(
 		return 0;
 	}
 
+	/*leader的任期落盘前不发送,之后的心跳会重新发送*/
+	if (!__meta_durable(group)) {
+		__meta_save_give(group);
+		return 0;
+	}
+
 	msg_t msg = {};
 	msg.type = MSG_APPENDENTRIES;
 	msg.node_id = group->node_id;
@@ -454,7 +684,7 @@ static int __raft_send_appendentries(
 	msg.ae.term = m->term;
 	msg.ae.prev_log_idx = m->prev_log_idx;
 	msg.ae.prev_log_term = m->prev_log_term;
-	msg.ae.leader_commit = m->leader_commit;
+	msg.ae.leader_commit = MIN(m->leader_commit, __safe_commit_idx(group));
 	msg.ae.n_entries = m->n_entries;
 
 	struct iovec bufs[(m->n_entries * 2) + 1];
@@ -463,12 +693,16 @@ static int __raft_send_appendentries(
 
 	if (0 < m->n_entries) {
 		/* appendentries with payload */
+		raft_entry_t heads[m->n_entries];
+
 		//	printf("pack count ---------------------------------------------------->%d\n", m->n_entries);
 		for (int i = 0; i < m->n_entries; i++) {
-			bufs[(i * 2) + 1].iov_base = (char *)m->bat->entries[i];
+			/*iobuf日志直接发送引用的缓冲区*/
+			eraft_iobuf_entry_expand(m->bat->entries[i], &heads[i]);
+			bufs[(i * 2) + 1].iov_base = (char *)&heads[i];
 			bufs[(i * 2) + 1].iov_len = sizeof(raft_entry_t);
-			bufs[(i * 2) + 2].iov_base = (char *)m->bat->entries[i]->data.buf;
-			bufs[(i * 2) + 2].iov_len = m->bat->entries[i]->data.len;
+			bufs[(i * 2) + 2].iov_base = (char *)heads[i].data.buf;
+			bufs[(i * 2) + 2].iov_len = heads[i].data.len;
 		}
 
 		eraft_network_transmit_connection(&evts->network, conn, bufs, (m->n_entries * 2) + 1);
@@ -505,13 +739,176 @@ int __raft_send_appendentries_response(
 	snprintf(msg.identity, sizeof(msg.identity), "%s", group->identity);
 	msg.aer = *m;
 
-	/* send response */
-	struct iovec bufs[1];
+	__transmit_durable(group, conn, &msg);
+	return 0;
+}
+
+/*从发送进度记录的位置读取一段快照,交给应用线程读取后发给follower*/
+static int __send_snapshot_chunk(struct eraft_group *group, raft_node_t *node)
+{
+	int                             id = raft_node_get_id(node);
+	struct eraft_node               *enode = &group->conf->nodes[id];
+	struct eraft_evts               *evts = group->evts;
+	struct eraft_snapshot_send      *send = &group->snapshot.send[id];
+
+	eraft_connection_t *conn = eraft_network_find_connection(&evts->network, enode->raft_host, enode->raft_port);
+
+	if (!eraft_network_usable_connection(&evts->network, conn)) {
+		return 0;
+	}
+
+	/*leader的任期落盘前不发送,之后的心跳会重新发送*/
+	if (!__meta_durable(group)) {
+		__meta_save_give(group);
+		return 0;
+	}
+
+	/*读取完成时按最新的进度重新检查*/
+	if (send->reading) {
+		return 0;
+	}
+
+	send->reading = true;
+	send->ts = ev_now(evts->loop);
+
+	struct eraft_taskis_snap_read *object = eraft_taskis_snap_read_make(group->identity, eraft_evts_dispose_dotask, evts,
+			evts, id, send->last_idx, send->last_term, send->offset);
+	__snapshot_apply_give(group, (struct eraft_dotask *)object);
+	return 0;
+}
+
+/*应用线程读出一段快照,进度未变时发给follower*/
+static void __snapshot_chunk_ready(struct eraft_group *group, struct eraft_taskis_snap_read_done *object)
+{
+	struct eraft_evts               *evts = group->evts;
+	struct eraft_snapshot_send      *send = &group->snapshot.send[object->node_id];
+	raft_node_t                     *node = raft_get_node(group->raft, object->node_id);
+
+	send->reading = false;
+
+	if (!node || !raft_is_leader(group->raft) || !send->last_idx) {
+		return;
+	}
+
+	/*读取期间重新开始了发送*/
+	if ((send->last_idx != object->last_idx) || (send->last_term != object->last_term) || (send->offset != object->offset)) {
+		__send_snapshot_chunk(group, node);
+		return;
+	}
+
+	if (object->len < 0) {
+		/*快照已被替换,下次从头发送新快照*/
+		send->last_idx = 0;
+		return;
+	}
+
+	struct eraft_node       *enode = &group->conf->nodes[object->node_id];
+	eraft_connection_t      *conn = eraft_network_find_connection(&evts->network, enode->raft_host, enode->raft_port);
+
+	if (!eraft_network_usable_connection(&evts->network, conn) || !__meta_durable(group)) {
+		return;
+	}
+
+	msg_t msg = {};
+	msg.type = MSG_SNAPSHOT;
+	msg.node_id = group->node_id;
+	snprintf(msg.identity, sizeof(msg.identity), "%s", group->identity);
+	msg.sn.term = raft_get_current_term(group->raft);
+	msg.sn.last_idx = object->last_idx;
+	msg.sn.last_term = object->last_term;
+	msg.sn.offset = object->offset;
+	msg.sn.len = object->len;
+	msg.sn.done = (object->offset + object->len >= object->total) ? 1 : 0;
+
+	struct iovec bufs[2];
 	bufs[0].iov_base = (char *)&msg;
 	bufs[0].iov_len = sizeof(msg_t);
-	eraft_network_transmit_connection(&evts->network, conn, bufs, 1);
+	bufs[1].iov_base = object->chunk;
+	bufs[1].iov_len = object->len;
+	eraft_network_transmit_connection(&evts->network, conn, bufs, object->len ? 2 : 1);
+
+	send->ts = ev_now(evts->loop);
+}
+
+/** Raft callback for sending the snapshot to a node whose next_idx is
+ * behind the compacted log */
+static int __raft_send_snapshot(
+	raft_server_t   *raft,
+	void            *user_data,
+	raft_node_t     *node
+	)
+{
+	struct eraft_group      *group = raft_get_udata(raft);
+	struct eraft_evts       *evts = group->evts;
+	struct eraft_snapshot   *file = &group->snapshot.file;
+	int                     id = raft_node_get_id(node);
+
+	if (!file->last_idx || (id >= group->conf->num_nodes)) {
+		return 0;
+	}
+
+	struct eraft_snapshot_send      *send = &group->snapshot.send[id];
+	double                          now = ev_now(evts->loop);
+
+	/*同一快照正在发送,未超时不重新开始*/
+	if ((send->last_idx == file->last_idx) && (send->last_term == file->last_term) &&
+		((now - send->ts) * 1000 < raft_get_election_timeout(raft))) {
+		return 0;
+	}
+
+	send->last_idx = file->last_idx;
+	send->last_term = file->last_term;
+	send->offset = 0;
+
+	return __send_snapshot_chunk(group, node);
+}
+
+static int __send_snapshot_response(struct eraft_group *group, raft_node_t *node, msg_snapshot_response_t *m)
+{
+	int                     id = raft_node_get_id(node);
+	struct eraft_node       *enode = &group->conf->nodes[id];
+	struct eraft_evts       *evts = group->evts;
+
+	eraft_connection_t *conn = eraft_network_find_connection(&evts->network, enode->raft_host, enode->raft_port);
+
+	if (!eraft_network_usable_connection(&evts->network, conn)) {
+		return 0;
+	}
+
+	msg_t msg = {};
+	msg.type = MSG_SNAPSHOT_RESPONSE;
+	msg.node_id = group->node_id;
+	snprintf(msg.identity, sizeof(msg.identity), "%s", group->identity);
+	msg.snr = *m;
+
+	__transmit_durable(group, conn, &msg);
+	return 0;
+}
+
+#ifdef USE_READ_INDEX
+/*按group发送读相关的消息,payload拷贝到消息的union中*/
+static int __send_group_msg(struct eraft_group *group, raft_node_t *node, int type, void *payload, size_t size)
+{
+	int                     id = raft_node_get_id(node);
+	struct eraft_node       *enode = &group->conf->nodes[id];
+	struct eraft_evts       *evts = group->evts;
+
+	eraft_connection_t *conn = eraft_network_find_connection(&evts->network, enode->raft_host, enode->raft_port);
+
+	if (!eraft_network_usable_connection(&evts->network, conn)) {
+		return 0;
+	}
+
+	msg_t msg = {};
+	msg.type = type;
+	msg.node_id = group->node_id;
+	snprintf(msg.identity, sizeof(msg.identity), "%s", group->identity);
+	memcpy(&msg.ri, payload, size);
+
+	__transmit_durable(group, conn, &msg);
 	return 0;
 }
+#endif /* ifdef USE_READ_INDEX */
 
 static int __send_leave_response(struct eraft_group *group, eraft_connection_t *conn)
 {
@@ -550,6 +947,54 @@ static long str2num(char *s)
 	return num;
 }
 
+void eraft_evts_load_group(struct eraft_evts *evts, struct eraft_dotask *task)
+{
+	long    hash_key = str2num(task->identity);
+	long    hash_idx = hash_key % MAX_JOURNAL_WORKER;
+
+	eraft_worker_give(&evts->journal_worker[hash_idx], task);
+}
+
+/*读和应用交给同一个应用线程,按顺序执行*/
+static void __log_read_give(struct eraft_evts *evts, struct eraft_taskis_log_read *object)
+{
+	long    hash_key = str2num(object->base.identity);
+	long    hash_idx = hash_key % MAX_APPLY_WORKER;
+
+	eraft_worker_give(&evts->apply_worker[hash_idx], (struct eraft_dotask *)object);
+}
+
+/*已交给应用线程的位置前移,放行等待的读*/
+static void __apply_advance(struct eraft_group *group, raft_index_t idx)
+{
+	struct eraft_evts *evts = group->evts;
+
+	group->apply_idx = MAX(group->apply_idx, idx);
+
+	while (!list_empty(&group->read_index.apply_wait_list)) {
+		struct eraft_taskis_log_read *object = list_first_entry(&group->read_index.apply_wait_list, struct eraft_taskis_log_read, base.node);
+
+		if (object->read_idx > group->apply_idx) {
+			break;
+		}
+
+		list_del(&object->base.node);
+		__log_read_give(evts, object);
+	}
+}
+
+static void __log_apply_give(struct eraft_group *group, struct eraft_taskis_log_apply *object)
+{
+	struct eraft_evts       *evts = group->evts;
+	long                    hash_key = str2num(object->base.identity);
+	long                    hash_idx = hash_key % MAX_APPLY_WORKER;
+	raft_index_t            end_idx = object->start_idx + object->batch->n_entries - 1;
+
+	eraft_worker_give(&evts->apply_worker[hash_idx], (struct eraft_dotask *)object);
+
+	__apply_advance(group, end_idx);
+}
+
 /** Raft callback for applying an entry to the finite state machine */
 static int __raft_log_apply(
 	raft_server_t   *raft,
@@ -575,29 +1020,30 @@ static int __raft_log_apply(
 				__send_leave_response(group, conn);
 			}
 
+			/*配置日志不经过应用线程*/
+			if (list_empty(&group->apply_wait_list)) {
+				__apply_advance(group, start_idx);
+			}
+
 			goto commit;
 		}
 	}
 
-	struct eraft_taskis_log_apply   *object = eraft_taskis_log_apply_make(group->identity, eraft_evts_dispose_dotask, evts, evts, batch, start_idx);
-	long                            hash_key = str2num(group->identity);
-	long                            hash_idx = hash_key % MAX_APPLY_WORKER;
-	eraft_worker_give(&evts->apply_worker[hash_idx], (struct eraft_dotask *)object);
-
-commit:
-	;
+	struct eraft_taskis_log_apply *object = eraft_taskis_log_apply_make(group->identity, eraft_evts_dispose_dotask, evts, evts, batch, start_idx);
 
-	/* We save the commit idx for performance reasons.
-	 * Note that Raft doesn't require this as it can figure it out itself. */
-	// TODO: open
-	// int commit_idx = raft_get_commit_idx(raft);
-	// eraft_journal_set_state(&group->journal, "commit_idx", strlen("commit_idx") + 1, (char *)&commit_idx, sizeof(commit_idx));//非sync操作,快照时需要sync操作.
+	if (!list_empty(&group->apply_wait_list) || (start_idx + batch->n_entries - 1 > __safe_commit_idx(group))) {
+		/*leader本地落盘后再应用*/
+		list_add_tail(&object->base.node, &group->apply_wait_list);
+	} else {
+		__log_apply_give(group, object);
+	}
 
+commit:
 	return 0;
 }
 
 /** Raft callback for saving voted_for field to disk.
- * This only returns when change has been made to disk. */
+ * The change is written before the next message of this group is sent. */
 static int __raft_persist_vote(
 	raft_server_t   *raft,
 	void            *udata,
@@ -606,11 +1052,13 @@ static int __raft_persist_vote(
 {
 	struct eraft_group *group = raft_get_udata(raft);
 
-	return eraft_journal_set_state(&group->journal, "voted_for", strlen("voted_for") + 1, (char *)&voted_for, sizeof(voted_for));
+	group->meta.voted_for = voted_for;
+	group->meta.dirty = true;
+	return 0;
 }
 
 /** Raft callback for saving term field to disk.
- * This only returns when change has been made to disk. */
+ * The change is written before the next message of this group is sent. */
 static int __raft_persist_term(
 	raft_server_t   *raft,
 	void            *udata,
@@ -620,7 +1068,10 @@ static int __raft_persist_term(
 {
 	struct eraft_group *group = raft_get_udata(raft);
 
-	return eraft_journal_set_state(&group->journal, "term", strlen("term") + 1, (char *)&term, sizeof(term));
+	group->meta.term = term;
+	group->meta.voted_for = vote;
+	group->meta.dirty = true;
+	return 0;
 }
 
 static int __offer_cfg_change(struct eraft_group        *group,
@@ -668,31 +1119,61 @@ static int __offer_cfg_change(struct eraft_group        *group,
 	return 0;
 }
 
-int __set_append_log_batch(struct eraft_journal *store, raft_batch_t *bat, int start_idx)
+/*fcb在落盘完成后调用,io_uring存储时在其完成线程中调用*/
+int __set_append_log_batch(struct eraft_journal *store, raft_batch_t *bat, int start_idx, ERAFT_JOURNAL_COMMIT_FCB fcb, void *usr)
 {
 #ifdef TEST_NETWORK_ONLY
+	fcb(0, usr);
 	return 0;
 #endif
 	void *txn = eraft_journal_tx_begin(store);
 
 	for (int i = 0; i < bat->n_entries; i++) {
 		struct eraft_entry eentry;
-		eentry.entry = *bat->entries[i];
+		eraft_iobuf_entry_expand(bat->entries[i], &eentry.entry);
 		eentry.aid = 0;
 		eentry.iid = start_idx + i;
 
 		int num = eraft_journal_set_record(store, txn, start_idx + i, &eentry);
 
 		if (0 == num) {
+			/*失败同样经fcb返回给raft线程*/
 			eraft_journal_tx_abort(store, txn);
+			fcb(-1, usr);
 			return -1;
 		}
 	}
 
-	int e = eraft_journal_tx_commit(store, txn);
-	assert(e == 0);
+	return eraft_journal_tx_commit_async(store, txn, fcb, usr);
+}
 
-	return 0;
+/*日志落盘完成,移交给raft线程去处理*/
+static void __log_retain_commit_fcb(int result, void *usr)
+{
+	struct eraft_taskis_log_retain *object = usr;
+
+	if (result != 0) {
+		printf("log retain %d failed: %d\n", object->start_idx, result);
+	}
+
+	struct eraft_taskis_log_retain_done *new_task = eraft_taskis_log_retain_done_make(object->base.identity, eraft_evts_dispose_dotask, object->evts, result, object->batch, object->start_idx, object->usr);
+	eraft_tasker_once_give(&object->evts->tasker, (struct eraft_dotask *)new_task);
+
+	eraft_taskis_log_retain_free(object);
+}
+
+static void __log_append_commit_fcb(int result, void *usr)
+{
+	struct eraft_taskis_log_append *object = usr;
+
+	if (result != 0) {
+		printf("log append %d failed: %d\n", object->start_idx, result);
+	}
+
+	struct eraft_taskis_log_append_done *new_task = eraft_taskis_log_append_done_make(object->base.identity, eraft_evts_dispose_dotask, object->evts, object->evts, result, object->batch, object->start_idx, object->raft_node, object->leader_commit, object->rsp_first_idx);
+	eraft_tasker_once_give(&object->evts->tasker, (struct eraft_dotask *)new_task);
+
+	eraft_taskis_log_append_free(object);
 }
 
 int __get_append_log(struct eraft_journal *store, raft_entry_t *ety, int ety_idx)
@@ -766,8 +1247,47 @@ int __raft_log_retain(
 		}
 	}
 
+#ifdef USE_READ_INDEX
+	/*当前任期的第一条日志提交后,commit_idx才可用于读*/
+	if (group->read_index.term != raft_get_current_term(raft)) {
+		group->read_index.term = raft_get_current_term(raft);
+		group->read_index.term_first_idx = start_idx;
+	}
+#endif
+
+	/*记录落盘顺序*/
+	assert(group->retain_ring.count < MAX_RETAIN_WINDOW);
+	int tail = (group->retain_ring.head + group->retain_ring.count) % MAX_RETAIN_WINDOW;
+	group->retain_ring.start_idx[tail] = start_idx;
+	group->retain_ring.count++;
+
 	printf("log_retain working!\n");
+#ifdef USE_PARALLEL_RETAIN
+	/*落盘使用副本,原批次随后加入raft日志并复制给follower*/
+	raft_batch_t *copy = raft_batch_make(batch->n_entries);
+
+	for (int i = 0; i < batch->n_entries; i++) {
+		raft_entry_t            *ety = raft_batch_view_entry(batch, i);
+		struct eraft_iobuf      *iobuf = eraft_iobuf_by_entry(ety);
+
+		if (iobuf) {
+			/*只复制缓冲区指针并增加引用*/
+			eraft_iobuf_get(iobuf);
+		}
+
+		/*写请求的日志都是IOBUF类型,只有配置变更日志复制数据*/
+		raft_batch_join_entry(copy, i, raft_entry_make(ety->term, ety->id, ety->type, ety->data.buf, ety->data.len));
+	}
+
+	assert(!group->retain_pending.batch);
+	group->retain_pending.batch = batch;
+	group->retain_pending.start_idx = start_idx;
+	group->retain_pending.usr = usr;
+
+	struct eraft_taskis_log_retain *object = eraft_taskis_log_retain_make(group->identity, eraft_evts_dispose_dotask, evts, evts, &group->journal, copy, start_idx, NULL);
+#else
 	struct eraft_taskis_log_retain *object = eraft_taskis_log_retain_make(group->identity, eraft_evts_dispose_dotask, evts, evts, &group->journal, batch, start_idx, usr);
+#endif
 
 	long    hash_key = str2num(group->identity);
 	long    hash_idx = hash_key % MAX_JOURNAL_WORKER;
@@ -776,6 +1296,151 @@ int __raft_log_retain(
 	return 0;
 }
 
+static void __request_write_finish(struct eraft_taskis_request_write *object)
+{
+	if (object->fcb) {
+		object->fcb(object->request, object->result, (object->result == 0) ? object->idx : -1, object->usr);
+		eraft_taskis_request_write_free(object);
+	} else if (ATOMIC_CASB(&object->state, ERAFT_REQUEST_SUBMITTED, ERAFT_REQUEST_DONE)) {
+		/*同步请求由调用者释放*/
+		etask_awake(object->etask);
+	} else {
+		/*调用者已超时返回,无人等待*/
+		assert(object->state == ERAFT_REQUEST_DETACHED);
+		etask_free(object->etask);
+		eraft_taskis_request_write_free(object);
+	}
+}
+
+static void __request_write_retain_done(struct eraft_group *group, struct eraft_taskis_request_write *object, int result, raft_term_t term, int idx)
+{
+	object->result = eraft_errno_by_raft(result);
+
+	if (result == 0) {
+		/*挂到提交队列,提交后唤醒*/
+		object->idx = idx;
+		object->term = term;
+		list_add_tail(&object->base.node, &group->commit_list);
+	} else {
+		__request_write_finish(object);
+	}
+}
+
+static void __request_write_commit_done(struct eraft_group *group, raft_index_t commit_idx)
+{
+	while (!list_empty(&group->commit_list)) {
+		struct eraft_taskis_request_write *object = list_first_entry(&group->commit_list, struct eraft_taskis_request_write, base.node);
+
+		if (object->idx > commit_idx) {
+			break;
+		}
+
+		list_del(&object->base.node);
+
+		/*提交的是其它leader写在该位置的日志*/
+		raft_entry_t *ety = raft_get_entry_from_idx(group->raft, object->idx);
+
+		if (ety && (ety->term != object->term)) {
+			object->result = ERAFT_ERR_NOT_LEADER;
+		}
+
+		__request_write_finish(object);
+	}
+}
+
+/*结束最后一条日志不小于from_idx的等待,result为eraft错误码*/
+static void __request_write_abort(struct eraft_group *group, raft_index_t from_idx, int result)
+{
+	struct eraft_taskis_request_write *object = NULL;
+
+	list_for_each_entry(object, &group->commit_list, base.node)
+	{
+		if (object->idx < from_idx) {
+			continue;
+		}
+
+		list_del(&object->base.node);
+		object->result = result;
+		__request_write_finish(object);
+	}
+}
+
+/*已交出的批次中的写请求以result结束*/
+static void __request_write_fail_list(struct eraft_dotask *first, int result)
+{
+	struct list_head *head = (struct list_head *)&first->node;
+
+	while (!list_empty(head)) {
+		struct eraft_dotask *child = list_first_entry(head, struct eraft_dotask, node);
+		list_del(&child->node);
+
+		struct eraft_taskis_request_write *object = list_entry(child, struct eraft_taskis_request_write, base);
+		object->result = result;
+		__request_write_finish(object);
+	}
+
+	struct eraft_taskis_request_write *object = list_entry(first, struct eraft_taskis_request_write, base);
+	object->result = result;
+	__request_write_finish(object);
+}
+
+/*释放不再交给raft的批次,IOBUF日志持有缓冲区引用*/
+static void __log_batch_free(raft_batch_t *batch)
+{
+	for (int i = 0; i < batch->n_entries; i++) {
+		raft_entry_t            *ety = raft_batch_take_entry(batch, i);
+		struct eraft_iobuf      *iobuf = eraft_iobuf_by_entry(ety);
+
+		if (iobuf) {
+			eraft_iobuf_put(iobuf);
+		}
+
+		raft_entry_free(ety);
+	}
+
+	raft_batch_free(batch);
+}
+
+/*释放raft交出的批次,IOBUF的引用仍归raft日志*/
+static void __log_batch_drop(raft_batch_t *batch)
+{
+	for (int i = 0; i < batch->n_entries; i++) {
+		raft_entry_t *ety = raft_batch_take_entry(batch, i);
+
+		raft_entry_free(ety);
+	}
+
+	raft_batch_free(batch);
+}
+
+/*不再是leader时日志可能由新leader提交也可能被覆盖,结果未知*/
+static void __request_write_check_leader(struct eraft_group *group)
+{
+	if (!list_empty(&group->commit_list) && !raft_is_leader(group->raft)) {
+		__request_write_abort(group, 0, ERAFT_ERR_IN_DOUBT);
+	}
+}
+
+/*通知新提交的日志,放行等待落盘的应用*/
+static void __commit_notify(struct eraft_group *group)
+{
+	raft_index_t commit_idx = __safe_commit_idx(group);
+
+	__request_write_commit_done(group, commit_idx);
+	__request_write_check_leader(group);
+
+	while (!list_empty(&group->apply_wait_list)) {
+		struct eraft_taskis_log_apply *object = list_first_entry(&group->apply_wait_list, struct eraft_taskis_log_apply, base.node);
+
+		if (object->start_idx + object->batch->n_entries - 1 > commit_idx) {
+			break;
+		}
+
+		list_del(&object->base.node);
+		__log_apply_give(group, object);
+	}
+}
+
 int __raft_log_retain_done(
 	raft_server_t   *raft,
 	void            *user_data,
@@ -787,7 +1452,6 @@ int __raft_log_retain_done(
 	)
 {
 	struct eraft_group      *group = raft_get_udata(raft);
-	struct eraft_evts       *evts = (struct eraft_evts *)group->evts;
 	int                     idx = start_idx;
 	// printf("--->%d\n", idx);
 
@@ -798,14 +1462,9 @@ int __raft_log_retain_done(
 
 	struct eraft_taskis_request_write *object = list_entry(first, struct eraft_taskis_request_write, base);
 
-	object->result = result;
-
-	if (result == 0) {
-		object->efd = etask_tree_make_task(evts->wait_idx_tree, &idx, sizeof(idx));
-		object->idx = idx;
-	}
-
-	etask_awake(object->etask);
+	/*每个任务占用count条连续日志,以最后一条的提交为完成*/
+	idx += object->count - 1;
+	__request_write_retain_done(group, object, result, term, idx);
 
 	if (!list_empty(&do_list)) {
 		struct eraft_dotask *child = NULL;
@@ -814,18 +1473,13 @@ int __raft_log_retain_done(
 			list_del(&child->node);
 			object = list_entry(child, struct eraft_taskis_request_write, base);
 
-			object->result = result;
-
 			if (result == 0) {
-				idx++;
+				idx += object->count;
 				assert(idx <= end_idx);
-
-				// printf("--->%d\n", idx);
-				object->efd = etask_tree_make_task(evts->wait_idx_tree, &idx, sizeof(idx));
-				object->idx = idx;
 			}
 
-			etask_awake(object->etask);
+			// printf("--->%d\n", idx);
+			__request_write_retain_done(group, object, result, term, idx);
 		}
 	}
 
@@ -853,6 +1507,43 @@ int __raft_log_remind(
 	return 0;
 }
 
+/*日志交给日志线程处理,与之后的落盘任务保持顺序*/
+static void __log_journal_give(struct eraft_group *group, struct eraft_dotask *task)
+{
+	struct eraft_evts       *evts = group->evts;
+	long                    hash_key = str2num(group->identity);
+	long                    hash_idx = hash_key % MAX_JOURNAL_WORKER;
+
+	eraft_worker_give(&evts->journal_worker[hash_idx], task);
+}
+
+/*日志压缩:保留最近retain条已应用的日志,raft已移除的日志直接删除,每满step条删除一次*/
+static void __log_trim_check(struct eraft_group *group)
+{
+	if (group->compact.step <= 0) {
+		return;
+	}
+
+	/*重启时从落盘的commit_idx之后加载,不能删除之后的日志*/
+	raft_index_t    applied = MIN(raft_get_last_applied_idx(group->raft), group->meta.synced_commit_idx);
+	raft_index_t    target = MAX(applied - group->compact.retain, group->compact.poll_idx);
+
+	if (group->snapshot.save_fcb) {
+		/*生成快照的group重启时从快照之后加载,不能删除快照未包含的日志*/
+		target = MIN(target, group->snapshot.file.last_idx);
+	}
+
+	if (target - group->compact.trim_idx < group->compact.step) {
+		return;
+	}
+
+	struct eraft_taskis_log_trim *object = eraft_taskis_log_trim_make(group->identity, eraft_evts_dispose_dotask, group->evts,
+			group->evts, &group->journal, target);
+
+	__log_journal_give(group, (struct eraft_dotask *)object);
+	group->compact.trim_idx = target;
+}
+
 /** Raft callback for removing the first entry from the log
  * @note this is provided to support log compaction in the future */
 static int __raft_logentry_poll(
@@ -862,9 +1553,16 @@ static int __raft_logentry_poll(
 	raft_index_t    ety_idx
 	)
 {
-	// struct eraft_group *group = raft_get_udata(raft);
+	struct eraft_group *group = raft_get_udata(raft);
+
+	group->compact.poll_idx = MAX(group->compact.poll_idx, ety_idx);
+	__log_trim_check(group);
+
+	struct eraft_iobuf *iobuf = eraft_iobuf_by_entry(entry);
 
-	// __pop_oldest_log(group->lmdb);
+	if (iobuf) {
+		eraft_iobuf_put(iobuf);
+	}
 
 	return 0;
 }
@@ -879,13 +1577,259 @@ static int __raft_logentry_pop(
 	raft_index_t    ety_idx
 	)
 {
-	// struct eraft_group *group = raft_get_udata(raft);
+	struct eraft_group *group = raft_get_udata(raft);
+
+	/*日志被删除,等待其提交的写请求确定失败*/
+	__request_write_abort(group, ety_idx, ERAFT_ERR_NOT_LEADER);
+
+	/*在日志线程中删除,之后写入的新日志排在其后*/
+	struct eraft_taskis_log_pop *object = eraft_taskis_log_pop_make(group->identity, eraft_evts_dispose_dotask, group->evts,
+			group->evts, &group->journal, ety_idx);
+
+	__log_journal_give(group, (struct eraft_dotask *)object);
+
+	struct eraft_iobuf *iobuf = eraft_iobuf_by_entry(entry);
+
+	if (iobuf) {
+		eraft_iobuf_put(iobuf);
+	}
+
+	return 0;
+}
+
+/*快照与日志交给同一个应用线程,按顺序执行*/
+static void __snapshot_apply_give(struct eraft_group *group, struct eraft_dotask *task)
+{
+	struct eraft_evts       *evts = group->evts;
+	long                    hash_key = str2num(group->identity);
+	long                    hash_idx = hash_key % MAX_APPLY_WORKER;
+
+	eraft_worker_give(&evts->apply_worker[hash_idx], task);
+}
+
+/*已应用的日志距上次快照满step条时,在应用线程中生成快照*/
+static void __snapshot_check(struct eraft_group *group)
+{
+	raft_server_t *raft = group->raft;
+
+	if (!group->snapshot.save_fcb || group->snapshot.saving || group->snapshot.loading) {
+		return;
+	}
+
+	raft_index_t applied = raft_get_last_applied_idx(raft);
+
+	if (applied - group->snapshot.file.last_idx < group->snapshot.step) {
+		return;
+	}
+
+	/*快照点即commit_idx,之前的日志须全部应用完,且没有交给应用线程未完成的日志*/
+	if ((applied != raft_get_commit_idx(raft)) || (applied != group->apply_idx) ||
+		!list_empty(&group->apply_wait_list) || raft_snapshot_is_in_progress(raft)) {
+		return;
+	}
+
+	raft_entry_t *ety = raft_get_entry_from_idx(raft, applied);
+
+	if (!ety) {
+		return;
+	}
+
+	raft_term_t term = ety->term;
+
+	if (raft_begin_snapshot(raft, 0) != 0) {
+		return;
+	}
+
+	struct eraft_taskis_snap_save *object = eraft_taskis_snap_save_make(group->identity, eraft_evts_dispose_dotask, group->evts,
+			group->evts, applied, term);
+
+	group->snapshot.saving = true;
+	__snapshot_apply_give(group, (struct eraft_dotask *)object);
+}
+
+/*用快照替换raft日志,节点列表与启动配置相同,重新加入*/
+static int __snapshot_restore(struct eraft_group *group, raft_index_t last_idx, raft_term_t last_term)
+{
+	struct eraft_evts       *evts = group->evts;
+	int                     e = raft_begin_load_snapshot(group->raft, last_term, last_idx);
+
+	if (e != 0) {
+		printf("raft load snapshot %d failed: %d\n", last_idx, e);
+		return e;
+	}
+
+	for (int i = 0; i < group->conf->num_nodes; i++) {
+		if (raft_get_node(group->raft, i)) {
+			continue;
+		}
+
+		struct eraft_node       *enode = &group->conf->nodes[i];
+		raft_node_t             *node = raft_add_node(group->raft, NULL, i, (i == group->node_id) ? 1 : 0);
+
+		if (i != group->node_id) {
+			raft_node_set_udata(node, eraft_network_find_connection(&evts->network, enode->raft_host, enode->raft_port));
+		}
+	}
 
-	// __pop_newest_log(group->lmdb);
+	raft_end_load_snapshot(group->raft);
 
+	eraft_snapshot_advance(&group->snapshot.file, last_idx, last_term);
+	group->compact.poll_idx = MAX(group->compact.poll_idx, last_idx);
+	__apply_advance(group, last_idx);
 	return 0;
 }
 
+/*follower接收一段快照,交给应用线程写入*/
+static void __snapshot_recv(struct eraft_group *group, struct eraft_taskis_net_snapshot *object)
+{
+	msg_snapshot_t          *sn = object->sn;
+	msg_snapshot_response_t rsp = {};
+
+	/*同appendentries:承认更高任期的leader,并在每段快照到达时重置选举计时*/
+	if (sn->term > raft_get_current_term(group->raft)) {
+		raft_set_current_term(group->raft, sn->term);
+		raft_become_follower(group->raft);
+	} else if (sn->term == raft_get_current_term(group->raft)) {
+		raft_become_follower(group->raft);
+	}
+
+	rsp.term = raft_get_current_term(group->raft);
+	rsp.last_idx = sn->last_idx;
+
+	if ((sn->term < rsp.term) || !group->snapshot.load_fcb) {
+		rsp.success = 0;
+		goto reply;
+	}
+
+	/*已有快照包含的日志,直接回复让leader前移next_idx*/
+	if (sn->last_idx <= raft_get_commit_idx(group->raft)) {
+		msg_appendentries_response_t aer = {};
+		aer.term = rsp.term;
+		aer.success = 1;
+		aer.current_idx = sn->last_idx;
+		aer.first_idx = sn->last_idx;
+
+		if (object->node) {
+			__raft_send_appendentries_response(group->raft, NULL, object->node, &aer);
+		}
+
+		return;
+	}
+
+	/*数据交给写入任务*/
+	struct eraft_taskis_snap_recv *task = eraft_taskis_snap_recv_make(group->identity, eraft_evts_dispose_dotask, group->evts,
+			group->evts, sn, object->data, object->node);
+	object->data = NULL;
+	__snapshot_apply_give(group, (struct eraft_dotask *)task);
+	return;
+
+reply:
+
+	if (object->node) {
+		__send_snapshot_response(group, object->node, &rsp);
+	}
+}
+
+/*一段快照写入完成,回复leader,收完后交给应用线程加载*/
+static void __snapshot_received(struct eraft_group *group, struct eraft_taskis_snap_recv_done *object)
+{
+	msg_snapshot_response_t rsp = {};
+
+	rsp.term = raft_get_current_term(group->raft);
+	rsp.last_idx = object->last_idx;
+
+	if (object->result != 0) {
+		/*leader从头重新发送*/
+		rsp.success = 0;
+		goto reply;
+	}
+
+	if (!object->done) {
+		rsp.success = 1;
+		rsp.offset = object->offset;
+		goto reply;
+	}
+
+	/*加载完成前暂停处理leader的日志*/
+	eraft_tasker_each_stop(&group->peer_tasker);
+	group->snapshot.loading = true;
+
+	struct eraft_taskis_snap_load *task = eraft_taskis_snap_load_make(group->identity, eraft_evts_dispose_dotask, group->evts,
+			group->evts, object->last_idx, object->last_term, object->node);
+	__snapshot_apply_give(group, (struct eraft_dotask *)task);
+	return;
+
+reply:
+
+	if (object->node) {
+		__send_snapshot_response(group, object->node, &rsp);
+	}
+}
+
+/*收到的快照加载完成,删除快照之前和与之冲突的日志,回复leader*/
+static void __snapshot_installed(struct eraft_group *group, struct eraft_taskis_snap_load_done *object)
+{
+	group->snapshot.loading = false;
+
+	if (object->result != 0) {
+		/*状态机可能已被部分替换,无法继续*/
+		printf("snapshot %d load failed: %d\n", object->last_idx, object->result);
+		abort();
+	}
+
+	if (__snapshot_restore(group, object->last_idx, object->last_term) == 0) {
+		struct eraft_taskis_log_pop *pop = eraft_taskis_log_pop_make(group->identity, eraft_evts_dispose_dotask, group->evts,
+				group->evts, &group->journal, object->last_idx + 1);
+		__log_journal_give(group, (struct eraft_dotask *)pop);
+
+		struct eraft_taskis_log_trim *trim = eraft_taskis_log_trim_make(group->identity, eraft_evts_dispose_dotask, group->evts,
+				group->evts, &group->journal, object->last_idx);
+		__log_journal_give(group, (struct eraft_dotask *)trim);
+		group->compact.trim_idx = MAX(group->compact.trim_idx, object->last_idx);
+
+		msg_appendentries_response_t aer = {};
+		aer.term = raft_get_current_term(group->raft);
+		aer.success = 1;
+		aer.current_idx = object->last_idx;
+		aer.first_idx = object->last_idx;
+
+		if (object->node) {
+			__raft_send_appendentries_response(group->raft, NULL, object->node, &aer);
+		}
+	}
+
+	eraft_tasker_each_call(&group->peer_tasker);
+}
+
+/*leader收到一段快照的回复,继续发送下一段*/
+static void __snapshot_send_next(struct eraft_group *group, raft_node_t *node, msg_snapshot_response_t *m)
+{
+	if (!node || !raft_is_leader(group->raft) || (m->term != raft_get_current_term(group->raft))) {
+		return;
+	}
+
+	int id = raft_node_get_id(node);
+
+	if (id >= group->conf->num_nodes) {
+		return;
+	}
+
+	struct eraft_snapshot_send *send = &group->snapshot.send[id];
+
+	if (m->last_idx != send->last_idx) {
+		return;
+	}
+
+	if (!m->success) {
+		/*下次需要快照时从头发送*/
+		send->last_idx = 0;
+		return;
+	}
+
+	send->offset = m->offset;
+	__send_snapshot_chunk(group, node);
+}
+
 /** Non-voting node now has enough logs to be able to vote.
  * Append a finalization cfg log entry. */
 static int __raft_node_has_sufficient_logs(
@@ -926,6 +1870,7 @@ raft_cbs_t g_default_raft_funcs = {
 	.log_pop                        = __raft_logentry_pop,
 	.log_apply                      = __raft_log_apply,
 	.log_get_node_id                = __raft_log_get_node_id,
+	.send_snapshot                  = __raft_send_snapshot,
 
 	.node_has_sufficient_logs       = __raft_node_has_sufficient_logs,
 };
@@ -976,6 +1921,21 @@ bool __periodic_for_lookup_fcb(struct eraft_group *group, size_t idx, void *usr)
 		raft_periodic(group->raft, PERIOD_MSEC);
 	}
 
+	/*单节点选举不发送消息,在此落盘;commit_idx每个周期最多写入一次*/
+	if (group->meta.dirty || (group->meta.commit_idx != group->meta.synced_commit_idx)) {
+		__meta_save_give(group);
+	}
+
+	__request_write_check_leader(group);
+
+#ifdef USE_PARALLEL_RETAIN
+	__retain_retry(group);
+#endif
+
+#ifdef USE_READ_INDEX
+	__read_index_periodic(group);
+#endif
+
 	return true;
 }
 
@@ -1019,9 +1979,6 @@ struct eraft_evts *eraft_evts_make(struct eraft_evts *evts, int self_port)
 		evts->canfree = true;
 	}
 
-	/* eventfd by callback register in rbtree. */
-	evts->wait_idx_tree = etask_tree_make();
-
 	/*初始化事件loop*/
 	struct evcoro_scheduler *p_scheduler = evcoro_get_default_scheduler();
 	assert(p_scheduler);
@@ -1055,8 +2012,6 @@ struct eraft_evts *eraft_evts_make(struct eraft_evts *evts, int self_port)
 void eraft_evts_free(struct eraft_evts *evts)
 {
 	if (evts && evts->init) {
-		etask_tree_free(evts->wait_idx_tree);
-
 		_stop_raft_periodic_timer(evts);
 
 		eraft_network_free(&evts->network);
@@ -1105,8 +2060,23 @@ static void __send_leave(eraft_connection_t *conn)
 
 #endif
 
-int __raft_log_remind_done(
-	int     result,
+/*唤醒读请求,调用者已超时返回时回收*/
+static void __request_read_finish(struct eraft_taskis_request_read *object, int result)
+{
+	object->result = result;
+
+	if (ATOMIC_CASB(&object->state, ERAFT_REQUEST_MERGING, ERAFT_REQUEST_DONE) ||
+		ATOMIC_CASB(&object->state, ERAFT_REQUEST_SUBMITTED, ERAFT_REQUEST_DONE)) {
+		etask_awake(object->etask);
+	} else {
+		assert(object->state == ERAFT_REQUEST_DETACHED);
+		etask_free(object->etask);
+		eraft_taskis_request_read_free(object);
+	}
+}
+
+int __raft_log_remind_done(
+	int     result,
 	void    *usr
 	)
 {
@@ -1117,9 +2087,7 @@ int __raft_log_remind_done(
 
 	struct eraft_taskis_request_read *object = list_entry(first, struct eraft_taskis_request_read, base);
 
-	object->result = result;
-
-	etask_awake(object->etask);
+	__request_read_finish(object, result);
 
 	if (!list_empty(&do_list)) {
 		struct eraft_dotask *child = NULL;
@@ -1128,29 +2096,725 @@ int __raft_log_remind_done(
 			list_del(&child->node);
 			object = list_entry(child, struct eraft_taskis_request_read, base);
 
-			object->result = result;
-
-			etask_awake(object->etask);
+			__request_read_finish(object, result);
 		}
 	}
 
 	return 0;
 }
 
+/*读回调开始执行,之后调用者不能再取消;已取消的请求不再交给读回调*/
+static bool __request_read_start(struct eraft_taskis_request_read *object)
+{
+	return ATOMIC_CASB(&object->state, ERAFT_REQUEST_MERGING, ERAFT_REQUEST_SUBMITTED);
+}
+
+/*读请求批次的请求和结果数组,只包含开始执行的读请求*/
+static int __read_requests_make(struct eraft_dotask *first, struct iovec **requests, struct eraft_read_result **results)
+{
+	struct list_head        *head = (struct list_head *)&first->node;
+	struct eraft_dotask     *child = NULL;
+	/*统计条数*/
+	int total = 1;
+
+	if (!list_empty(head)) {
+		list_for_each_entry(child, head, node)
+		{
+			total++;
+		}
+	}
+
+	struct iovec                    *new_requests = calloc(total, sizeof(struct iovec));
+	struct eraft_read_result        *new_results = calloc(total, sizeof(struct eraft_read_result));
+	int                             new_count = 0;
+
+	struct eraft_taskis_request_read *obj = list_entry(first, struct eraft_taskis_request_read, base);
+
+	if (__request_read_start(obj)) {
+		new_requests[new_count].iov_base = obj->request->iov_base;
+		new_requests[new_count].iov_len = obj->request->iov_len;
+		new_results[new_count].arena = obj->arena;
+		new_count++;
+	}
+
+	if (!list_empty(head)) {
+		list_for_each_entry(child, head, node)
+		{
+			obj = list_entry(child, struct eraft_taskis_request_read, base);
+
+			if (__request_read_start(obj)) {
+				new_requests[new_count].iov_base = obj->request->iov_base;
+				new_requests[new_count].iov_len = obj->request->iov_len;
+				new_results[new_count].arena = obj->arena;
+				new_count++;
+			}
+		}
+	}
+
+	*requests = new_requests;
+	*results = new_results;
+	return new_count;
+}
+
+/*结果交给等待的调用者,数据留在调用者的arena中*/
+static void __read_results_done(struct eraft_dotask *first, struct eraft_read_result *results)
+{
+	struct list_head        *head = (struct list_head *)&first->node;
+	struct eraft_dotask     *child = NULL;
+	int                     i = 0;
+
+	struct eraft_taskis_request_read *obj = list_entry(first, struct eraft_taskis_request_read, base);
+
+	if (obj->state == ERAFT_REQUEST_SUBMITTED) {
+		obj->response = results[i++].response;
+	}
+
+	if (!list_empty(head)) {
+		list_for_each_entry(child, head, node)
+		{
+			obj = list_entry(child, struct eraft_taskis_request_read, base);
+
+			if (obj->state == ERAFT_REQUEST_SUBMITTED) {
+				obj->response = results[i++].response;
+			}
+		}
+	}
+}
+
+#ifdef USE_PARALLEL_RETAIN
+/*不等本地落盘,立即加入raft日志并复制给follower*/
+static void __retain_replicate(struct eraft_group *group)
+{
+	raft_batch_t *batch = group->retain_pending.batch;
+
+	if (!batch) {
+		return;
+	}
+
+	group->retain_pending.batch = NULL;
+
+	int n_entries = batch->n_entries;
+	raft_dispose_entries_cache(group->raft, true, batch, group->retain_pending.start_idx);
+
+	/*first will call send_appendentries*/
+	g_default_raft_funcs.send_appendentries = __raft_send_appendentries;
+	/*then will call log_retain_done*/
+	g_default_raft_funcs.log_retain_done = __raft_log_retain_done;
+	/*start*/
+	raft_async_retain_entries_finish(group->raft, 0, n_entries, group->retain_pending.usr);
+}
+#endif
+
+/*本地日志无法落盘,leader让出领导权*/
+static void __retain_fail_step_down(struct eraft_group *group)
+{
+	if (raft_is_leader(group->raft)) {
+		printf("group %s step down for journal failure\n", group->identity);
+		raft_become_follower(group->raft);
+		__request_write_check_leader(group);
+	}
+}
+
+#ifdef USE_PARALLEL_RETAIN
+/*日志已加入raft并复制,失败的批次只能重新落盘*/
+static void __retain_retry(struct eraft_group *group)
+{
+	struct eraft_evts                       *evts = group->evts;
+	struct eraft_taskis_log_retain_done     *child = NULL;
+
+	list_for_each_entry(child, &group->retain_done_list, base.node)
+	{
+		if (child->result == 0) {
+			continue;
+		}
+
+		list_del(&child->base.node);
+
+		struct eraft_taskis_log_retain *object = eraft_taskis_log_retain_make(group->identity, eraft_evts_dispose_dotask, evts, evts, &group->journal, child->batch, child->start_idx, child->usr);
+		__log_journal_give(group, (struct eraft_dotask *)object);
+
+		eraft_taskis_log_retain_done_free(child);
+	}
+}
+#endif
+
+static void __retain_done_in_order(struct eraft_group *group)
+{
+	while (group->retain_ring.count) {
+		raft_index_t                            start_idx = group->retain_ring.start_idx[group->retain_ring.head];
+		struct eraft_taskis_log_retain_done     *object = NULL;
+		struct eraft_taskis_log_retain_done     *child = NULL;
+		list_for_each_entry(child, &group->retain_done_list, base.node)
+		{
+			if (child->start_idx == start_idx) {
+				object = child;
+				break;
+			}
+		}
+
+		if (!object) {
+			break;
+		}
+
+#ifdef USE_PARALLEL_RETAIN
+		if (object->result != 0) {
+			/*停在失败的批次,等待重试,之后的日志也不计入提交*/
+			break;
+		}
+#endif
+
+		list_del(&object->base.node);
+		group->retain_ring.head = (group->retain_ring.head + 1) % MAX_RETAIN_WINDOW;
+		group->retain_ring.count--;
+
+#ifdef USE_PARALLEL_RETAIN
+		/*日志已提前加入raft,这里只释放落盘副本*/
+		__log_batch_free(object->batch);
+#else
+		/*失败的批次未加入raft日志,其后的批次无法接续,同样失败*/
+		if (object->result != 0) {
+			group->retain_failed = true;
+		}
+
+		int     result = group->retain_failed ? RAFT_ERR_NOT_LEADER : 0;
+		int     n_entries = object->batch->n_entries;
+		raft_dispose_entries_cache(group->raft, (result == 0), object->batch, object->start_idx);
+
+		/*first will call send_appendentries*/
+		g_default_raft_funcs.send_appendentries = __raft_send_appendentries;
+		/*then will call log_retain_done*/
+		g_default_raft_funcs.log_retain_done = __raft_log_retain_done;
+		/*start*/
+		raft_async_retain_entries_finish(group->raft, result, n_entries, object->usr);
+#endif
+
+		eraft_taskis_log_retain_done_free(object);
+	}
+
+	if (!group->retain_ring.count) {
+		group->retain_failed = false;
+	}
+
+#ifdef USE_PARALLEL_RETAIN
+	/*本地落盘后才计入提交*/
+	__commit_notify(group);
+#endif
+}
+
+#ifdef USE_PARALLEL_RETAIN
+static void __request_data_free(void *base, size_t len, void *usr)
+{
+	free(base);
+}
+#endif
+
+/*写请求加入批次,返回下一个位置*/
+static int __request_write_join(struct eraft_group *group, raft_batch_t *bat, int i, struct eraft_taskis_request_write *object)
+{
+	for (int j = 0; j < object->count; j++) {
+		raft_entry_t *ety = NULL;
+
+		if (object->iobuf) {
+			/*日志只保存缓冲区指针,并持有一个引用*/
+			struct eraft_iobuf *iobuf = eraft_iobuf_get(object->iobuf[j]);
+			ety = raft_entry_make(raft_get_current_term(group->raft),
+					rand(), ERAFT_LOGTYPE_IOBUF,
+					&iobuf, sizeof(iobuf));
+		} else {
+#ifdef USE_PARALLEL_RETAIN
+			/*复制一次到共享缓冲区,落盘副本只增加引用*/
+			size_t                  len = object->request[j].iov_len;
+			void                    *base = malloc(len ? len : 1);
+			memcpy(base, object->request[j].iov_base, len);
+			struct eraft_iobuf      *iobuf = eraft_iobuf_make(base, len, __request_data_free, NULL);
+			ety = raft_entry_make(raft_get_current_term(group->raft),
+					rand(), ERAFT_LOGTYPE_IOBUF,
+					&iobuf, sizeof(iobuf));
+#else
+			ety = raft_entry_make(raft_get_current_term(group->raft),
+					rand(), RAFT_LOGTYPE_NORMAL,
+					object->request[j].iov_base, object->request[j].iov_len);
+#endif
+		}
+
+		raft_batch_join_entry(bat, i++, ety);
+	}
+
+	/*请求数据已复制到日志*/
+	ATOMIC_SET(&object->state, ERAFT_REQUEST_SUBMITTED);
+	return i;
+}
+
+/*取出待执行的请求,调用者已超时返回的请求直接回收*/
+static bool __request_claim(struct eraft_dotask *task)
+{
+	if (task->type == ERAFT_TASK_REQUEST_WRITE) {
+		struct eraft_taskis_request_write *object = list_entry(task, struct eraft_taskis_request_write, base);
+
+		if (ATOMIC_CASB(&object->state, ERAFT_REQUEST_PENDING, ERAFT_REQUEST_MERGING)) {
+			return true;
+		}
+
+		assert(object->state == ERAFT_REQUEST_DETACHED);
+		etask_free(object->etask);
+		eraft_taskis_request_write_free(object);
+	} else {
+		struct eraft_taskis_request_read *object = list_entry(task, struct eraft_taskis_request_read, base);
+
+		if (ATOMIC_CASB(&object->state, ERAFT_REQUEST_PENDING, ERAFT_REQUEST_MERGING)) {
+			return true;
+		}
+
+		assert(object->state == ERAFT_REQUEST_DETACHED);
+		etask_free(object->etask);
+		eraft_taskis_request_read_free(object);
+	}
+
+	return false;
+}
+
+/*未加入日志的写请求以result结束*/
+static void __request_write_reject(struct eraft_dotask *task, int result)
+{
+	if (!__request_claim(task)) {
+		return;
+	}
+
+	struct eraft_taskis_request_write *object = list_entry(task, struct eraft_taskis_request_write, base);
+
+	ATOMIC_SET(&object->state, ERAFT_REQUEST_SUBMITTED);
+	object->result = result;
+	__request_write_finish(object);
+}
+
+/*group删除时结束排队和进行中的写请求,仍在日志线程的批次完成时找不到group再结束*/
+static void __request_write_clean(struct eraft_group *group, int result)
+{
+	while (!list_empty(&group->merge_list)) {
+		struct eraft_dotask *task = list_first_entry(&group->merge_list, struct eraft_dotask, node);
+		list_del(&task->node);
+
+		__request_write_reject(task, result);
+	}
+
+#ifdef USE_PARALLEL_RETAIN
+	if (group->retain_pending.batch) {
+		__log_batch_free(group->retain_pending.batch);
+		__request_write_fail_list(group->retain_pending.usr, result);
+		group->retain_pending.batch = NULL;
+	}
+#endif
+
+	while (!list_empty(&group->retain_done_list)) {
+		struct eraft_taskis_log_retain_done *object = list_first_entry(&group->retain_done_list, struct eraft_taskis_log_retain_done, base.node);
+		list_del(&object->base.node);
+
+		__log_batch_free(object->batch);
+
+		if (object->usr) {
+			__request_write_fail_list(object->usr, result);
+		}
+
+		eraft_taskis_log_retain_done_free(object);
+	}
+
+	group->retain_ring.count = 0;
+
+	while (!list_empty(&group->apply_wait_list)) {
+		struct eraft_taskis_log_apply *object = list_first_entry(&group->apply_wait_list, struct eraft_taskis_log_apply, base.node);
+		list_del(&object->base.node);
+
+		__log_batch_drop(object->batch);
+		eraft_taskis_log_apply_free(object);
+	}
+
+	__request_write_abort(group, 0, result);
+}
+
+/*队首连续的写请求是否需要继续凑批*/
+static bool __merge_write_linger(struct eraft_group *group, struct eraft_dotask *first)
+{
+	if (group->batch.linger_usec <= 0) {
+		return false;
+	}
+
+	/*日志线程空闲,立即落盘*/
+	if (group->batch.adaptive && (group->retain_ring.count == 0)) {
+		return false;
+	}
+
+	/*统计条数和字节数*/
+	int                     entries = 0;
+	size_t                  bytes = 0;
+	struct eraft_dotask     *child = NULL;
+	list_for_each_entry(child, &group->merge_list, node)
+	{
+		struct eraft_taskis_request_write *object = list_entry(child, struct eraft_taskis_request_write, base);
+		entries += object->count;
+		bytes += object->bytes;
+
+		if ((entries >= group->batch.max_entries) || (bytes >= group->batch.max_bytes)) {
+			return false;
+		}
+	}
+
+	struct eraft_evts                       *evts = group->evts;
+	struct eraft_taskis_request_write       *object = list_entry(first, struct eraft_taskis_request_write, base);
+	double                                  expire = object->merge_ts + group->batch.linger_usec / 1000000.0;
+	double                                  now = ev_now(evts->loop);
+
+	if (now >= expire) {
+		return false;
+	}
+
+	/*超时后再合并*/
+	if (!ev_is_active(&group->batch.linger_watcher)) {
+		ev_timer_set(&group->batch.linger_watcher, expire - now, 0.);
+		ev_timer_start(evts->loop, &group->batch.linger_watcher);
+	}
+
+	return true;
+}
+
+/*通过日志读,由日志线程传入未应用的日志*/
+static void __read_remind(struct eraft_group *group, struct eraft_dotask *first)
+{
+	/*if success, log_remind will be called.*/
+	g_default_raft_funcs.log_remind = __raft_log_remind;
+	int e = raft_remind_entries(group->raft, first);
+
+	if (0 != e) {
+		__raft_log_remind_done(e, first);
+	}
+}
+
+#ifdef USE_READ_INDEX
+static double __monotonic_now(void)
+{
+	struct timespec now = {};
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1000000000.0;
+}
+
+/*租约内不会有新leader提交日志*/
+static bool __read_lease_valid(struct eraft_group *group)
+{
+	return group->read_lease.enable &&
+	       (group->read_lease.term == raft_get_current_term(group->raft)) &&
+	       (__monotonic_now() < group->read_lease.expire);
+}
+
+/*唤醒读请求*/
+static void __read_index_fail(struct list_head *list, int result)
+{
+	while (!list_empty(list)) {
+		struct eraft_taskis_request_read *object = list_first_entry(list, struct eraft_taskis_request_read, base.node);
+		list_del(&object->base.node);
+
+		__request_read_finish(object, result);
+	}
+}
+
+/*回复follower的查询*/
+static void __read_index_reply(struct eraft_group *group, struct list_head *list, raft_index_t read_idx, int success)
+{
+	while (!list_empty(list)) {
+		struct eraft_taskis_net_commitidx *object = list_first_entry(list, struct eraft_taskis_net_commitidx, base.node);
+		list_del(&object->base.node);
+
+		msg_commitidx_response_t rsp = {};
+		rsp.term = raft_get_current_term(group->raft);
+		rsp.seq = object->ci->seq;
+		rsp.read_idx = read_idx;
+		rsp.success = success;
+
+		if (object->node) {
+			__send_group_msg(group, object->node, MSG_COMMITIDX_RESPONSE, &rsp, sizeof(rsp));
+		}
+
+		eraft_taskis_net_commitidx_free(object);
+	}
+}
+
+/*无法确认leader身份,放弃未确认的读*/
+static void __read_index_abort(struct eraft_group *group)
+{
+	__read_index_fail(&group->read_index.round_list, RAFT_ERR_NOT_LEADER);
+	__read_index_fail(&group->read_index.next_list, RAFT_ERR_NOT_LEADER);
+	__read_index_reply(group, &group->read_index.remote_round, 0, 0);
+	__read_index_reply(group, &group->read_index.remote_next, 0, 0);
+}
+
+/*当前任期的日志提交前,commit_idx可能落后于之前任期已提交的日志*/
+static bool __read_index_usable(struct eraft_group *group)
+{
+	return raft_is_leader(group->raft) &&
+	       (group->read_index.term == raft_get_current_term(group->raft)) &&
+	       (raft_get_commit_idx(group->raft) >= group->read_index.term_first_idx);
+}
+
+static bool __read_index_busy(struct eraft_group *group)
+{
+	return !list_empty(&group->read_index.round_list) || !list_empty(&group->read_index.remote_round);
+}
+
+static void __read_index_start(struct eraft_group *group);
+
+/*应用到read_idx再执行读*/
+static void __read_index_dispatch(struct eraft_group *group, struct list_head *list, raft_index_t read_idx)
+{
+	struct eraft_evts *evts = group->evts;
+
+	/*串成批次,与日志读的结构一致*/
+	struct eraft_dotask *first = list_first_entry(list, struct eraft_dotask, node);
+	list_del(&first->node);
+
+	struct list_head *head = (struct list_head *)&first->node;
+	INIT_LIST_HEAD(head);
+	list_splice_init(list, head);
+
+	struct eraft_taskis_log_read *object = eraft_taskis_log_read_make(group->identity, eraft_evts_dispose_dotask, evts, evts, read_idx, first);
+
+	if (!list_empty(&group->read_index.apply_wait_list) || (object->read_idx > group->apply_idx)) {
+		list_add_tail(&object->base.node, &group->read_index.apply_wait_list);
+	} else {
+		__log_read_give(evts, object);
+	}
+}
+
+/*多数节点确认后执行本轮的读,并回复follower的查询*/
+static void __read_index_check(struct eraft_group *group)
+{
+	if (group->read_index.forward || !__read_index_busy(group)) {
+		return;
+	}
+
+	if (__builtin_popcountll(group->read_index.acks) < raft_get_num_voting_nodes(group->raft) / 2 + 1) {
+		return;
+	}
+
+	/*从发出心跳算起续租,租约短于选举超时*/
+	if (group->read_lease.enable) {
+		int lease_msec = raft_get_election_timeout(group->raft) - group->read_lease.drift_msec;
+
+		group->read_lease.term = group->read_index.term;
+		group->read_lease.expire = group->read_index.start_mono + MAX(0, lease_msec) / 1000.0;
+	}
+
+	if (!list_empty(&group->read_index.round_list)) {
+		__read_index_dispatch(group, &group->read_index.round_list, group->read_index.read_idx);
+	}
+
+	__read_index_reply(group, &group->read_index.remote_round, group->read_index.read_idx, 1);
+
+	/*本轮进行中到达的读*/
+	__read_index_start(group);
+}
+
+/*leader记录commit_idx并向投票节点发一轮心跳,follower向leader查询commit_idx*/
+static void __read_index_start(struct eraft_group *group)
+{
+	struct eraft_evts *evts = group->evts;
+
+	if (__read_index_busy(group)) {
+		return;
+	}
+
+	if (list_empty(&group->read_index.next_list) && list_empty(&group->read_index.remote_next)) {
+		return;
+	}
+
+	if (!raft_is_leader(group->raft)) {
+		raft_node_t *leader = raft_get_current_leader_node(group->raft);
+
+		/*已不是leader,让follower重新查询*/
+		__read_index_reply(group, &group->read_index.remote_next, 0, 0);
+
+		if (!leader || list_empty(&group->read_index.next_list)) {
+			__read_index_abort(group);
+			return;
+		}
+
+		list_splice_init(&group->read_index.next_list, &group->read_index.round_list);
+		group->read_index.forward = true;
+		group->read_index.seq++;
+		group->read_index.start_ts = ev_now(evts->loop);
+
+		msg_commitidx_t ci = {};
+		ci.term = raft_get_current_term(group->raft);
+		ci.seq = group->read_index.seq;
+		__send_group_msg(group, leader, MSG_COMMITIDX, &ci, sizeof(ci));
+		return;
+	}
+
+	if (!__read_index_usable(group)) {
+		__read_index_abort(group);
+		return;
+	}
+
+	list_splice_init(&group->read_index.next_list, &group->read_index.round_list);
+	list_splice_init(&group->read_index.remote_next, &group->read_index.remote_round);
+	group->read_index.forward = false;
+	group->read_index.seq++;
+	group->read_index.acks = 1ULL << raft_get_nodeid(group->raft);
+	group->read_index.start_ts = ev_now(evts->loop);
+	group->read_index.start_mono = __monotonic_now();
+	group->read_index.read_idx = raft_get_commit_idx(group->raft);
+
+	msg_readindex_t ri = {};
+	ri.term = raft_get_current_term(group->raft);
+	ri.seq = group->read_index.seq;
+
+	for (int i = 0; i < raft_get_num_nodes(group->raft); i++) {
+		raft_node_t *node = raft_get_node_by_idx(group->raft, i);
+
+		if ((raft_node_get_id(node) == raft_get_nodeid(group->raft)) || !raft_node_is_voting(node)) {
+			continue;
+		}
+
+		__send_group_msg(group, node, MSG_READINDEX, &ri, sizeof(ri));
+	}
+
+	/*单节点集群直接确认*/
+	__read_index_check(group);
+}
+
+/*读请求加入下一轮确认,同一轮到达的读共用一次心跳*/
+static void __read_index_join(struct eraft_group *group, struct eraft_dotask *first)
+{
+	if (raft_is_leader(group->raft)) {
+		/*当前任期还没有提交日志,走日志读*/
+		if (!__read_index_usable(group)) {
+			__read_remind(group, first);
+			return;
+		}
+	} else if (!raft_get_current_leader_node(group->raft)) {
+		__raft_log_remind_done(RAFT_ERR_NOT_LEADER, first);
+		return;
+	}
+
+	LIST_HEAD(do_list);
+	list_splice_init(((struct list_head *)&first->node), &do_list);
+	list_add(&first->node, &do_list);
+
+	/*租约内不需要心跳确认*/
+	if (raft_is_leader(group->raft) && __read_lease_valid(group)) {
+		__read_index_dispatch(group, &do_list, raft_get_commit_idx(group->raft));
+		return;
+	}
+
+	list_splice_tail_init(&do_list, &group->read_index.next_list);
+
+	__read_index_start(group);
+}
+
+static void __read_index_response(struct eraft_group *group, raft_node_t *node, msg_readindex_response_t *m)
+{
+	/*已有更高任期,不再是leader*/
+	if (m->term > raft_get_current_term(group->raft)) {
+		__read_index_abort(group);
+		return;
+	}
+
+	if (!m->success || group->read_index.forward || (m->seq != group->read_index.seq)) {
+		return;
+	}
+
+	/*同一节点的重复回复只计一次*/
+	if (!node || !raft_node_is_voting(node)) {
+		return;
+	}
+
+	group->read_index.acks |= 1ULL << raft_node_get_id(node);
+	__read_index_check(group);
+}
+
+/*leader收到follower的查询,与本地读共用一轮心跳*/
+static void __read_index_remote(struct eraft_group *group, struct eraft_taskis_net_commitidx *object)
+{
+	LIST_HEAD(do_list);
+	list_add_tail(&object->base.node, &do_list);
+
+	if (!__read_index_usable(group)) {
+		__read_index_reply(group, &do_list, 0, 0);
+		return;
+	}
+
+	if (__read_lease_valid(group)) {
+		__read_index_reply(group, &do_list, raft_get_commit_idx(group->raft), 1);
+		return;
+	}
+
+	list_splice_tail_init(&do_list, &group->read_index.remote_next);
+
+	__read_index_start(group);
+}
+
+/*follower拿到leader确认的commit_idx,本地应用到该位置后读*/
+static void __read_index_forward_done(struct eraft_group *group, msg_commitidx_response_t *m)
+{
+	if (!group->read_index.forward || (m->seq != group->read_index.seq) || list_empty(&group->read_index.round_list)) {
+		return;
+	}
+
+	if (m->success) {
+		__read_index_dispatch(group, &group->read_index.round_list, m->read_idx);
+	} else {
+		__read_index_fail(&group->read_index.round_list, RAFT_ERR_NOT_LEADER);
+	}
+
+	__read_index_start(group);
+}
+
+/*一个选举超时内未确认,放弃本轮*/
+static void __read_index_periodic(struct eraft_group *group)
+{
+	struct eraft_evts *evts = group->evts;
+
+	if (!__read_index_busy(group)) {
+		return;
+	}
+
+	if ((ev_now(evts->loop) - group->read_index.start_ts) * 1000 < raft_get_election_timeout(group->raft)) {
+		return;
+	}
+
+	__read_index_fail(&group->read_index.round_list, RAFT_ERR_NOT_LEADER);
+	__read_index_reply(group, &group->read_index.remote_round, 0, 0);
+	__read_index_start(group);
+}
+
+/*删除group时唤醒所有等待的读*/
+static void __read_index_clean(struct eraft_group *group)
+{
+	__read_index_abort(group);
+
+	while (!list_empty(&group->read_index.apply_wait_list)) {
+		struct eraft_taskis_log_read *object = list_first_entry(&group->read_index.apply_wait_list, struct eraft_taskis_log_read, base.node);
+		list_del(&object->base.node);
+
+		__raft_log_remind_done(RAFT_ERR_NOT_LEADER, object->usr);
+		eraft_taskis_log_read_free(object);
+	}
+}
+#endif /* ifdef USE_READ_INDEX */
+
 void do_merge_task(struct eraft_group *group)
 {
 	if (list_empty(&group->merge_list)) {
 		return;
 	}
 
-	/*没有冲突的读写可以并行执行*/
 	struct eraft_dotask *first = list_first_entry(&group->merge_list, struct eraft_dotask, node);
 
-	if (first->type == ERAFT_TASK_REQUEST_WRITE) {
-		/*写需要串行执行*/
-		if (group->merge_task_state == MERGE_TASK_STATE_STOP) {
-			return;
-		}
+	/*写按批次流水落盘,超过窗口时等待*/
+	if (group->retain_ring.count >= group->retain_window) {
+		return;
+	}
+
+	if (__merge_write_linger(group, first)) {
+		return;
 	}
 
 	/*采取所有执行任务*/
@@ -1158,87 +2822,136 @@ void do_merge_task(struct eraft_group *group)
 	list_splice_init(&group->merge_list, &do_list);
 
 	/*摘取第一个task*/
-	first = list_first_entry(&do_list, struct eraft_dotask, node);
-	list_del(&first->node);
+	first = NULL;
+
+	while (!list_empty(&do_list)) {
+		struct eraft_dotask *task = list_first_entry(&do_list, struct eraft_dotask, node);
+		list_del(&task->node);
+
+		if (__request_claim(task)) {
+			first = task;
+			break;
+		}
+	}
+
+	if (!first) {
+		return;
+	}
 
 	assert(sizeof(struct list_head) == sizeof(struct list_node));
 	struct list_head *head = (struct list_head *)&first->node;
 	INIT_LIST_HEAD(head);
 
-	/*摘取一致的task*/
-	struct eraft_dotask *child = NULL;
+	/*摘取后续的写请求,不超过批次上限*/
+	struct eraft_taskis_request_write       *object = list_entry(first, struct eraft_taskis_request_write, base);
+	int                                     entries = object->count;
+	size_t                                  bytes = object->bytes;
+	struct eraft_dotask                     *child = NULL;
+
 	list_for_each_entry(child, &do_list, node)
 	{
-		if (first->type == child->type) {
-			list_del(&child->node);
-			list_add_tail(&child->node, head);
-		} else {
+		object = list_entry(child, struct eraft_taskis_request_write, base);
+
+		if ((entries + object->count > group->batch.max_entries) ||
+			(bytes + object->bytes > group->batch.max_bytes)) {
 			break;
 		}
+
+		entries += object->count;
+		bytes += object->bytes;
+
+		list_del(&child->node);
+
+		if (__request_claim(child)) {
+			list_add_tail(&child->node, head);
+		}
 	}
 
 	/*放置回去*/
 	list_splice_init(&do_list, &group->merge_list);
 
-	int type = first->type;
+	/*统计条数*/
+	object = list_entry(first, struct eraft_taskis_request_write, base);
+	int num = object->count;
 
-	if (type == ERAFT_TASK_REQUEST_WRITE) {
-		/*统计条数*/
-		int num = 1;
-
-		if (!list_empty(head)) {
-			list_for_each_entry(child, head, node)
-			{
-				num++;
-			}
+	if (!list_empty(head)) {
+		list_for_each_entry(child, head, node)
+		{
+			object = list_entry(child, struct eraft_taskis_request_write, base);
+			num += object->count;
 		}
+	}
 
-		/*合并请求*/
-		raft_batch_t *bat = raft_batch_make(num);
+	/*合并请求*/
+	raft_batch_t    *bat = raft_batch_make(num);
+	int             i = 0;
 
-		struct eraft_taskis_request_write       *object = list_entry(first, struct eraft_taskis_request_write, base);
-		raft_entry_t                            *ety = raft_entry_make(raft_get_current_term(group->raft),
-				rand(), RAFT_LOGTYPE_NORMAL,
-				object->request->iov_base, object->request->iov_len);
-		raft_batch_join_entry(bat, 0, ety);
+	object = list_entry(first, struct eraft_taskis_request_write, base);
+	i = __request_write_join(group, bat, i, object);
 
-		if (!list_empty(head)) {
-			int i = 1;
-			list_for_each_entry(child, head, node)
-			{
-				object = list_entry(child, struct eraft_taskis_request_write, base);
-				ety = raft_entry_make(raft_get_current_term(group->raft),
-						rand(), RAFT_LOGTYPE_NORMAL,
-						object->request->iov_base, object->request->iov_len);
-				raft_batch_join_entry(bat, i++, ety);
-			}
+	if (!list_empty(head)) {
+		list_for_each_entry(child, head, node)
+		{
+			object = list_entry(child, struct eraft_taskis_request_write, base);
+			i = __request_write_join(group, bat, i, object);
 		}
+	}
 
-		/*停止新请求*/
-		group->merge_task_state = MERGE_TASK_STATE_STOP;
-		printf("===stop self===\n");
+	assert(i == num);
 
-		/*if success, log_retain will be called.*/
-		g_default_raft_funcs.log_retain = __raft_log_retain;
-		/*if failed, log_retain_done will be called.*/
-		g_default_raft_funcs.log_retain_done = __raft_log_retain_done;
-		/*start*/
-		int e = raft_retain_entries(group->raft, bat, first);
+	/*if success, log_retain will be called.*/
+	g_default_raft_funcs.log_retain = __raft_log_retain;
+	/*if failed, log_retain_done will be called.*/
+	g_default_raft_funcs.log_retain_done = __raft_log_retain_done;
+	/*start*/
+	int e = raft_retain_entries(group->raft, bat, first);
 
-		if (0 != e) {
-			printf("errno is %d\n", e);
-		}
+	if (0 != e) {
+		printf("errno is %d\n", e);
 	}
 
-	if (type == ERAFT_TASK_REQUEST_READ) {
-		/*if success, log_remind will be called.*/
-		g_default_raft_funcs.log_remind = __raft_log_remind;
-		int e = raft_remind_entries(group->raft, first);
+#ifdef USE_PARALLEL_RETAIN
+	__retain_replicate(group);
+#endif
+}
+
+/*读请求不排在写请求之后,到达即按当前commit_idx处理*/
+static void do_read_task(struct eraft_group *group)
+{
+	struct eraft_dotask *first = NULL;
+
+	while (!list_empty(&group->read_list)) {
+		struct eraft_dotask *task = list_first_entry(&group->read_list, struct eraft_dotask, node);
+		list_del(&task->node);
 
-		if (0 != e) {
-			__raft_log_remind_done(e, first);
+		if (!__request_claim(task)) {
+			continue;
 		}
+
+		if (!first) {
+			first = task;
+			INIT_LIST_HEAD((struct list_head *)&first->node);
+		} else {
+			list_add_tail(&task->node, (struct list_head *)&first->node);
+		}
+	}
+
+	if (!first) {
+		return;
 	}
+
+#ifdef USE_READ_INDEX
+	__read_index_join(group, first);
+#else
+	__read_remind(group, first);
+#endif
+}
+
+static void _linger_evcb(struct ev_loop *loop, ev_timer *w, int revents)
+{
+	struct eraft_group *group = w->data;
+
+	do_merge_task(group);
 }
 
 void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
@@ -1253,6 +2966,28 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 		{
 			struct eraft_group *group = eraft_multi_get_group(&evts->multi, task->identity);
 
+			/*group不存在或已删除*/
+			if (!group) {
+				if (task->type == ERAFT_TASK_REQUEST_WRITE) {
+					__request_write_reject(task, ERAFT_ERR_NOT_LEADER);
+				} else if (__request_claim(task)) {
+					__request_read_finish((struct eraft_taskis_request_read *)task, RAFT_ERR_NOT_LEADER);
+				}
+
+				break;
+			}
+
+			/*读写分开排队,读不等待写落盘*/
+			if (task->type == ERAFT_TASK_REQUEST_READ) {
+				list_add_tail(&task->node, &group->read_list);
+
+				do_read_task(group);
+				break;
+			}
+
+			struct eraft_taskis_request_write *object = (struct eraft_taskis_request_write *)task;
+			object->merge_ts = ev_now(evts->loop);
+
 			list_add_tail(&task->node, &group->merge_list);
 
 			do_merge_task(group);
@@ -1264,6 +2999,15 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 			struct eraft_taskis_net_append  *object = (struct eraft_taskis_net_append *)task;
 			struct eraft_group              *group = eraft_multi_get_group(&evts->multi, object->base.identity);
 
+			if (!group) {
+				if (object->ae->n_entries) {
+					__log_batch_free(object->ae->bat);
+				}
+
+				eraft_taskis_net_append_free(object);
+				break;
+			}
+
 			if (object->ae->n_entries) {
 				eraft_tasker_each_stop(&group->peer_tasker);
 				printf("===stop peer===\n");
@@ -1277,6 +3021,19 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 		}
 		break;
 
+		case ERAFT_TASK_NET_SNAPSHOT:
+		{
+			struct eraft_taskis_net_snapshot        *object = (struct eraft_taskis_net_snapshot *)task;
+			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
+
+			if (group) {
+				__snapshot_recv(group, object);
+			}
+
+			eraft_taskis_net_snapshot_free(object);
+		}
+		break;
+
 		/*====================once worker====================*/
 		case ERAFT_TASK_GROUP_ADD:
 		{
@@ -1285,8 +3042,11 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 
 			// eraft_tasker_each_init(&group->self_tasker, evts->loop);
 			eraft_tasker_each_init(&group->peer_tasker, evts->loop);
+			ev_timer_init(&group->batch.linger_watcher, _linger_evcb, 0., 0.);
+			group->batch.linger_watcher.data = group;
 			/* Rejoin cluster */
 			eraft_multi_add_group(&evts->multi, group);
+			__log_trim_check(group);
 
 			/*连接其它节点*/
 			for (int i = 0; i < raft_get_num_nodes(group->raft); i++) {
@@ -1313,9 +3073,28 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 			struct eraft_taskis_group_del *object = (struct eraft_taskis_group_del *)task;
 
 			struct eraft_group *group = eraft_multi_del_group(&evts->multi, object->base.identity);
-			eraft_group_free(group);
 
-			etask_awake(object->etask);
+			if (!group) {
+				etask_awake(object->etask);
+				break;
+			}
+
+			ev_timer_stop(evts->loop, &group->batch.linger_watcher);
+			/*之后到达的任务都找不到group,各自释放*/
+			eraft_tasker_each_flush(&group->peer_tasker);
+			eraft_tasker_each_free(&group->peer_tasker);
+#ifdef USE_READ_INDEX
+			__read_index_clean(group);
+#endif
+			/*进行中的元数据写入使用自己的fd,完成时找不到group即丢弃*/
+			__meta_wait_clean(group);
+			__cfg_wait_clean(group);
+			__request_write_clean(group, ERAFT_ERR_IN_DOUBT);
+
+			/*等日志线程和应用线程处理完之前的任务再释放,由其唤醒调用者*/
+			struct eraft_taskis_group_drain *new_task = eraft_taskis_group_drain_make(group->identity, eraft_evts_dispose_dotask, evts,
+					evts, group, object->etask);
+			__log_journal_give(group, (struct eraft_dotask *)new_task);
 		}
 		break;
 
@@ -1344,19 +3123,26 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 			struct eraft_taskis_log_retain_done     *object = (struct eraft_taskis_log_retain_done *)task;
 			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
 
-			int n_entries = object->batch->n_entries;
-			raft_dispose_entries_cache(group->raft, true, object->batch, object->start_idx);
+			if (!group) {
+				__log_batch_free(object->batch);
+
+				if (object->usr) {
+					__request_write_fail_list(object->usr, ERAFT_ERR_IN_DOUBT);
+				}
+
+				eraft_taskis_log_retain_done_free(object);
+				break;
+			}
 
-			/*first will call send_appendentries*/
-			g_default_raft_funcs.send_appendentries = __raft_send_appendentries;
-			/*then will call log_retain_done*/
-			g_default_raft_funcs.log_retain_done = __raft_log_retain_done;
-			/*start*/
-			raft_async_retain_entries_finish(group->raft, 0, n_entries, object->usr);
+			if (object->result != 0) {
+				__retain_fail_step_down(group);
+			}
 
-			eraft_taskis_log_retain_done_free(object);
+			/*落盘可能乱序返回,按start_idx顺序完成*/
+			list_add_tail(&object->base.node, &group->retain_done_list);
+			__retain_done_in_order(group);
+			__cfg_wait_flush(group);
 
-			group->merge_task_state = MERGE_TASK_STATE_WORK;
 			printf("===call self===\n");
 			do_merge_task(group);
 		}
@@ -1367,11 +3153,19 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 			struct eraft_taskis_log_append_done     *object = (struct eraft_taskis_log_append_done *)task;
 			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
 
-			raft_index_t curr_idx = raft_dispose_entries_cache(group->raft, true, object->batch, object->start_idx);
+			if (!group) {
+				__log_batch_free(object->batch);
+				eraft_taskis_log_append_done_free(object);
+				break;
+			}
+
+			/*落盘失败则丢弃缓存并拒绝本次追加,由leader重发*/
+			bool            success = (object->result == 0);
+			raft_index_t    curr_idx = raft_dispose_entries_cache(group->raft, success, object->batch, object->start_idx);
 
 			/*it will call send_appendentries_response later.*/
 			g_default_raft_funcs.send_appendentries_response = __raft_send_appendentries_response;
-			raft_async_append_entries_finish(group->raft, object->raft_node, true, object->leader_commit, 1, curr_idx, object->rsp_first_idx);
+			raft_async_append_entries_finish(group->raft, object->raft_node, success, object->leader_commit, 1, curr_idx, object->rsp_first_idx);
 
 			eraft_taskis_log_append_done_free(object);
 
@@ -1385,9 +3179,138 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 			struct eraft_taskis_log_apply_done      *object = (struct eraft_taskis_log_apply_done *)task;
 			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
 
+			if (!group) {
+				__log_batch_drop(object->batch);
+				eraft_taskis_log_apply_done_free(object);
+				break;
+			}
+
 			raft_async_apply_entries_finish(group->raft, true, object->batch, object->start_idx);
 
+			/* We save the commit idx for performance reasons.
+			 * Restart only reloads the entries after it, written in the periodic callback. */
+			group->meta.commit_idx = raft_get_last_applied_idx(group->raft);
+
 			eraft_taskis_log_apply_done_free(object);
+
+			__log_trim_check(group);
+			__snapshot_check(group);
+		}
+		break;
+
+		case ERAFT_TASK_SNAP_SAVE_DONE:
+		{
+			struct eraft_taskis_snap_save_done      *object = (struct eraft_taskis_snap_save_done *)task;
+			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
+
+			if (!group) {
+				eraft_taskis_snap_save_done_free(object);
+				break;
+			}
+
+			group->snapshot.saving = false;
+
+			if (object->result != 0) {
+				/*raft无法取消进行中的快照*/
+				printf("snapshot %d save failed: %d\n", object->last_idx, object->result);
+				abort();
+			}
+
+			/*先切换快照文件,再由raft移除日志,log_poll随之删除日志存储*/
+			eraft_snapshot_advance(&group->snapshot.file, object->last_idx, object->last_term);
+			int e = raft_end_snapshot(group->raft);
+			assert(e == 0);
+
+			eraft_taskis_snap_save_done_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_META_SAVE_DONE:
+		{
+			struct eraft_taskis_meta_save_done      *object = (struct eraft_taskis_meta_save_done *)task;
+			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
+
+			/*group已删除,或同名group重新加载后不是它发起的写入*/
+			if (!group || !group->meta.saving || (object->seq != group->meta.seq + 1)) {
+				eraft_taskis_meta_save_done_free(object);
+				break;
+			}
+
+			struct eraft_meta *meta = &group->meta;
+
+			meta->saving = false;
+
+			if (object->result == 0) {
+				meta->seq = object->seq;
+				meta->synced_commit_idx = object->commit_idx;
+				meta->pending = false;
+
+				/*写入期间又有修改,落盘后再发送*/
+				if (meta->dirty) {
+					__meta_save_give(group);
+				} else {
+					__meta_wait_flush(group);
+				}
+			} else {
+				/*保留缓存的消息,下个周期重试*/
+				printf("meta %llu save failed: %d\n", (unsigned long long)object->seq, object->result);
+				meta->dirty |= meta->pending;
+				meta->pending = false;
+			}
+
+			eraft_taskis_meta_save_done_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_SNAP_RECV_DONE:
+		{
+			struct eraft_taskis_snap_recv_done      *object = (struct eraft_taskis_snap_recv_done *)task;
+			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
+
+			if (group) {
+				__snapshot_received(group, object);
+			}
+
+			eraft_taskis_snap_recv_done_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_SNAP_READ_DONE:
+		{
+			struct eraft_taskis_snap_read_done      *object = (struct eraft_taskis_snap_read_done *)task;
+			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
+
+			if (group) {
+				__snapshot_chunk_ready(group, object);
+			}
+
+			eraft_taskis_snap_read_done_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_SNAP_LOAD_DONE:
+		{
+			struct eraft_taskis_snap_load_done      *object = (struct eraft_taskis_snap_load_done *)task;
+			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
+
+			if (group) {
+				__snapshot_installed(group, object);
+			}
+
+			eraft_taskis_snap_load_done_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_NET_SNAPSHOT_RESPONSE:
+		{
+			struct eraft_taskis_net_snapshot_response       *object = (struct eraft_taskis_net_snapshot_response *)task;
+			struct eraft_group                              *group = eraft_multi_get_group(&evts->multi, object->base.identity);
+
+			if (group) {
+				__snapshot_send_next(group, object->node, object->snr);
+			}
+
+			eraft_taskis_net_snapshot_response_free(object);
 		}
 		break;
 
@@ -1395,27 +3318,111 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 		{
 			struct eraft_taskis_net_append_response *object = (struct eraft_taskis_net_append_response *)task;
 			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
-			int                                     e = raft_recv_appendentries_response(group->raft, object->node, object->aer);
+
+			if (!group) {
+				eraft_taskis_net_append_response_free(object);
+				break;
+			}
+
+			int e = raft_recv_appendentries_response(group->raft, object->node, object->aer);
 			assert(e == 0);
-			/*FIXME*/
-			int     first_idx = object->aer->first_idx;
-			int     over_idx = raft_get_commit_idx(group->raft);
 
 			// TODO: term not same, set task result is failed.
-			for (int id = first_idx; id <= over_idx; id++) {
-				// printf("<---%d\n", id);
-				etask_tree_awake_task(evts->wait_idx_tree, &id, sizeof(id));
-			}
+			__commit_notify(group);
 
 			eraft_taskis_net_append_response_free(object);
 		}
 		break;
 
+#ifdef USE_READ_INDEX
+		case ERAFT_TASK_NET_READINDEX:
+		{
+			struct eraft_taskis_net_readindex       *object = (struct eraft_taskis_net_readindex *)task;
+			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
+
+			if (!group) {
+				eraft_taskis_net_readindex_free(object);
+				break;
+			}
+
+			/*任期不低于自己即承认其leader身份*/
+			msg_readindex_response_t rsp = {};
+			rsp.term = raft_get_current_term(group->raft);
+			rsp.seq = object->ri->seq;
+			rsp.success = (object->ri->term >= rsp.term) ? 1 : 0;
+
+			if (rsp.success) {
+				group->read_lease.granted = __monotonic_now();
+			}
+
+			if (object->node) {
+				__send_group_msg(group, object->node, MSG_READINDEX_RESPONSE, &rsp, sizeof(rsp));
+			}
+
+			eraft_taskis_net_readindex_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_NET_READINDEX_RESPONSE:
+		{
+			struct eraft_taskis_net_readindex_response      *object = (struct eraft_taskis_net_readindex_response *)task;
+			struct eraft_group                              *group = eraft_multi_get_group(&evts->multi, object->base.identity);
+
+			if (group) {
+				__read_index_response(group, object->node, object->rir);
+			}
+
+			eraft_taskis_net_readindex_response_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_NET_COMMITIDX:
+		{
+			struct eraft_taskis_net_commitidx       *object = (struct eraft_taskis_net_commitidx *)task;
+			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
+
+			if (!group) {
+				eraft_taskis_net_commitidx_free(object);
+				break;
+			}
+
+			/*回复后释放*/
+			__read_index_remote(group, object);
+		}
+		break;
+
+		case ERAFT_TASK_NET_COMMITIDX_RESPONSE:
+		{
+			struct eraft_taskis_net_commitidx_response      *object = (struct eraft_taskis_net_commitidx_response *)task;
+			struct eraft_group                              *group = eraft_multi_get_group(&evts->multi, object->base.identity);
+
+			if (group) {
+				__read_index_forward_done(group, object->cir);
+			}
+
+			eraft_taskis_net_commitidx_response_free(object);
+		}
+		break;
+#endif /* ifdef USE_READ_INDEX */
+
 		case ERAFT_TASK_NET_VOTE:
 		{
 			struct eraft_taskis_net_vote    *object = (struct eraft_taskis_net_vote *)task;
 			struct eraft_group              *group = eraft_multi_get_group(&evts->multi, object->base.identity);
 
+			if (!group) {
+				eraft_taskis_net_vote_free(object);
+				break;
+			}
+
+#ifdef USE_READ_INDEX
+			/*确认过leader心跳后一个选举超时内不投票,leader的租约依赖于此,不论本节点是否开启租约读*/
+			if ((__monotonic_now() - group->read_lease.granted) * 1000 < raft_get_election_timeout(group->raft)) {
+				eraft_taskis_net_vote_free(object);
+				break;
+			}
+#endif
+
 			/*it will call send_requestvote_response later.*/
 			g_default_raft_funcs.send_requestvote_response = __raft_send_requestvote_response;
 			int e = raft_recv_requestvote(group->raft, object->node, object->rv);
@@ -1428,7 +3435,13 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 		{
 			struct eraft_taskis_net_vote_response   *object = (struct eraft_taskis_net_vote_response *)task;
 			struct eraft_group                      *group = eraft_multi_get_group(&evts->multi, object->base.identity);
-			int                                     e = raft_recv_requestvote_response(group->raft, object->node, object->rvr);
+
+			if (!group) {
+				eraft_taskis_net_vote_response_free(object);
+				break;
+			}
+
+			int e = raft_recv_requestvote_response(group->raft, object->node, object->rvr);
 			assert(e == 0);
 			printf("Leader is %d\n", raft_get_current_leader(group->raft));
 			eraft_taskis_net_vote_response_free(object);
@@ -1436,18 +3449,42 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 		break;
 
 		/*====================log worker====================*/
+		case ERAFT_TASK_GROUP_LOAD:
+		{
+			struct eraft_taskis_group_load  *object = (struct eraft_taskis_group_load *)task;
+			struct eraft_group              *group = eraft_group_make(object->base.identity, object->selfidx,
+					object->db_path, object->db_size, object->wfcb, object->rfcb);
+
+			group->evts = evts;
+			eraft_group_set_snapshot(group, object->save_fcb, object->load_fcb);
+			eraft_group_reload(group);
+
+			object->group = group;
+			etask_awake(object->etask);
+		}
+		break;
+
+		case ERAFT_TASK_GROUP_DRAIN:
+		{
+			struct eraft_taskis_group_drain *object = (struct eraft_taskis_group_drain *)task;
+			struct eraft_group              *group = object->group;
+
+			/*之前的落盘任务已处理,关闭时等待异步提交的回调完成*/
+			eraft_journal_close(&group->journal);
+
+			struct eraft_taskis_group_free *new_task = eraft_taskis_group_free_make(group->identity, eraft_evts_dispose_dotask, evts, group, object->etask);
+			__snapshot_apply_give(group, (struct eraft_dotask *)new_task);
+
+			eraft_taskis_group_drain_free(object);
+		}
+		break;
+
 		case ERAFT_TASK_LOG_RETAIN:
 		{
 			struct eraft_taskis_log_retain *object = (struct eraft_taskis_log_retain *)task;
 			printf("-----%d\n", object->start_idx);
-			int e = __set_append_log_batch(object->journal, object->batch, object->start_idx);
-			assert(0 == e);
-
-			/*移交给raft线程去处理*/
-			struct eraft_taskis_log_retain_done *new_task = eraft_taskis_log_retain_done_make(object->base.identity, eraft_evts_dispose_dotask, evts, object->batch, object->start_idx, object->usr);
-			eraft_tasker_once_give(&object->evts->tasker, (struct eraft_dotask *)new_task);
-
-			eraft_taskis_log_retain_free(object);
+			/*结果在__log_retain_commit_fcb中处理*/
+			__set_append_log_batch(object->journal, object->batch, object->start_idx, __log_retain_commit_fcb, object);
 		}
 		break;
 
@@ -1458,37 +3495,19 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 
 			struct eraft_dotask *first = (struct eraft_dotask *)object->usr;
 			assert(first->type == ERAFT_TASK_REQUEST_READ);
-			struct list_head *head = (struct list_head *)&first->node;
-
-			struct eraft_dotask *child = NULL;
-			/*统计条数*/
-			int new_count = 1;
-
-			if (!list_empty(head)) {
-				list_for_each_entry(child, head, node)
-				{
-					new_count++;
-				}
-			}
-
-			struct iovec *new_requests = calloc(new_count, sizeof(struct iovec));
 
-			struct eraft_taskis_request_read *obj = list_entry(first, struct eraft_taskis_request_read, base);
-			new_requests[0].iov_base = obj->request->iov_base;
-			new_requests[0].iov_len = obj->request->iov_len;
+			struct eraft_group *group = eraft_multi_get_group(&object->evts->multi, object->base.identity);
 
-			if (!list_empty(head)) {
-				int i = 1;
-				list_for_each_entry(child, head, node)
-				{
-					obj = list_entry(child, struct eraft_taskis_request_read, base);
-					new_requests[i].iov_base = obj->request->iov_base;
-					new_requests[i].iov_len = obj->request->iov_len;
-					i++;
-				}
+			if (!group) {
+				__log_batch_drop(object->batch);
+				__raft_log_remind_done(RAFT_ERR_NOT_LEADER, first);
+				eraft_taskis_log_remind_free(object);
+				break;
 			}
 
-			struct eraft_group *group = eraft_multi_get_group(&object->evts->multi, object->base.identity);
+			struct iovec                    *new_requests = NULL;
+			struct eraft_read_result        *new_results = NULL;
+			int                             new_count = __read_requests_make(first, &new_requests, &new_results);
 
 			{
 				raft_batch_t *bat = object->batch;
@@ -1502,13 +3521,12 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 					for (int i = 0; i < old_count; i++) {
 						raft_entry_t *ety = raft_batch_view_entry(bat, i);
 
-						old_requests[i].iov_base = ety->data.buf;
-						old_requests[i].iov_len = ety->data.len;
+						eraft_iobuf_entry_view(ety, &old_requests[i]);
 					}
 				}
 
 				if (group->log_apply_rfcb) {
-					group->log_apply_rfcb(group, old_requests, old_count, new_requests, new_count);
+					group->log_apply_rfcb(group, old_requests, old_count, new_requests, new_results, new_count);
 				}
 
 				if (old_count) {
@@ -1524,26 +3542,217 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 				raft_batch_free(bat);
 			}
 
+			__read_results_done(first, new_results);
 			__raft_log_remind_done(0, first);
 
 			free(new_requests);
+			free(new_results);
 
 			eraft_taskis_log_remind_free(object);
 		}
 		break;
 
+#ifdef USE_READ_INDEX
+		case ERAFT_TASK_LOG_READ:
+		{
+			struct eraft_taskis_log_read    *object = (struct eraft_taskis_log_read *)task;
+			struct eraft_group              *group = eraft_multi_get_group(&object->evts->multi, object->base.identity);
+			struct eraft_dotask             *first = (struct eraft_dotask *)object->usr;
+
+			if (!group) {
+				__raft_log_remind_done(RAFT_ERR_NOT_LEADER, first);
+				eraft_taskis_log_read_free(object);
+				break;
+			}
+
+			struct iovec                    *new_requests = NULL;
+			struct eraft_read_result        *new_results = NULL;
+			int                             new_count = __read_requests_make(first, &new_requests, &new_results);
+
+			/*read_idx之前的日志都已应用*/
+			if (group->log_apply_rfcb && new_count) {
+				group->log_apply_rfcb(group, NULL, 0, new_requests, new_results, new_count);
+			}
+
+			__read_results_done(first, new_results);
+			__raft_log_remind_done(0, first);
+
+			free(new_requests);
+			free(new_results);
+
+			eraft_taskis_log_read_free(object);
+		}
+		break;
+#endif /* ifdef USE_READ_INDEX */
+
 		case ERAFT_TASK_LOG_APPEND:
 		{
 			struct eraft_taskis_log_append *object = (struct eraft_taskis_log_append *)task;
 			// printf("-----%d\n", start_idx);
-			int e = __set_append_log_batch(object->journal, object->batch, object->start_idx);
-			assert(0 == e);
+			/*结果在__log_append_commit_fcb中处理*/
+			__set_append_log_batch(object->journal, object->batch, object->start_idx, __log_append_commit_fcb, object);
+		}
+		break;
 
-			/*移交给raft线程去处理*/
-			struct eraft_taskis_log_append_done *new_task = eraft_taskis_log_append_done_make(object->base.identity, eraft_evts_dispose_dotask, evts, object->evts, object->batch, object->start_idx, object->raft_node, object->leader_commit, object->rsp_first_idx);
+		case ERAFT_TASK_LOG_TRIM:
+		{
+			struct eraft_taskis_log_trim    *object = (struct eraft_taskis_log_trim *)task;
+			void                            *txn = eraft_journal_tx_begin(object->journal);
+
+			if (eraft_journal_trim(object->journal, txn, object->trim_idx) == 0) {
+				eraft_journal_tx_commit(object->journal, txn);
+			} else {
+				printf("journal trim to %d failed\n", object->trim_idx);
+				eraft_journal_tx_abort(object->journal, txn);
+			}
+
+			eraft_taskis_log_trim_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_LOG_POP:
+		{
+			struct eraft_taskis_log_pop     *object = (struct eraft_taskis_log_pop *)task;
+			void                            *txn = eraft_journal_tx_begin(object->journal);
+
+			if (eraft_journal_pop(object->journal, txn, object->pop_idx) == 0) {
+				eraft_journal_tx_commit(object->journal, txn);
+			} else {
+				printf("journal pop from %d failed\n", object->pop_idx);
+				eraft_journal_tx_abort(object->journal, txn);
+			}
+
+			eraft_taskis_log_pop_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_SNAP_SAVE:
+		{
+			struct eraft_taskis_snap_save   *object = (struct eraft_taskis_snap_save *)task;
+			struct eraft_group              *group = eraft_multi_get_group(&object->evts->multi, object->base.identity);
+
+			if (!group) {
+				eraft_taskis_snap_save_free(object);
+				break;
+			}
+
+			char *path = eraft_snapshot_temp_path(&group->snapshot.file);
+
+			/*之前的日志都已在本线程应用,状态机正好对应last_idx*/
+			int e = group->snapshot.save_fcb(group, path, object->last_idx, object->last_term);
+
+			if (e == 0) {
+				e = eraft_snapshot_commit(&group->snapshot.file, path, object->last_idx, object->last_term);
+			} else {
+				unlink(path);
+			}
+
+			free(path);
+
+			struct eraft_taskis_snap_save_done *new_task = eraft_taskis_snap_save_done_make(group->identity, eraft_evts_dispose_dotask, evts,
+					object->last_idx, object->last_term, e);
+			eraft_tasker_once_give(&object->evts->tasker, (struct eraft_dotask *)new_task);
+
+			eraft_taskis_snap_save_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_META_SAVE:
+		{
+			struct eraft_taskis_meta_save   *object = (struct eraft_taskis_meta_save *)task;
+
+			int e = eraft_meta_write(object->fd, object->seq, object->term, object->voted_for, object->commit_idx);
+
+			if (object->fd >= 0) {
+				close(object->fd);
+			}
+
+			struct eraft_taskis_meta_save_done *new_task = eraft_taskis_meta_save_done_make(object->base.identity, eraft_evts_dispose_dotask, evts,
+					object->seq, object->commit_idx, e);
+			eraft_tasker_once_give(&object->evts->tasker, (struct eraft_dotask *)new_task);
+
+			eraft_taskis_meta_save_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_SNAP_RECV:
+		{
+			struct eraft_taskis_snap_recv   *object = (struct eraft_taskis_snap_recv *)task;
+			struct eraft_group              *group = eraft_multi_get_group(&object->evts->multi, object->base.identity);
+			msg_snapshot_t                  *sn = &object->sn;
+
+			if (!group) {
+				eraft_taskis_snap_recv_free(object);
+				break;
+			}
+
+			/*写入和最后一段的落盘改名都在本线程,接收状态只在本线程修改*/
+			int e = eraft_snapshot_recv(&group->snapshot.file, sn->last_idx, sn->last_term, sn->offset, object->data, sn->len, sn->done);
+
+			struct eraft_taskis_snap_recv_done *new_task = eraft_taskis_snap_recv_done_make(group->identity, eraft_evts_dispose_dotask, evts,
+					sn->last_idx, sn->last_term, group->snapshot.file.recv.offset, sn->done, object->node, e);
+			eraft_tasker_once_give(&object->evts->tasker, (struct eraft_dotask *)new_task);
+
+			eraft_taskis_snap_recv_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_SNAP_READ:
+		{
+			struct eraft_taskis_snap_read   *object = (struct eraft_taskis_snap_read *)task;
+			struct eraft_group              *group = eraft_multi_get_group(&object->evts->multi, object->base.identity);
+
+			if (!group) {
+				eraft_taskis_snap_read_free(object);
+				break;
+			}
+
+			char            *chunk = malloc(DEFAULT_SNAPSHOT_CHUNK_SIZE);
+			uint64_t        total = 0;
+			ssize_t         len = eraft_snapshot_read(&group->snapshot.file, object->last_idx, object->last_term,
+					object->offset, chunk, DEFAULT_SNAPSHOT_CHUNK_SIZE, &total);
+
+			struct eraft_taskis_snap_read_done *new_task = eraft_taskis_snap_read_done_make(group->identity, eraft_evts_dispose_dotask, evts,
+					object->node_id, object->last_idx, object->last_term, object->offset, chunk, len, total);
+			eraft_tasker_once_give(&object->evts->tasker, (struct eraft_dotask *)new_task);
+
+			eraft_taskis_snap_read_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_SNAP_LOAD:
+		{
+			struct eraft_taskis_snap_load   *object = (struct eraft_taskis_snap_load *)task;
+			struct eraft_group              *group = eraft_multi_get_group(&object->evts->multi, object->base.identity);
+
+			if (!group) {
+				eraft_taskis_snap_load_free(object);
+				break;
+			}
+
+			char *path = eraft_snapshot_path(&group->snapshot.file, object->last_idx, object->last_term);
+
+			int e = group->snapshot.load_fcb(group, path, object->last_idx, object->last_term);
+
+			free(path);
+
+			struct eraft_taskis_snap_load_done *new_task = eraft_taskis_snap_load_done_make(group->identity, eraft_evts_dispose_dotask, evts,
+					object->last_idx, object->last_term, object->node, e);
 			eraft_tasker_once_give(&object->evts->tasker, (struct eraft_dotask *)new_task);
 
-			eraft_taskis_log_append_free(object);
+			eraft_taskis_snap_load_free(object);
+		}
+		break;
+
+		case ERAFT_TASK_GROUP_FREE:
+		{
+			struct eraft_taskis_group_free *object = (struct eraft_taskis_group_free *)task;
+
+			/*之前的应用和快照任务已处理*/
+			eraft_group_free(object->group);
+			etask_awake(object->etask);
+
+			eraft_taskis_group_free_free(object);
 		}
 		break;
 
@@ -1552,6 +3761,12 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 			struct eraft_taskis_log_apply   *object = (struct eraft_taskis_log_apply *)task;
 			struct eraft_group              *group = eraft_multi_get_group(&object->evts->multi, object->base.identity);
 
+			if (!group) {
+				__log_batch_drop(object->batch);
+				eraft_taskis_log_apply_free(object);
+				break;
+			}
+
 			raft_batch_t *bat = object->batch;
 
 			int             new_count = bat->n_entries;
@@ -1563,8 +3778,7 @@ void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr)
 				for (int i = 0; i < new_count; i++) {
 					raft_entry_t *ety = raft_batch_view_entry(bat, i);
 
-					new_requests[i].iov_base = ety->data.buf;
-					new_requests[i].iov_len = ety->data.len;
+					eraft_iobuf_entry_view(ety, &new_requests[i]);
 				}
 			}
 
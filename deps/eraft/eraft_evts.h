@@ -31,8 +31,6 @@ struct eraft_evts
 	struct eraft_worker             journal_worker[MAX_JOURNAL_WORKER];
 	struct eraft_worker             apply_worker[MAX_APPLY_WORKER];
 
-	void                            *wait_idx_tree;
-
 	void                            *ctx;
 };
 
@@ -47,3 +45,6 @@ void eraft_evts_once(struct eraft_evts *evts);
 
 void eraft_evts_dispose_dotask(struct eraft_dotask *task, void *usr);
 
+/* 交给日志线程加载group, 同一个group与其日志任务在同一个线程 */
+void eraft_evts_load_group(struct eraft_evts *evts, struct eraft_dotask *task);
+
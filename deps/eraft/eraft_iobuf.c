@@ -0,0 +1,34 @@
+#include "eraft_iobuf.h"
+
+struct eraft_iobuf *eraft_iobuf_make(void *base, size_t len, ERAFT_IOBUF_FREE_FCB fcb, void *usr)
+{
+	struct eraft_iobuf *iobuf = calloc(1, sizeof(*iobuf));
+
+	iobuf->refs = 1;
+	iobuf->base = base;
+	iobuf->len = len;
+	iobuf->fcb = fcb;
+	iobuf->usr = usr;
+	return iobuf;
+}
+
+struct eraft_iobuf *eraft_iobuf_get(struct eraft_iobuf *iobuf)
+{
+	ATOMIC_INC(&iobuf->refs);
+	return iobuf;
+}
+
+void eraft_iobuf_put(struct eraft_iobuf *iobuf)
+{
+	int refs = ATOMIC_SUB_F(&iobuf->refs, 1);
+
+	assert(refs >= 0);
+
+	if (refs == 0) {
+		if (iobuf->fcb) {
+			iobuf->fcb(iobuf->base, iobuf->len, iobuf->usr);
+		}
+
+		free(iobuf);
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include "raft.h"
+#include "eraft_utils.h"
+
+/*
+ * 带引用计数的写数据缓冲区.
+ * 以ERAFT_LOGTYPE_IOBUF类型的日志保存缓冲区指针, 数据在批次, 落盘和网络发送间共享,
+ * 落盘和发送时展开为RAFT_LOGTYPE_NORMAL.
+ */
+#define ERAFT_LOGTYPE_IOBUF (RAFT_LOGTYPE_NUM + 1)
+
+typedef void (*ERAFT_IOBUF_FREE_FCB)(void *base, size_t len, void *usr);
+
+struct eraft_iobuf
+{
+	int                     refs;
+	void                    *base;
+	size_t                  len;
+
+	ERAFT_IOBUF_FREE_FCB    fcb;	/*引用归零时调用, 为NULL时不释放base*/
+	void                    *usr;
+};
+
+/* 创建缓冲区, 引用计数为1 */
+struct eraft_iobuf      *eraft_iobuf_make(void *base, size_t len, ERAFT_IOBUF_FREE_FCB fcb, void *usr);
+
+/* 增加引用 */
+struct eraft_iobuf      *eraft_iobuf_get(struct eraft_iobuf *iobuf);
+
+/* 减少引用, 归零时释放 */
+void eraft_iobuf_put(struct eraft_iobuf *iobuf);
+
+/* 日志引用的缓冲区, 非IOBUF类型返回NULL */
+static inline struct eraft_iobuf *eraft_iobuf_by_entry(raft_entry_t *ety)
+{
+	return (ety->type == ERAFT_LOGTYPE_IOBUF) ? *(struct eraft_iobuf **)ety->data.buf : NULL;
+}
+
+/* 日志的实际数据 */
+static inline void eraft_iobuf_entry_view(raft_entry_t *ety, struct iovec *iov)
+{
+	struct eraft_iobuf *iobuf = eraft_iobuf_by_entry(ety);
+
+	if (iobuf) {
+		iov->iov_base = iobuf->base;
+		iov->iov_len = iobuf->len;
+	} else {
+		iov->iov_base = ety->data.buf;
+		iov->iov_len = ety->data.len;
+	}
+}
+
+/* 展开为普通日志, 用于落盘和网络发送 */
+static inline void eraft_iobuf_entry_expand(raft_entry_t *ety, raft_entry_t *out)
+{
+	struct iovec iov;
+
+	eraft_iobuf_entry_view(ety, &iov);
+
+	*out = *ety;
+
+	if (ety->type == ERAFT_LOGTYPE_IOBUF) {
+		out->type = RAFT_LOGTYPE_NORMAL;
+	}
+
+	out->data.buf = iov.iov_base;
+	out->data.len = iov.iov_len;
+}
@@ -0,0 +1,98 @@
+#include "eraft_utils.h"
+#include "eraft_crc32c.h"
+#include "eraft_meta.h"
+
+#define META_SLOT_SIZE  512	/*每个槽占一个扇区,写入不会跨槽*/
+
+struct meta_record
+{
+	uint64_t        seq;
+	int64_t         term;
+	int64_t         commit_idx;
+	int32_t         voted_for;
+	uint32_t        crc;	/*前面各字段的crc32c*/
+};
+
+static bool __record_valid(struct meta_record *rec)
+{
+	return rec->seq && (rec->crc == eraft_crc32c(0, rec, offsetof(struct meta_record, crc)));
+}
+
+int eraft_meta_init(struct eraft_meta *meta, char *db_path, int selfidx)
+{
+	size_t  path_length = strlen(db_path) + 32;
+	char    path[path_length];
+
+	snprintf(path, path_length, "%s_%d.meta", db_path, selfidx);
+
+	memset(meta, 0, sizeof(*meta));
+	meta->voted_for = -1;
+	meta->fd = open(path, O_CREAT | O_RDWR, 0644);
+
+	if (meta->fd < 0) {
+		printf("meta %s open failed: %s\n", path, strerror(errno));
+		abort();
+	}
+
+	struct meta_record      slots[2] = {};
+	struct meta_record      *last = NULL;
+
+	for (int i = 0; i < 2; i++) {
+		if ((pread(meta->fd, &slots[i], sizeof(slots[i]), i * META_SLOT_SIZE) == sizeof(slots[i])) &&
+			__record_valid(&slots[i]) && (!last || (slots[i].seq > last->seq))) {
+			last = &slots[i];
+		}
+	}
+
+	if (!last) {
+		return -1;
+	}
+
+	meta->seq = last->seq;
+	meta->term = last->term;
+	meta->voted_for = last->voted_for;
+	meta->commit_idx = last->commit_idx;
+	meta->synced_commit_idx = last->commit_idx;
+	return 0;
+}
+
+void eraft_meta_free(struct eraft_meta *meta)
+{
+	if (meta->fd >= 0) {
+		close(meta->fd);
+		meta->fd = -1;
+	}
+}
+
+int eraft_meta_write(int fd, uint64_t seq, raft_term_t term, raft_node_id_t voted_for, raft_index_t commit_idx)
+{
+	struct meta_record rec = {};
+
+	rec.seq = seq;
+	rec.term = term;
+	rec.voted_for = voted_for;
+	rec.commit_idx = commit_idx;
+	rec.crc = eraft_crc32c(0, &rec, offsetof(struct meta_record, crc));
+
+	/*覆盖较旧的槽,最新的记录不受影响*/
+	off_t off = (seq & 1) * META_SLOT_SIZE;
+
+	if ((pwrite(fd, &rec, sizeof(rec), off) != sizeof(rec)) || (fdatasync(fd) != 0)) {
+		printf("meta save failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+int eraft_meta_save(struct eraft_meta *meta)
+{
+	if (eraft_meta_write(meta->fd, meta->seq + 1, meta->term, meta->voted_for, meta->commit_idx) != 0) {
+		return -1;
+	}
+
+	meta->seq++;
+	meta->dirty = false;
+	meta->synced_commit_idx = meta->commit_idx;
+	return 0;
+}
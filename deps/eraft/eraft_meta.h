@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "raft.h"
+
+/*
+ * raft元数据文件, 每个group一个.
+ * 固定长度的记录交替写入A/B两个槽, 每次一次pwrite和一次fdatasync.
+ * 记录带序号和校验, 加载时取校验通过且序号最大的槽, 写入中断时保留另一个槽.
+ */
+struct eraft_meta
+{
+	int             fd;
+	uint64_t        seq;		/*最近写入的记录序号*/
+
+	raft_term_t     term;
+	raft_node_id_t  voted_for;
+	raft_index_t    commit_idx;
+
+	bool            dirty;		/*term或voted_for有未写入的修改*/
+	bool            saving;		/*已交给日志线程写入*/
+	bool            pending;	/*正在写入的记录包含term或voted_for的修改,完成前不发送消息*/
+	raft_index_t    synced_commit_idx;	/*已落盘的commit_idx*/
+};
+
+/* 打开并加载元数据, 文件中没有有效记录时返回-1, 各字段为初始值 */
+int eraft_meta_init(struct eraft_meta *meta, char *db_path, int selfidx);
+
+void eraft_meta_free(struct eraft_meta *meta);
+
+/* 写入当前的term, voted_for和commit_idx, 成功后清除dirty */
+int eraft_meta_save(struct eraft_meta *meta);
+
+/* 向元数据文件fd写入序号为seq的记录, 不访问meta, 可在日志线程调用 */
+int eraft_meta_write(int fd, uint64_t seq, raft_term_t term, raft_node_id_t voted_for, raft_index_t commit_idx);
@@ -1,3 +1,5 @@
+#include <time.h>
+
 #include "rbtree_cache.h"
 #include "eraft_multi.h"
 
@@ -56,6 +58,7 @@ struct eraft_conf *eraft_conf_make(char *cluster, int selfidx)
 	free(tmp);
 
 	assert(selfidx < conf->num_nodes);
+	assert(conf->num_nodes <= 64);	/*ReadIndex按node_id置位记录确认*/
 	return conf;
 }
 
@@ -72,11 +75,31 @@ void eraft_conf_free(struct eraft_conf *conf)
 	free(conf);
 }
 
-static void _load_each_entry(struct eraft_journal *journal, raft_entry_t *entry, void *usr)
+struct reload_ctx
 {
-	struct eraft_group *group = usr;
+	struct eraft_group      *group;
+	iid_t                   next;	/*期望的下一条日志*/
+	int                     count;
+};
+
+/*entry的数据指向日志存储的映射,由raft_reload_entry复制*/
+static void _load_each_entry(iid_t iid, raft_entry_t *entry, void *usr)
+{
+	struct reload_ctx *ctx = usr;
+
+	if (iid < ctx->next) {
+		return;
+	}
+
+	if (iid > ctx->next) {
+		/*缺少的日志既不在快照中也不在日志存储中,无法恢复状态机*/
+		printf("group %s reload expects entry %d but journal continues at %d\n", ctx->group->identity, (int)ctx->next, (int)iid);
+		abort();
+	}
 
-	raft_reload_entry(group->raft, entry);
+	raft_reload_entry(ctx->group->raft, entry);
+	ctx->next++;
+	ctx->count++;
 }
 
 extern raft_cbs_t g_default_raft_funcs;
@@ -94,10 +117,28 @@ struct eraft_group *eraft_group_make(char *identity, int selfidx,
 	group->log_apply_wfcb = wfcb;
 	group->log_apply_rfcb = rfcb;
 	INIT_LIST_HEAD(&group->merge_list);
-	group->merge_task_state = MERGE_TASK_STATE_WORK;
+	INIT_LIST_HEAD(&group->read_list);
+	group->retain_window = DEFAULT_RETAIN_WINDOW;
+	INIT_LIST_HEAD(&group->retain_done_list);
+	INIT_LIST_HEAD(&group->cfg_wait_list);
+	group->batch.max_entries = DEFAULT_BATCH_MAX_ENTRIES;
+	group->batch.max_bytes = DEFAULT_BATCH_MAX_BYTES;
+	group->batch.linger_usec = DEFAULT_BATCH_LINGER_USEC;
+	group->batch.adaptive = true;
+	INIT_LIST_HEAD(&group->commit_list);
+	INIT_LIST_HEAD(&group->apply_wait_list);
+	INIT_LIST_HEAD(&group->meta_wait_list);
+	INIT_LIST_HEAD(&group->read_index.round_list);
+	INIT_LIST_HEAD(&group->read_index.next_list);
+	INIT_LIST_HEAD(&group->read_index.remote_round);
+	INIT_LIST_HEAD(&group->read_index.remote_next);
+	INIT_LIST_HEAD(&group->read_index.apply_wait_list);
+	group->read_lease.drift_msec = DEFAULT_LEASE_DRIFT_MSEC;
+	group->compact.step = DEFAULT_JOURNAL_TRIM_STEP;
+	group->compact.retain = DEFAULT_JOURNAL_TRIM_RETAIN;
 
 	/*加载原有信息*/
-	eraft_journal_init(&group->journal, selfidx, db_path, db_size, ERAFT_JOURNAL_TYPE_BDB);
+	eraft_journal_init(&group->journal, selfidx, db_path, db_size, DEFAULT_JOURNAL_TYPE);
 	eraft_journal_open(&group->journal);
 
 	/*创建raft服务*/
@@ -114,33 +155,198 @@ struct eraft_group *eraft_group_make(char *identity, int selfidx,
 	group->raft = raft;
 
 	/* Reload cluster information */
-	int commit_idx = 0;
-	eraft_journal_get_state(&group->journal, "commit_idx", strlen("commit_idx") + 1, (char *)&commit_idx, sizeof(commit_idx));
-	raft_set_commit_idx(group->raft, commit_idx);
-	raft_set_reload_begin_idx(group->raft, commit_idx);
-	// __load_foreach_append_log_from_idx(group->lmdb, commit_idx, _load_each_entry, group);
+	struct eraft_meta *meta = &group->meta;
+
+	if (eraft_meta_init(meta, db_path, selfidx) != 0) {
+		/*之前的版本保存在日志存储的状态中*/
+		int     voted_for = -1;
+		int     term = -1;
+		int     commit_idx = 0;
+
+		if ((eraft_journal_get_state(&group->journal, "term", strlen("term") + 1, (char *)&term, sizeof(term)) == 0) ||
+			(eraft_journal_get_state(&group->journal, "voted_for", strlen("voted_for") + 1, (char *)&voted_for, sizeof(voted_for)) == 0)) {
+			eraft_journal_get_state(&group->journal, "commit_idx", strlen("commit_idx") + 1, (char *)&commit_idx, sizeof(commit_idx));
+			meta->dirty = true;
+		}
 
-	int voted_for = -1;
-	eraft_journal_get_state(&group->journal, "voted_for", strlen("voted_for") + 1, (char *)&voted_for, sizeof(voted_for));
-	raft_set_voted_for(group->raft, voted_for);
+		meta->term = term;
+		meta->voted_for = voted_for;
+		meta->commit_idx = commit_idx;
+	}
 
-	int term = -1;
-	eraft_journal_get_state(&group->journal, "term", strlen("term") + 1, (char *)&term, sizeof(term));
-	raft_set_current_term(group->raft, term);
+	/*raft_set_current_term可能回调persist_term,以加载的值为准*/
+	struct eraft_meta loaded = *meta;
+	raft_set_current_term(group->raft, loaded.term);
+	raft_set_voted_for(group->raft, loaded.voted_for);
+	*meta = loaded;
+
+	if (meta->dirty) {
+		eraft_meta_save(meta);
+	}
+
+	group->compact.trim_idx = eraft_journal_get_trim_instance(&group->journal);
+
+	/*快照和日志由eraft_group_reload加载*/
+	group->snapshot.step = DEFAULT_SNAPSHOT_STEP;
+	group->snapshot.send = calloc(conf->num_nodes, sizeof(*group->snapshot.send));
+	eraft_snapshot_init(&group->snapshot.file, db_path, selfidx);
+	eraft_snapshot_load(&group->snapshot.file);
 
 	return group;
 }
 
+/*用快照恢复状态机,raft只保留自身节点,按启动配置重新加入*/
+static void __reload_snapshot(struct eraft_group *group)
+{
+	struct eraft_snapshot   *file = &group->snapshot.file;
+	char                    *path = eraft_snapshot_path(file, file->last_idx, file->last_term);
+	int                     e = group->snapshot.load_fcb(group, path, file->last_idx, file->last_term);
+
+	free(path);
+
+	if (e != 0) {
+		printf("snapshot %d load failed: %d\n", file->last_idx, e);
+		abort();
+	}
+
+	e = raft_begin_load_snapshot(group->raft, file->last_term, file->last_idx);
+	assert(e == 0);
+
+	for (int i = 0; i < group->conf->num_nodes; i++) {
+		if (!raft_get_node(group->raft, i)) {
+			raft_add_node(group->raft, NULL, i, (i == group->node_id) ? 1 : 0);
+		}
+	}
+
+	raft_end_load_snapshot(group->raft);
+
+	/*加载快照会改写任期,恢复为落盘的值*/
+	struct eraft_meta loaded = group->meta;
+	raft_set_current_term(group->raft, loaded.term);
+	raft_set_voted_for(group->raft, loaded.voted_for);
+	group->meta = loaded;
+}
+
+/*从next开始加载日志,next之前的日志已删除时不能继续*/
+static void __reload_entries(struct reload_ctx *ctx)
+{
+	iid_t trim_idx = eraft_journal_get_trim_instance(&ctx->group->journal);
+
+	if (trim_idx >= ctx->next) {
+		printf("group %s reload expects entry %d but journal is trimmed to %d\n", ctx->group->identity, (int)ctx->next, (int)trim_idx);
+		abort();
+	}
+
+	eraft_journal_foreach(&ctx->group->journal, ctx->next, _load_each_entry, ctx);
+}
+
+void eraft_group_reload(struct eraft_group *group)
+{
+	struct timespec begin, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	raft_index_t commit_idx = group->meta.commit_idx;
+
+	struct reload_ctx ctx = { .group = group };
+
+	if (group->snapshot.file.last_idx && group->snapshot.load_fcb) {
+		/*快照之后已应用的日志需要重新应用*/
+		raft_index_t last_idx = group->snapshot.file.last_idx;
+
+		__reload_snapshot(group);
+		ctx.next = last_idx + 1;
+		__reload_entries(&ctx);
+
+		raft_index_t commit = MIN(commit_idx, raft_get_current_idx(group->raft));
+
+		if (commit > last_idx) {
+			raft_set_commit_idx(group->raft, commit);
+		}
+
+		group->apply_idx = last_idx;
+		group->compact.poll_idx = last_idx;
+	} else if (group->snapshot.load_fcb) {
+		/*状态机只能由快照恢复,还没有快照时从第一条日志开始全部重新应用*/
+		ctx.next = 1;
+		__reload_entries(&ctx);
+
+		raft_index_t commit = MIN(commit_idx, raft_get_current_idx(group->raft));
+
+		if (commit > 0) {
+			raft_set_commit_idx(group->raft, commit);
+		}
+
+		group->apply_idx = 0;
+	} else {
+		/*已提交的日志已经应用,只加载之后未提交的部分*/
+		raft_set_commit_idx(group->raft, commit_idx);
+		raft_set_reload_begin_idx(group->raft, commit_idx);
+		group->apply_idx = commit_idx;
+
+		ctx.next = commit_idx + 1;
+		__reload_entries(&ctx);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("group %s reload %d entries from %d in %ld ms\n", group->identity, ctx.count, (int)(ctx.next - ctx.count),
+		(end.tv_sec - begin.tv_sec) * 1000 + (end.tv_nsec - begin.tv_nsec) / 1000000);
+}
+
 struct eraft_node *eraft_group_get_self_node(struct eraft_group *group)
 {
 	return &group->conf->nodes[group->conf->selfidx];
 }
 
+void eraft_group_set_retain_window(struct eraft_group *group, int window)
+{
+	/*留一个位置给配置变更日志*/
+	group->retain_window = MAX(1, MIN(window, MAX_RETAIN_WINDOW - 1));
+}
+
+void eraft_group_set_batch_policy(struct eraft_group *group, int max_entries, size_t max_bytes, int linger_usec, bool adaptive)
+{
+	group->batch.max_entries = MAX(1, max_entries);
+	group->batch.max_bytes = MAX(1, max_bytes);
+	group->batch.linger_usec = MAX(0, linger_usec);
+	group->batch.adaptive = adaptive;
+}
+
+void eraft_group_set_trim_policy(struct eraft_group *group, int step, int retain)
+{
+	group->compact.step = MAX(0, step);
+	group->compact.retain = MAX(0, retain);
+}
+
+void eraft_group_set_snapshot(struct eraft_group *group, ERAFT_SNAPSHOT_SAVE_FCB save_fcb, ERAFT_SNAPSHOT_LOAD_FCB load_fcb)
+{
+	group->snapshot.save_fcb = save_fcb;
+	group->snapshot.load_fcb = load_fcb;
+}
+
+void eraft_group_set_snapshot_policy(struct eraft_group *group, int step)
+{
+	group->snapshot.step = MAX(1, step);
+}
+
+void eraft_group_set_read_lease(struct eraft_group *group, bool enable, int drift_msec)
+{
+	group->read_lease.enable = enable;
+	group->read_lease.drift_msec = MAX(0, drift_msec);
+	group->read_lease.expire = 0;
+}
+
+/*日志存储已在日志线程关闭*/
 void eraft_group_free(struct eraft_group *group)
 {
-	eraft_journal_close(&group->journal);
 	eraft_journal_free(&group->journal);
 
+	eraft_meta_free(&group->meta);
+
+	eraft_snapshot_free(&group->snapshot.file);
+	free(group->snapshot.send);
+
 	eraft_conf_free(group->conf);
 
 	free(group->identity);
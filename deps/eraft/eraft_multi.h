@@ -1,13 +1,17 @@
 #pragma once
 
+#include <stdint.h>
 #include <sys/uio.h>
 
 #include "raft.h"
 #include "eraft_confs.h"
+#include "eraft_arena.h"
 #include "eraft_lock.h"
 #include "eraft_tasker.h"
 #include "eraft_journal.h"
 #include "eraft_journal_ext.h"
+#include "eraft_snapshot.h"
+#include "eraft_meta.h"
 
 struct eraft_node
 {
@@ -33,7 +37,32 @@ void eraft_conf_free(struct eraft_conf *conf);
 struct eraft_group;
 
 typedef int (*ERAFT_LOG_APPLY_WFCB)(struct eraft_group *group, struct iovec *new_requests, int new_count);
-typedef int (*ERAFT_LOG_APPLY_RFCB)(struct eraft_group *group, struct iovec *old_requests, int old_count, struct iovec *new_requests, int new_count);
+/*读请求的结果, 读回调从arena分配内存并填写response*/
+struct eraft_read_result
+{
+	struct eraft_arena      *arena;		/*调用者未提供时为NULL*/
+	struct iovec            response;
+};
+
+/*读回调, old_requests为已提交未应用的日志, ReadIndex读时已全部应用, old_count为0*/
+typedef int (*ERAFT_LOG_APPLY_RFCB)(struct eraft_group *group, struct iovec *old_requests, int old_count,
+	struct iovec *new_requests, struct eraft_read_result *new_results, int new_count);
+/*异步写完成回调, result为eraft errno, idx为提交的日志索引*/
+typedef void (*ERAFT_WRITE_DONE_FCB)(struct iovec *request, int result, int idx, void *usr);
+/*在应用线程中将状态机写入path, 包含last_idx及之前的日志, 成功返回0*/
+typedef int (*ERAFT_SNAPSHOT_SAVE_FCB)(struct eraft_group *group, char *path, raft_index_t last_idx, raft_term_t last_term);
+/*用path中的快照替换状态机, 成功返回0*/
+typedef int (*ERAFT_SNAPSHOT_LOAD_FCB)(struct eraft_group *group, char *path, raft_index_t last_idx, raft_term_t last_term);
+
+/*leader向一个follower发送快照的进度*/
+struct eraft_snapshot_send
+{
+	raft_index_t    last_idx;	/*为0时没有进行中的发送*/
+	raft_term_t     last_term;
+	uint64_t        offset;
+	double          ts;		/*最近发送的时间,超过选举超时未回复则重新发送*/
+	bool            reading;	/*已交给应用线程读取下一段*/
+};
 
 struct eraft_group
 {
@@ -45,16 +74,89 @@ struct eraft_group
 
 	struct eraft_conf               *conf;
 
-	struct list_head                merge_list;
-	enum
+	struct list_head                merge_list;	/*待合并落盘的写请求*/
+	struct list_head                read_list;	/*读请求,与写请求分开排队*/
+	/*正在落盘的批次,按start_idx顺序记录,满retain_window后暂停合并新的写请求*/
+	int                             retain_window;
+	struct
 	{
-		MERGE_TASK_STATE_WORK,
-		MERGE_TASK_STATE_STOP,
-	}                               merge_task_state;
+		raft_index_t    start_idx[MAX_RETAIN_WINDOW];
+		int             head;
+		int             count;
+	}                               retain_ring;
+	struct list_head                retain_done_list;	/*等待按序完成的落盘任务*/
+	bool                            retain_failed;	/*有批次落盘失败,环中其后的批次一并失败*/
+	struct list_head                cfg_wait_list;	/*等待落盘窗口的配置变更日志*/
+	struct
+	{
+		raft_batch_t    *batch;
+		raft_index_t    start_idx;
+		void            *usr;
+	}                               retain_pending;	/*已交给日志线程,待加入raft日志的批次*/
+	/*写请求凑批策略:达到条数或字节上限立即落盘,否则最多等待linger_usec*/
+	struct
+	{
+		int             max_entries;
+		size_t          max_bytes;
+		int             linger_usec;
+		bool            adaptive;	/*日志线程空闲时不等待*/
+		struct ev_timer linger_watcher;
+	}                               batch;
 	// struct eraft_tasker_each        self_tasker;
 	struct eraft_tasker_each        peer_tasker;
 
+	struct list_head                commit_list;	/*已落盘,等待提交的写请求,按idx有序,提交时一次扫描唤醒*/
+	struct list_head                apply_wait_list;	/*等待leader本地落盘后再应用的批次*/
+	raft_index_t                    apply_idx;		/*已交给应用线程的最后一条日志*/
+	/*日志压缩:已应用的日志保留retain条,超出step条后删除一次*/
+	struct
+	{
+		raft_index_t    step;			/*为0时不删除*/
+		raft_index_t    retain;
+		raft_index_t    trim_idx;		/*已交给日志线程删除到的位置*/
+		raft_index_t    poll_idx;		/*raft已从内存中移除到的位置*/
+	}                               compact;
+	/*状态机快照:应用满step条后生成,之前的日志随之删除,落后过多的follower改为发送快照*/
+	struct
+	{
+		ERAFT_SNAPSHOT_SAVE_FCB         save_fcb;	/*为NULL时不生成快照*/
+		ERAFT_SNAPSHOT_LOAD_FCB         load_fcb;
+		raft_index_t                    step;
+		bool                            saving;		/*已交给应用线程生成快照*/
+		bool                            loading;	/*已交给应用线程加载收到的快照*/
+		struct eraft_snapshot           file;
+		struct eraft_snapshot_send      *send;		/*leader向每个follower发送快照的进度,按node_id索引*/
+	}                               snapshot;
+	/*ReadIndex读:记录commit_idx,一轮心跳确认leader身份,应用到该位置后执行读*/
+	struct
+	{
+		raft_term_t             term;			/*当前任期*/
+		raft_index_t            term_first_idx;		/*当前任期写入的第一条日志*/
+		uint64_t                seq;			/*心跳轮次*/
+		uint64_t                acks;			/*本轮确认的投票节点,按node_id置位,含自己*/
+		double                  start_ts;
+		double                  start_mono;		/*本轮发出心跳的单调时钟*/
+		raft_index_t            read_idx;
+		bool                    forward;		/*本轮是follower向leader查询commit_idx*/
+		struct list_head        round_list;		/*本轮等待确认的读请求*/
+		struct list_head        next_list;		/*本轮进行中到达的读请求,下一轮一起确认*/
+		struct list_head        remote_round;		/*本轮等待确认的follower查询*/
+		struct list_head        remote_next;		/*下一轮确认的follower查询*/
+		struct list_head        apply_wait_list;	/*已确认,等待应用到read_idx的批次*/
+	}                               read_index;
+	/*租约读:多数节点确认心跳后,选举超时内不会选出新leader,租约内直接本地读*/
+	struct
+	{
+		bool                    enable;
+		int                     drift_msec;		/*时钟漂移余量,租约为选举超时减去此值*/
+		raft_term_t             term;
+		double                  expire;			/*leader租约到期时间,单调时钟*/
+		double                  granted;		/*follower最近确认心跳的时间,单调时钟*/
+	}                               read_lease;
+
 	struct eraft_journal            journal;
+	struct eraft_meta               meta;		/*term,voted_for和commit_idx*/
+	struct list_head                meta_wait_list;	/*等待term和voted_for落盘后发送的消息*/
 
 	ERAFT_LOG_APPLY_WFCB            log_apply_wfcb;
 	ERAFT_LOG_APPLY_RFCB            log_apply_rfcb;
@@ -66,8 +168,37 @@ struct eraft_group      *eraft_group_make(char *identity, int selfidx,
 	char *db_path, int db_size,
 	ERAFT_LOG_APPLY_WFCB wfcb, ERAFT_LOG_APPLY_RFCB rfcb);
 
+/*
+ * 用最新的快照和日志恢复raft状态, 需在设置快照回调之后, 加入raft线程之前调用.
+ * 设置了load_fcb但还没有快照时, 从第一条日志开始重新应用;
+ * 没有快照回调时只加载commit_idx之后的日志.
+ */
+void eraft_group_reload(struct eraft_group *group);
+
 struct eraft_node       *eraft_group_get_self_node(struct eraft_group *group);
 
+/*设置同时落盘的批次数, 取值[1, MAX_RETAIN_WINDOW - 1]*/
+void eraft_group_set_retain_window(struct eraft_group *group, int window);
+
+/*设置写请求凑批策略, linger_usec为0时不等待*/
+void eraft_group_set_batch_policy(struct eraft_group *group, int max_entries, size_t max_bytes, int linger_usec, bool adaptive);
+
+/*设置日志压缩策略, step为0时不删除旧日志*/
+void eraft_group_set_trim_policy(struct eraft_group *group, int step, int retain);
+
+/*设置状态机快照回调, 需在group加入raft线程前设置, save_fcb为NULL时不生成快照*/
+void eraft_group_set_snapshot(struct eraft_group *group, ERAFT_SNAPSHOT_SAVE_FCB save_fcb, ERAFT_SNAPSHOT_LOAD_FCB load_fcb);
+
+/*设置快照间隔, 距上次快照应用满step条后生成新快照*/
+void eraft_group_set_snapshot_policy(struct eraft_group *group, int step);
+
+/*
+ * 设置租约读, 租约不确定时退回ReadIndex读.
+ * 租约依赖follower确认leader心跳后一个选举超时内不投票, 所有节点始终如此, 与enable无关;
+ * 各节点的选举超时须相同, drift_msec须覆盖节点间的时钟速率差异.
+ */
+void eraft_group_set_read_lease(struct eraft_group *group, bool enable, int drift_msec);
+
 void eraft_group_free(struct eraft_group *group);
 
 struct eraft_multi
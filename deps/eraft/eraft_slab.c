@@ -0,0 +1,292 @@
+#include <stddef.h>
+
+#include "eraft_slab.h"
+
+#define ERAFT_SLAB_CLASSES      5	/*64, 128, 256, 512, 1024*/
+#define ERAFT_SLAB_MIN_SHIFT    6
+#define ERAFT_SLAB_BATCH        64	/*与全局池交换的块数*/
+#define ERAFT_SLAB_LOCAL_MAX    256	/*本地缓存上限*/
+
+struct eraft_slab_cache;
+
+struct eraft_slab_node
+{
+	struct eraft_slab_cache *owner;	/*NULL表示calloc分配*/
+	int                     cls;
+	int                     size;
+	union
+	{
+		struct eraft_slab_node  *next;
+		char                    data[0];
+	};
+} __attribute__((aligned(16)));
+
+#define ERAFT_SLAB_HEAD_SIZE offsetof(struct eraft_slab_node, data)
+
+struct eraft_slab_cache
+{
+	struct eraft_slab_node  *local[ERAFT_SLAB_CLASSES];
+	int                     nlocal[ERAFT_SLAB_CLASSES];
+	struct eraft_slab_node  *remote[ERAFT_SLAB_CLASSES];	/*其它线程归还,多写单读*/
+	bool                    dead;
+	struct eraft_slab_cache *next_dead;
+	struct eraft_slab_cache *next_all;
+	struct eraft_slab_stat  stat;	/*只由本线程修改,读取时汇总*/
+};
+
+/*全局池,线程退出和本地缓存溢出时放回*/
+static struct
+{
+	pthread_mutex_t         lock;
+	struct eraft_slab_node  *list[ERAFT_SLAB_CLASSES];
+	struct eraft_slab_cache *dead_caches;
+	struct eraft_slab_cache *all_caches;
+	pthread_key_t           key;
+	pthread_once_t          once;
+}                               g_slab_pool = {
+	.lock   = PTHREAD_MUTEX_INITIALIZER,
+	.once   = PTHREAD_ONCE_INIT,
+};
+
+static __thread struct eraft_slab_cache *g_slab_cache = NULL;
+
+static inline int __slab_class(size_t size)
+{
+	for (int cls = 0; cls < ERAFT_SLAB_CLASSES; cls++) {
+		if (size <= ((size_t)1 << (cls + ERAFT_SLAB_MIN_SHIFT))) {
+			return cls;
+		}
+	}
+
+	return -1;
+}
+
+static inline size_t __slab_class_size(int cls)
+{
+	return ERAFT_SLAB_HEAD_SIZE + ((size_t)1 << (cls + ERAFT_SLAB_MIN_SHIFT));
+}
+
+static struct eraft_slab_node *__slab_take_all(struct eraft_slab_node **head)
+{
+	return __sync_lock_test_and_set(head, NULL);
+}
+
+/*线程退出,本地块放回全局池,缓存结构保留以接收迟到的归还*/
+static void __slab_cache_exit(void *usr)
+{
+	struct eraft_slab_cache *cache = usr;
+
+	pthread_mutex_lock(&g_slab_pool.lock);
+
+	for (int cls = 0; cls < ERAFT_SLAB_CLASSES; cls++) {
+		while (cache->local[cls]) {
+			struct eraft_slab_node *node = cache->local[cls];
+			cache->local[cls] = node->next;
+			node->next = g_slab_pool.list[cls];
+			g_slab_pool.list[cls] = node;
+		}
+
+		cache->nlocal[cls] = 0;
+	}
+
+	cache->dead = true;
+	cache->next_dead = g_slab_pool.dead_caches;
+	g_slab_pool.dead_caches = cache;
+
+	pthread_mutex_unlock(&g_slab_pool.lock);
+}
+
+static void __slab_key_init(void)
+{
+	pthread_key_create(&g_slab_pool.key, __slab_cache_exit);
+}
+
+static struct eraft_slab_cache *__slab_cache(void)
+{
+	if (unlikely(!g_slab_cache)) {
+		pthread_once(&g_slab_pool.once, __slab_key_init);
+
+		g_slab_cache = calloc(1, sizeof(struct eraft_slab_cache));
+		assert(g_slab_cache);
+		pthread_setspecific(g_slab_pool.key, g_slab_cache);
+
+		pthread_mutex_lock(&g_slab_pool.lock);
+		g_slab_cache->next_all = g_slab_pool.all_caches;
+		g_slab_pool.all_caches = g_slab_cache;
+		pthread_mutex_unlock(&g_slab_pool.lock);
+	}
+
+	return g_slab_cache;
+}
+
+/*本地缓存为空时,依次从归还队列,全局池和系统补充*/
+static void __slab_refill(struct eraft_slab_cache *cache, int cls)
+{
+	struct eraft_slab_node *node = __slab_take_all(&cache->remote[cls]);
+
+	while (node) {
+		struct eraft_slab_node *next = node->next;
+		node->next = cache->local[cls];
+		cache->local[cls] = node;
+		cache->nlocal[cls]++;
+		node = next;
+	}
+
+	if (cache->local[cls]) {
+		return;
+	}
+
+	pthread_mutex_lock(&g_slab_pool.lock);
+
+	/*回收已退出线程的归还队列*/
+	for (struct eraft_slab_cache *dead = g_slab_pool.dead_caches; dead; dead = dead->next_dead) {
+		node = __slab_take_all(&dead->remote[cls]);
+
+		while (node) {
+			struct eraft_slab_node *next = node->next;
+			node->next = g_slab_pool.list[cls];
+			g_slab_pool.list[cls] = node;
+			node = next;
+		}
+	}
+
+	for (int i = 0; i < ERAFT_SLAB_BATCH && g_slab_pool.list[cls]; i++) {
+		node = g_slab_pool.list[cls];
+		g_slab_pool.list[cls] = node->next;
+		node->next = cache->local[cls];
+		cache->local[cls] = node;
+		cache->nlocal[cls]++;
+	}
+
+	pthread_mutex_unlock(&g_slab_pool.lock);
+
+	if (cache->local[cls]) {
+		return;
+	}
+
+	size_t  size = __slab_class_size(cls);
+	char    *chunk = aligned_alloc(16, size * ERAFT_SLAB_BATCH);
+	assert(chunk);
+	cache->stat.sys_allocs++;
+
+	for (int i = 0; i < ERAFT_SLAB_BATCH; i++) {
+		node = (struct eraft_slab_node *)(chunk + i * size);
+		node->cls = cls;
+		node->next = cache->local[cls];
+		cache->local[cls] = node;
+		cache->nlocal[cls]++;
+	}
+}
+
+/*本地缓存过多时放一批回全局池*/
+static void __slab_drain(struct eraft_slab_cache *cache, int cls)
+{
+	pthread_mutex_lock(&g_slab_pool.lock);
+
+	for (int i = 0; i < ERAFT_SLAB_BATCH && cache->local[cls]; i++) {
+		struct eraft_slab_node *node = cache->local[cls];
+		cache->local[cls] = node->next;
+		cache->nlocal[cls]--;
+		node->next = g_slab_pool.list[cls];
+		g_slab_pool.list[cls] = node;
+	}
+
+	pthread_mutex_unlock(&g_slab_pool.lock);
+}
+
+void *eraft_slab_alloc(size_t size)
+{
+	struct eraft_slab_cache *cache = __slab_cache();
+
+	cache->stat.allocs++;
+
+	int cls = __slab_class(size);
+
+	if (unlikely(cls < 0)) {
+		struct eraft_slab_node *node = calloc(1, ERAFT_SLAB_HEAD_SIZE + size);
+		assert(node);
+		cache->stat.sys_allocs++;
+		node->owner = NULL;
+		node->cls = -1;
+		node->size = size;
+		return node->data;
+	}
+
+	if (unlikely(!cache->local[cls])) {
+		__slab_refill(cache, cls);
+	}
+
+	struct eraft_slab_node *node = cache->local[cls];
+	cache->local[cls] = node->next;
+	cache->nlocal[cls]--;
+
+	node->owner = cache;
+	node->size = size;
+	memset(node->data, 0, size);
+	return node->data;
+}
+
+void eraft_slab_free(void *ptr)
+{
+	if (unlikely(!ptr)) {
+		return;
+	}
+
+	struct eraft_slab_cache *cache = __slab_cache();
+
+	cache->stat.frees++;
+
+	struct eraft_slab_node  *node = (struct eraft_slab_node *)((char *)ptr - ERAFT_SLAB_HEAD_SIZE);
+	struct eraft_slab_cache *owner = node->owner;
+	int                     cls = node->cls;
+
+	if (unlikely(!owner)) {
+		free(node);
+		return;
+	}
+
+	if (owner == cache) {
+		node->next = cache->local[cls];
+		cache->local[cls] = node;
+		cache->nlocal[cls]++;
+
+		if (unlikely(cache->nlocal[cls] > ERAFT_SLAB_LOCAL_MAX)) {
+			__slab_drain(cache, cls);
+		}
+	} else {
+		/*归还给所属线程*/
+		cache->stat.remote_frees++;
+		struct eraft_slab_node *head = NULL;
+
+		do {
+			head = ATOMIC_GET(&owner->remote[cls]);
+			node->next = head;
+		} while (!ATOMIC_CASB(&owner->remote[cls], head, node));
+	}
+}
+
+char *eraft_slab_strdup(const char *str)
+{
+	size_t  len = strlen(str) + 1;
+	char    *dst = eraft_slab_alloc(len);
+
+	memcpy(dst, str, len);
+	return dst;
+}
+
+/*汇总各线程的计数,包括已退出的线程*/
+void eraft_slab_get_stat(struct eraft_slab_stat *stat)
+{
+	memset(stat, 0, sizeof(*stat));
+
+	pthread_mutex_lock(&g_slab_pool.lock);
+
+	for (struct eraft_slab_cache *cache = g_slab_pool.all_caches; cache; cache = cache->next_all) {
+		stat->allocs += ATOMIC_GET(&cache->stat.allocs);
+		stat->frees += ATOMIC_GET(&cache->stat.frees);
+		stat->remote_frees += ATOMIC_GET(&cache->stat.remote_frees);
+		stat->sys_allocs += ATOMIC_GET(&cache->stat.sys_allocs);
+	}
+
+	pthread_mutex_unlock(&g_slab_pool.lock);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "eraft_utils.h"
+
+/*
+ * 小对象分配器, 用于eraft_taskis任务对象.
+ * 每个线程按大小分级缓存空闲块, 其它线程释放的块放回所属线程的归还队列,
+ * 所属线程在本地缓存为空时一次性取回. 超过ERAFT_SLAB_MAX_SIZE的请求直接使用calloc.
+ */
+#define ERAFT_SLAB_MAX_SIZE     1024
+
+struct eraft_slab_stat
+{
+	uint64_t        allocs;		/*分配次数*/
+	uint64_t        frees;		/*释放次数*/
+	uint64_t        remote_frees;	/*跨线程归还次数*/
+	uint64_t        sys_allocs;	/*向系统申请内存的次数*/
+};
+
+/* 分配size字节并清零 */
+void    *eraft_slab_alloc(size_t size);
+
+/* 释放eraft_slab_alloc分配的内存, 可在任意线程调用 */
+void eraft_slab_free(void *ptr);
+
+/* 复制字符串 */
+char    *eraft_slab_strdup(const char *str);
+
+/* 获取分配计数 */
+void eraft_slab_get_stat(struct eraft_slab_stat *stat);
@@ -0,0 +1,277 @@
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "eraft_utils.h"
+#include "eraft_snapshot.h"
+
+#define SNAPSHOT_SAVE_TEMP      "save.tmp"
+#define SNAPSHOT_RECV_TEMP      "recv.tmp"
+
+static char *__snapshot_file(struct eraft_snapshot *snap, char *name)
+{
+	size_t  path_length = strlen(snap->dir_path) + strlen(name) + 2;
+	char    *path = malloc(path_length);
+
+	snprintf(path, path_length, "%s/%s", snap->dir_path, name);
+	return path;
+}
+
+static int __snapshot_sync_dir(struct eraft_snapshot *snap)
+{
+	int fd = open(snap->dir_path, O_RDONLY);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	int e = fsync(fd);
+	close(fd);
+	return e;
+}
+
+void eraft_snapshot_init(struct eraft_snapshot *snap, char *db_path, int selfidx)
+{
+	size_t path_length = strlen(db_path) + 32;
+
+	memset(snap, 0, sizeof(*snap));
+	snap->dir_path = malloc(path_length);
+	snprintf(snap->dir_path, path_length, "%s_%d.snap", db_path, selfidx);
+	snap->recv.fd = -1;
+
+	mkdir(snap->dir_path, 0755);
+}
+
+void eraft_snapshot_free(struct eraft_snapshot *snap)
+{
+	if (snap->recv.fd >= 0) {
+		close(snap->recv.fd);
+		snap->recv.fd = -1;
+	}
+
+	free(snap->dir_path);
+	snap->dir_path = NULL;
+}
+
+void eraft_snapshot_load(struct eraft_snapshot *snap)
+{
+	DIR *dir = opendir(snap->dir_path);
+
+	if (!dir) {
+		return;
+	}
+
+	struct dirent *ent;
+
+	while ((ent = readdir(dir)) != NULL) {
+		unsigned        idx, term;
+		char            tail[8];
+
+		if (ent->d_name[0] == '.') {
+			continue;
+		}
+
+		if ((sscanf(ent->d_name, "%10u_%10u.%7s", &idx, &term, tail) == 3) && (strcmp(tail, "snap") == 0)) {
+			if (idx <= (unsigned)snap->last_idx) {
+				char *path = __snapshot_file(snap, ent->d_name);
+				unlink(path);
+				free(path);
+				continue;
+			}
+
+			if (snap->last_idx) {
+				char *path = eraft_snapshot_path(snap, snap->last_idx, snap->last_term);
+				unlink(path);
+				free(path);
+			}
+
+			snap->last_idx = idx;
+			snap->last_term = term;
+			continue;
+		}
+
+		/*上次未完成的临时文件*/
+		char *path = __snapshot_file(snap, ent->d_name);
+		unlink(path);
+		free(path);
+	}
+
+	closedir(dir);
+}
+
+char *eraft_snapshot_path(struct eraft_snapshot *snap, raft_index_t last_idx, raft_term_t last_term)
+{
+	size_t  path_length = strlen(snap->dir_path) + 32;
+	char    *path = malloc(path_length);
+
+	snprintf(path, path_length, "%s/%010u_%010u.snap", snap->dir_path, (unsigned)last_idx, (unsigned)last_term);
+	return path;
+}
+
+char *eraft_snapshot_temp_path(struct eraft_snapshot *snap)
+{
+	return __snapshot_file(snap, SNAPSHOT_SAVE_TEMP);
+}
+
+int eraft_snapshot_commit(struct eraft_snapshot *snap, char *temp_path, raft_index_t last_idx, raft_term_t last_term)
+{
+	int fd = open(temp_path, O_RDONLY);
+
+	if (fd < 0) {
+		printf("snapshot %s open failed: %s\n", temp_path, strerror(errno));
+		return -1;
+	}
+
+	if (fsync(fd) != 0) {
+		printf("snapshot %s fsync failed: %s\n", temp_path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	close(fd);
+
+	char    *path = eraft_snapshot_path(snap, last_idx, last_term);
+	int     e = rename(temp_path, path);
+
+	if (e != 0) {
+		printf("snapshot %s rename failed: %s\n", path, strerror(errno));
+	}
+
+	free(path);
+	return (e == 0) ? __snapshot_sync_dir(snap) : -1;
+}
+
+void eraft_snapshot_advance(struct eraft_snapshot *snap, raft_index_t last_idx, raft_term_t last_term)
+{
+	if (last_idx <= snap->last_idx) {
+		return;
+	}
+
+	if (snap->last_idx) {
+		char *path = eraft_snapshot_path(snap, snap->last_idx, snap->last_term);
+		unlink(path);
+		free(path);
+	}
+
+	snap->last_idx = last_idx;
+	snap->last_term = last_term;
+}
+
+ssize_t eraft_snapshot_read(struct eraft_snapshot *snap, raft_index_t last_idx, raft_term_t last_term,
+	uint64_t offset, void *buf, size_t len, uint64_t *total)
+{
+	if ((last_idx != snap->last_idx) || (last_term != snap->last_term)) {
+		return -1;
+	}
+
+	char    *path = eraft_snapshot_path(snap, last_idx, last_term);
+	int     fd = open(path, O_RDONLY);
+
+	free(path);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	struct stat st;
+
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	*total = st.st_size;
+
+	ssize_t done = 0;
+
+	while ((size_t)done < len) {
+		ssize_t rbyte = pread(fd, (char *)buf + done, len - done, offset + done);
+
+		if (rbyte < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			close(fd);
+			return -1;
+		}
+
+		if (rbyte == 0) {
+			break;
+		}
+
+		done += rbyte;
+	}
+
+	close(fd);
+	return done;
+}
+
+static int __recv_write(int fd, void *data, size_t len, uint64_t offset)
+{
+	while (len) {
+		ssize_t wbyte = pwrite(fd, data, len, offset);
+
+		if (wbyte < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return -1;
+		}
+
+		data = (char *)data + wbyte;
+		len -= wbyte;
+		offset += wbyte;
+	}
+
+	return 0;
+}
+
+int eraft_snapshot_recv(struct eraft_snapshot *snap, raft_index_t last_idx, raft_term_t last_term,
+	uint64_t offset, void *data, size_t len, bool done)
+{
+	char *temp_path = __snapshot_file(snap, SNAPSHOT_RECV_TEMP);
+
+	if (offset == 0) {
+		if (snap->recv.fd >= 0) {
+			close(snap->recv.fd);
+		}
+
+		snap->recv.fd = open(temp_path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+		snap->recv.last_idx = last_idx;
+		snap->recv.last_term = last_term;
+		snap->recv.offset = 0;
+
+		if (snap->recv.fd < 0) {
+			printf("snapshot %s open failed: %s\n", temp_path, strerror(errno));
+			free(temp_path);
+			return -1;
+		}
+	} else if ((snap->recv.fd < 0) || (snap->recv.last_idx != last_idx) ||
+		(snap->recv.last_term != last_term) || (snap->recv.offset != offset)) {
+		free(temp_path);
+		return -1;
+	}
+
+	if (__recv_write(snap->recv.fd, data, len, offset) != 0) {
+		printf("snapshot %s write failed: %s\n", temp_path, strerror(errno));
+		close(snap->recv.fd);
+		snap->recv.fd = -1;
+		free(temp_path);
+		return -1;
+	}
+
+	snap->recv.offset += len;
+
+	if (!done) {
+		free(temp_path);
+		return 0;
+	}
+
+	close(snap->recv.fd);
+	snap->recv.fd = -1;
+
+	int e = eraft_snapshot_commit(snap, temp_path, last_idx, last_term);
+	free(temp_path);
+	return e;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "raft.h"
+
+/*
+ * 状态机快照文件, 每个group一个目录.
+ * 文件名记录快照包含的最后一条日志, 写完落盘后改名才算完成, 重启时取最新的一个.
+ * 本地生成和从leader接收使用不同的临时文件.
+ */
+struct eraft_snapshot
+{
+	char            *dir_path;
+	raft_index_t    last_idx;	/*最新快照包含的最后一条日志,没有快照时为0*/
+	raft_term_t     last_term;
+
+	/*正在从leader接收的快照*/
+	struct
+	{
+		int             fd;
+		raft_index_t    last_idx;
+		raft_term_t     last_term;
+		uint64_t        offset;
+	}               recv;
+};
+
+void eraft_snapshot_init(struct eraft_snapshot *snap, char *db_path, int selfidx);
+
+void eraft_snapshot_free(struct eraft_snapshot *snap);
+
+/* 查找目录中最新的快照, 删除其它快照和未完成的临时文件 */
+void eraft_snapshot_load(struct eraft_snapshot *snap);
+
+/* 快照文件路径, 调用者释放 */
+char *eraft_snapshot_path(struct eraft_snapshot *snap, raft_index_t last_idx, raft_term_t last_term);
+
+/* 本地生成快照的临时文件路径, 调用者释放 */
+char *eraft_snapshot_temp_path(struct eraft_snapshot *snap);
+
+/* 临时文件落盘后改名为正式快照, 不修改snap, 可在应用线程调用 */
+int eraft_snapshot_commit(struct eraft_snapshot *snap, char *temp_path, raft_index_t last_idx, raft_term_t last_term);
+
+/* 切换到新的快照并删除旧快照 */
+void eraft_snapshot_advance(struct eraft_snapshot *snap, raft_index_t last_idx, raft_term_t last_term);
+
+/* 读取快照offset开始的数据, total返回文件大小, 快照已被替换时返回-1 */
+ssize_t eraft_snapshot_read(struct eraft_snapshot *snap, raft_index_t last_idx, raft_term_t last_term,
+	uint64_t offset, void *buf, size_t len, uint64_t *total);
+
+/*
+ * 写入leader发来的一段数据, offset为0时重新开始.
+ * 与已接收的快照不符或不连续时返回-1, done为真时落盘并改名为正式快照.
+ */
+int eraft_snapshot_recv(struct eraft_snapshot *snap, raft_index_t last_idx, raft_term_t last_term,
+	uint64_t offset, void *data, size_t len, bool done);
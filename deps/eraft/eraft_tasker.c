@@ -166,6 +166,23 @@ void eraft_tasker_each_stop(struct eraft_tasker_each *tasker)
 #endif
 }
 
+void eraft_tasker_each_flush(struct eraft_tasker_each *tasker)
+{
+#ifndef USE_LIBEVCORO
+	LIST_HEAD(do_list);
+	eraft_lock_lock(&tasker->lock);
+	list_splice_init(&tasker->list, &do_list);
+	eraft_lock_unlock(&tasker->lock);
+
+	while (!list_empty(&do_list)) {
+		struct eraft_dotask *first = list_first_entry(&do_list, struct eraft_dotask, node);
+		list_del(&first->node);
+
+		first->_fcb(first, first->_usr);
+	}
+#endif
+}
+
 void eraft_tasker_each_free(struct eraft_tasker_each *tasker)
 {
 #ifdef USE_LIBEVCORO
@@ -53,6 +53,9 @@ void eraft_tasker_each_call(struct eraft_tasker_each *tasker);
 
 void eraft_tasker_each_stop(struct eraft_tasker_each *tasker);
 
+/*立即执行队列中剩余的任务*/
+void eraft_tasker_each_flush(struct eraft_tasker_each *tasker);
+
 void eraft_tasker_each_free(struct eraft_tasker_each *tasker);
 
 void eraft_tasker_each_give(struct eraft_tasker_each *tasker, struct eraft_dotask *task);
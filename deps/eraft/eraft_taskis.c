@@ -1,9 +1,36 @@
 #include "eraft_taskis.h"
 
+struct eraft_taskis_group_load *eraft_taskis_group_load_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	int selfidx, char *db_path, int db_size,
+	ERAFT_LOG_APPLY_WFCB wfcb, ERAFT_LOG_APPLY_RFCB rfcb,
+	ERAFT_SNAPSHOT_SAVE_FCB save_fcb, ERAFT_SNAPSHOT_LOAD_FCB load_fcb, struct etask *etask)
+{
+	struct eraft_taskis_group_load *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_GROUP_LOAD, identity, _fcb, _usr);
+
+	object->selfidx = selfidx;
+	object->db_path = db_path;
+	object->db_size = db_size;
+	object->wfcb = wfcb;
+	object->rfcb = rfcb;
+	object->save_fcb = save_fcb;
+	object->load_fcb = load_fcb;
+	object->group = NULL;
+	object->etask = etask;
+	return object;
+}
+
+void eraft_taskis_group_load_free(struct eraft_taskis_group_load *object)
+{
+	eraft_dotask_free(&object->base);
+	eraft_slab_free(object);
+}
+
 struct eraft_taskis_group_add *eraft_taskis_group_add_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
 	struct eraft_group *group, struct etask *etask)
 {
-	struct eraft_taskis_group_add *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_group_add *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_GROUP_ADD, identity, _fcb, _usr);
 
@@ -16,12 +43,12 @@ struct eraft_taskis_group_add *eraft_taskis_group_add_make(char *identity, ERAFT
 void eraft_taskis_group_add_free(struct eraft_taskis_group_add *object)
 {
 	eraft_dotask_free(&object->base);
-	free(object);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_group_del *eraft_taskis_group_del_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr, struct etask *etask)
 {
-	struct eraft_taskis_group_del *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_group_del *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_GROUP_DEL, identity, _fcb, _usr);
 
@@ -32,20 +59,74 @@ struct eraft_taskis_group_del *eraft_taskis_group_del_make(char *identity, ERAFT
 void eraft_taskis_group_del_free(struct eraft_taskis_group_del *object)
 {
 	eraft_dotask_free(&object->base);
-	free(object);
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_group_drain *eraft_taskis_group_drain_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, struct eraft_group *group, struct etask *etask)
+{
+	struct eraft_taskis_group_drain *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_GROUP_DRAIN, identity, _fcb, _usr);
+
+	object->evts = evts;
+	object->group = group;
+	object->etask = etask;
+	return object;
+}
+
+void eraft_taskis_group_drain_free(struct eraft_taskis_group_drain *object)
+{
+	eraft_dotask_free(&object->base);
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_group_free *eraft_taskis_group_free_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_group *group, struct etask *etask)
+{
+	struct eraft_taskis_group_free *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_GROUP_FREE, identity, _fcb, _usr);
+
+	object->group = group;
+	object->etask = etask;
+	return object;
+}
+
+void eraft_taskis_group_free_free(struct eraft_taskis_group_free *object)
+{
+	eraft_dotask_free(&object->base);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_request_write *eraft_taskis_request_write_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
-	struct iovec *request, struct etask *etask)
+	struct iovec *request, struct eraft_iobuf **iobuf, int count, struct etask *etask, ERAFT_WRITE_DONE_FCB fcb, void *usr)
 {
-	struct eraft_taskis_request_write *object = calloc(1, sizeof(*object));
+	assert(count > 0);
+	assert(!request != !iobuf);
+
+	struct eraft_taskis_request_write *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_REQUEST_WRITE, identity, _fcb, _usr);
 
 	object->request = request;
+	object->count = count;
+
+	if (iobuf) {
+		/*接管引用,数组本身复制一份*/
+		object->iobuf = calloc(count, sizeof(struct eraft_iobuf *));
+		memcpy(object->iobuf, iobuf, count * sizeof(struct eraft_iobuf *));
+	}
+
+	for (int i = 0; i < count; i++) {
+		object->bytes += iobuf ? iobuf[i]->len : request[i].iov_len;
+	}
+
 	object->etask = etask;
-	object->efd = -1;
 	object->idx = -1;
+	object->state = ERAFT_REQUEST_PENDING;
+	object->fcb = fcb;
+	object->usr = usr;
 	return object;
 }
 
@@ -53,18 +134,30 @@ void eraft_taskis_request_write_free(struct eraft_taskis_request_write *object)
 {
 	eraft_dotask_free(&object->base);
 
-	free(object);
+	if (object->iobuf) {
+		for (int i = 0; i < object->count; i++) {
+			eraft_iobuf_put(object->iobuf[i]);
+		}
+
+		free(object->iobuf);
+	}
+
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_request_read *eraft_taskis_request_read_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
-	struct iovec *request, struct etask *etask)
+	struct iovec *request, struct eraft_arena *arena, struct etask *etask)
 {
-	struct eraft_taskis_request_read *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_request_read *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_REQUEST_READ, identity, _fcb, _usr);
 
 	object->request = request;
+	object->arena = arena;
+	object->response.iov_base = NULL;
+	object->response.iov_len = 0;
 	object->etask = etask;
+	object->state = ERAFT_REQUEST_PENDING;
 	return object;
 }
 
@@ -72,13 +165,13 @@ void eraft_taskis_request_read_free(struct eraft_taskis_request_read *object)
 {
 	eraft_dotask_free(&object->base);
 
-	free(object);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_log_retain *eraft_taskis_log_retain_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
 	struct eraft_evts *evts, struct eraft_journal *journal, raft_batch_t *batch, raft_index_t start_idx, void *usr)
 {
-	struct eraft_taskis_log_retain *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_log_retain *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_LOG_RETAIN, identity, _fcb, _usr);
 
@@ -94,17 +187,18 @@ void eraft_taskis_log_retain_free(struct eraft_taskis_log_retain *object)
 {
 	eraft_dotask_free(&object->base);
 
-	free(object);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_log_retain_done *eraft_taskis_log_retain_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
-	raft_batch_t *batch, raft_index_t start_idx, void *usr)
+	int result, raft_batch_t *batch, raft_index_t start_idx, void *usr)
 {
-	struct eraft_taskis_log_retain_done *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_log_retain_done *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_LOG_RETAIN_DONE, identity, _fcb, _usr);
 
 	/*设置属性*/
+	object->result = result;
 	object->batch = batch;
 	object->start_idx = start_idx;
 	object->usr = usr;
@@ -115,13 +209,13 @@ void eraft_taskis_log_retain_done_free(struct eraft_taskis_log_retain_done *obje
 {
 	eraft_dotask_free(&object->base);
 
-	free(object);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_log_remind *eraft_taskis_log_remind_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
 	struct eraft_evts *evts, raft_batch_t *batch, raft_index_t start_idx, void *usr)
 {
-	struct eraft_taskis_log_remind *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_log_remind *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_LOG_REMIND, identity, _fcb, _usr);
 
@@ -136,14 +230,14 @@ void eraft_taskis_log_remind_free(struct eraft_taskis_log_remind *object)
 {
 	eraft_dotask_free(&object->base);
 
-	free(object);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_log_append *eraft_taskis_log_append_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
 	struct eraft_evts *evts, struct eraft_journal *journal, raft_batch_t *batch, raft_index_t start_idx,
 	raft_node_t *node, raft_index_t leader_commit, raft_index_t rsp_first_idx)
 {
-	struct eraft_taskis_log_append *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_log_append *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_LOG_APPEND, identity, _fcb, _usr);
 
@@ -162,19 +256,20 @@ void eraft_taskis_log_append_free(struct eraft_taskis_log_append *object)
 {
 	eraft_dotask_free(&object->base);
 
-	free(object);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_log_append_done *eraft_taskis_log_append_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
-	struct eraft_evts *evts, raft_batch_t *batch, raft_index_t start_idx,
+	struct eraft_evts *evts, int result, raft_batch_t *batch, raft_index_t start_idx,
 	raft_node_t *node, raft_index_t leader_commit, raft_index_t rsp_first_idx)
 {
-	struct eraft_taskis_log_append_done *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_log_append_done *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_LOG_APPEND_DONE, identity, _fcb, _usr);
 
 	/*设置属性*/
 	object->evts = evts;
+	object->result = result;
 	object->batch = batch;
 	object->start_idx = start_idx;
 	object->raft_node = node;
@@ -187,13 +282,13 @@ void eraft_taskis_log_append_done_free(struct eraft_taskis_log_append_done *obje
 {
 	eraft_dotask_free(&object->base);
 
-	free(object);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_log_apply *eraft_taskis_log_apply_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
 	struct eraft_evts *evts, raft_batch_t *batch, raft_index_t start_idx)
 {
-	struct eraft_taskis_log_apply *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_log_apply *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_LOG_APPLY, identity, _fcb, _usr);
 
@@ -208,13 +303,13 @@ void eraft_taskis_log_apply_free(struct eraft_taskis_log_apply *object)
 {
 	eraft_dotask_free(&object->base);
 
-	free(object);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_log_apply_done *eraft_taskis_log_apply_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
 	raft_batch_t *batch, raft_index_t start_idx)
 {
-	struct eraft_taskis_log_apply_done *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_log_apply_done *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_LOG_APPLY_DONE, identity, _fcb, _usr);
 
@@ -228,18 +323,296 @@ void eraft_taskis_log_apply_done_free(struct eraft_taskis_log_apply_done *object
 {
 	eraft_dotask_free(&object->base);
 
-	free(object);
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_log_read *eraft_taskis_log_read_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, raft_index_t read_idx, void *usr)
+{
+	struct eraft_taskis_log_read *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_LOG_READ, identity, _fcb, _usr);
+
+	object->evts = evts;
+	object->read_idx = read_idx;
+	object->usr = usr;
+	return object;
+}
+
+void eraft_taskis_log_read_free(struct eraft_taskis_log_read *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_log_trim *eraft_taskis_log_trim_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, struct eraft_journal *journal, raft_index_t trim_idx)
+{
+	struct eraft_taskis_log_trim *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_LOG_TRIM, identity, _fcb, _usr);
+
+	object->evts = evts;
+	object->journal = journal;
+	object->trim_idx = trim_idx;
+	return object;
+}
+
+void eraft_taskis_log_trim_free(struct eraft_taskis_log_trim *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_log_pop *eraft_taskis_log_pop_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, struct eraft_journal *journal, raft_index_t pop_idx)
+{
+	struct eraft_taskis_log_pop *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_LOG_POP, identity, _fcb, _usr);
+
+	object->evts = evts;
+	object->journal = journal;
+	object->pop_idx = pop_idx;
+	return object;
+}
+
+void eraft_taskis_log_pop_free(struct eraft_taskis_log_pop *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_meta_save *eraft_taskis_meta_save_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, int fd, uint64_t seq,
+	raft_term_t term, raft_node_id_t voted_for, raft_index_t commit_idx)
+{
+	struct eraft_taskis_meta_save *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_META_SAVE, identity, _fcb, _usr);
+
+	object->evts = evts;
+	object->fd = fd;
+	object->seq = seq;
+	object->term = term;
+	object->voted_for = voted_for;
+	object->commit_idx = commit_idx;
+	return object;
+}
+
+void eraft_taskis_meta_save_free(struct eraft_taskis_meta_save *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_meta_save_done *eraft_taskis_meta_save_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	uint64_t seq, raft_index_t commit_idx, int result)
+{
+	struct eraft_taskis_meta_save_done *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_META_SAVE_DONE, identity, _fcb, _usr);
+
+	object->seq = seq;
+	object->commit_idx = commit_idx;
+	object->result = result;
+	return object;
+}
+
+void eraft_taskis_meta_save_done_free(struct eraft_taskis_meta_save_done *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_snap_save *eraft_taskis_snap_save_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, raft_index_t last_idx, raft_term_t last_term)
+{
+	struct eraft_taskis_snap_save *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_SNAP_SAVE, identity, _fcb, _usr);
+
+	object->evts = evts;
+	object->last_idx = last_idx;
+	object->last_term = last_term;
+	return object;
+}
+
+void eraft_taskis_snap_save_free(struct eraft_taskis_snap_save *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_snap_save_done *eraft_taskis_snap_save_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	raft_index_t last_idx, raft_term_t last_term, int result)
+{
+	struct eraft_taskis_snap_save_done *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_SNAP_SAVE_DONE, identity, _fcb, _usr);
+
+	object->last_idx = last_idx;
+	object->last_term = last_term;
+	object->result = result;
+	return object;
+}
+
+void eraft_taskis_snap_save_done_free(struct eraft_taskis_snap_save_done *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_snap_load *eraft_taskis_snap_load_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, raft_index_t last_idx, raft_term_t last_term, raft_node_t *node)
+{
+	struct eraft_taskis_snap_load *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_SNAP_LOAD, identity, _fcb, _usr);
+
+	object->evts = evts;
+	object->last_idx = last_idx;
+	object->last_term = last_term;
+	object->node = node;
+	return object;
+}
+
+void eraft_taskis_snap_load_free(struct eraft_taskis_snap_load *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_snap_load_done *eraft_taskis_snap_load_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	raft_index_t last_idx, raft_term_t last_term, raft_node_t *node, int result)
+{
+	struct eraft_taskis_snap_load_done *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_SNAP_LOAD_DONE, identity, _fcb, _usr);
+
+	object->last_idx = last_idx;
+	object->last_term = last_term;
+	object->node = node;
+	object->result = result;
+	return object;
+}
+
+void eraft_taskis_snap_load_done_free(struct eraft_taskis_snap_load_done *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_snap_recv *eraft_taskis_snap_recv_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, msg_snapshot_t *sn, void *data, raft_node_t *node)
+{
+	struct eraft_taskis_snap_recv *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_SNAP_RECV, identity, _fcb, _usr);
+
+	object->evts = evts;
+	object->sn = *sn;
+	object->data = data;
+	object->node = node;
+	return object;
+}
+
+void eraft_taskis_snap_recv_free(struct eraft_taskis_snap_recv *object)
+{
+	eraft_dotask_free(&object->base);
+
+	free(object->data);
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_snap_recv_done *eraft_taskis_snap_recv_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	raft_index_t last_idx, raft_term_t last_term, uint64_t offset, bool done, raft_node_t *node, int result)
+{
+	struct eraft_taskis_snap_recv_done *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_SNAP_RECV_DONE, identity, _fcb, _usr);
+
+	object->last_idx = last_idx;
+	object->last_term = last_term;
+	object->offset = offset;
+	object->done = done;
+	object->node = node;
+	object->result = result;
+	return object;
+}
+
+void eraft_taskis_snap_recv_done_free(struct eraft_taskis_snap_recv_done *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_snap_read *eraft_taskis_snap_read_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, int node_id, raft_index_t last_idx, raft_term_t last_term, uint64_t offset)
+{
+	struct eraft_taskis_snap_read *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_SNAP_READ, identity, _fcb, _usr);
+
+	object->evts = evts;
+	object->node_id = node_id;
+	object->last_idx = last_idx;
+	object->last_term = last_term;
+	object->offset = offset;
+	return object;
+}
+
+void eraft_taskis_snap_read_free(struct eraft_taskis_snap_read *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_snap_read_done *eraft_taskis_snap_read_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	int node_id, raft_index_t last_idx, raft_term_t last_term, uint64_t offset, char *chunk, ssize_t len, uint64_t total)
+{
+	struct eraft_taskis_snap_read_done *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_SNAP_READ_DONE, identity, _fcb, _usr);
+
+	object->node_id = node_id;
+	object->last_idx = last_idx;
+	object->last_term = last_term;
+	object->offset = offset;
+	object->chunk = chunk;
+	object->len = len;
+	object->total = total;
+	return object;
+}
+
+void eraft_taskis_snap_read_done_free(struct eraft_taskis_snap_read_done *object)
+{
+	eraft_dotask_free(&object->base);
+
+	free(object->chunk);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_net_append *eraft_taskis_net_append_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
 	msg_appendentries_t *ae, raft_node_t *node)
 {
-	struct eraft_taskis_net_append *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_net_append *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_NET_APPEND, identity, _fcb, _usr);
 
 	object->node = node;
-	object->ae = malloc(sizeof(msg_appendentries_t));
+	object->ae = eraft_slab_alloc(sizeof(msg_appendentries_t));
 	memcpy(object->ae, ae, sizeof(msg_appendentries_t));
 	return object;
 }
@@ -248,19 +621,19 @@ void eraft_taskis_net_append_free(struct eraft_taskis_net_append *object)
 {
 	eraft_dotask_free(&object->base);
 
-	free(object->ae);
-	free(object);
+	eraft_slab_free(object->ae);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_net_append_response *eraft_taskis_net_append_response_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
 	msg_appendentries_response_t *aer, raft_node_t *node)
 {
-	struct eraft_taskis_net_append_response *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_net_append_response *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_NET_APPEND_RESPONSE, identity, _fcb, _usr);
 
 	object->node = node;
-	object->aer = malloc(sizeof(msg_appendentries_response_t));
+	object->aer = eraft_slab_alloc(sizeof(msg_appendentries_response_t));
 	memcpy(object->aer, aer, sizeof(msg_appendentries_response_t));
 	return object;
 }
@@ -269,19 +642,19 @@ void eraft_taskis_net_append_response_free(struct eraft_taskis_net_append_respon
 {
 	eraft_dotask_free(&object->base);
 
-	free(object->aer);
-	free(object);
+	eraft_slab_free(object->aer);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_net_vote *eraft_taskis_net_vote_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
 	msg_requestvote_t *rv, raft_node_t *node)
 {
-	struct eraft_taskis_net_vote *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_net_vote *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_NET_VOTE, identity, _fcb, _usr);
 
 	object->node = node;
-	object->rv = malloc(sizeof(msg_requestvote_t));
+	object->rv = eraft_slab_alloc(sizeof(msg_requestvote_t));
 	memcpy(object->rv, rv, sizeof(msg_requestvote_t));
 	return object;
 }
@@ -290,19 +663,19 @@ void eraft_taskis_net_vote_free(struct eraft_taskis_net_vote *object)
 {
 	eraft_dotask_free(&object->base);
 
-	free(object->rv);
-	free(object);
+	eraft_slab_free(object->rv);
+	eraft_slab_free(object);
 }
 
 struct eraft_taskis_net_vote_response *eraft_taskis_net_vote_response_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
 	msg_requestvote_response_t *rvr, raft_node_t *node)
 {
-	struct eraft_taskis_net_vote_response *object = calloc(1, sizeof(*object));
+	struct eraft_taskis_net_vote_response *object = eraft_slab_alloc(sizeof(*object));
 
 	eraft_dotask_init(&object->base, ERAFT_TASK_NET_VOTE_RESPONSE, identity, _fcb, _usr);
 
 	object->node = node;
-	object->rvr = malloc(sizeof(msg_requestvote_response_t));
+	object->rvr = eraft_slab_alloc(sizeof(msg_requestvote_response_t));
 	memcpy(object->rvr, rvr, sizeof(msg_requestvote_response_t));
 	return object;
 }
@@ -311,7 +684,136 @@ void eraft_taskis_net_vote_response_free(struct eraft_taskis_net_vote_response *
 {
 	eraft_dotask_free(&object->base);
 
-	free(object->rvr);
-	free(object);
+	eraft_slab_free(object->rvr);
+	eraft_slab_free(object);
 }
 
+struct eraft_taskis_net_readindex *eraft_taskis_net_readindex_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	msg_readindex_t *ri, raft_node_t *node)
+{
+	struct eraft_taskis_net_readindex *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_NET_READINDEX, identity, _fcb, _usr);
+
+	object->node = node;
+	object->ri = eraft_slab_alloc(sizeof(msg_readindex_t));
+	memcpy(object->ri, ri, sizeof(msg_readindex_t));
+	return object;
+}
+
+void eraft_taskis_net_readindex_free(struct eraft_taskis_net_readindex *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object->ri);
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_net_readindex_response *eraft_taskis_net_readindex_response_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	msg_readindex_response_t *rir, raft_node_t *node)
+{
+	struct eraft_taskis_net_readindex_response *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_NET_READINDEX_RESPONSE, identity, _fcb, _usr);
+
+	object->node = node;
+	object->rir = eraft_slab_alloc(sizeof(msg_readindex_response_t));
+	memcpy(object->rir, rir, sizeof(msg_readindex_response_t));
+	return object;
+}
+
+void eraft_taskis_net_readindex_response_free(struct eraft_taskis_net_readindex_response *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object->rir);
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_net_commitidx *eraft_taskis_net_commitidx_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	msg_commitidx_t *ci, raft_node_t *node)
+{
+	struct eraft_taskis_net_commitidx *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_NET_COMMITIDX, identity, _fcb, _usr);
+
+	object->node = node;
+	object->ci = eraft_slab_alloc(sizeof(msg_commitidx_t));
+	memcpy(object->ci, ci, sizeof(msg_commitidx_t));
+	return object;
+}
+
+void eraft_taskis_net_commitidx_free(struct eraft_taskis_net_commitidx *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object->ci);
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_net_commitidx_response *eraft_taskis_net_commitidx_response_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	msg_commitidx_response_t *cir, raft_node_t *node)
+{
+	struct eraft_taskis_net_commitidx_response *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_NET_COMMITIDX_RESPONSE, identity, _fcb, _usr);
+
+	object->node = node;
+	object->cir = eraft_slab_alloc(sizeof(msg_commitidx_response_t));
+	memcpy(object->cir, cir, sizeof(msg_commitidx_response_t));
+	return object;
+}
+
+void eraft_taskis_net_commitidx_response_free(struct eraft_taskis_net_commitidx_response *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object->cir);
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_net_snapshot *eraft_taskis_net_snapshot_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	msg_snapshot_t *sn, void *data, raft_node_t *node)
+{
+	struct eraft_taskis_net_snapshot *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_NET_SNAPSHOT, identity, _fcb, _usr);
+
+	object->node = node;
+	object->sn = eraft_slab_alloc(sizeof(msg_snapshot_t));
+	memcpy(object->sn, sn, sizeof(msg_snapshot_t));
+	/*分段较大,不走slab*/
+	object->data = malloc(sn->len ? sn->len : 1);
+	memcpy(object->data, data, sn->len);
+	return object;
+}
+
+void eraft_taskis_net_snapshot_free(struct eraft_taskis_net_snapshot *object)
+{
+	eraft_dotask_free(&object->base);
+
+	free(object->data);
+	eraft_slab_free(object->sn);
+	eraft_slab_free(object);
+}
+
+struct eraft_taskis_net_snapshot_response *eraft_taskis_net_snapshot_response_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	msg_snapshot_response_t *snr, raft_node_t *node)
+{
+	struct eraft_taskis_net_snapshot_response *object = eraft_slab_alloc(sizeof(*object));
+
+	eraft_dotask_init(&object->base, ERAFT_TASK_NET_SNAPSHOT_RESPONSE, identity, _fcb, _usr);
+
+	object->node = node;
+	object->snr = eraft_slab_alloc(sizeof(msg_snapshot_response_t));
+	memcpy(object->snr, snr, sizeof(msg_snapshot_response_t));
+	return object;
+}
+
+void eraft_taskis_net_snapshot_response_free(struct eraft_taskis_net_snapshot_response *object)
+{
+	eraft_dotask_free(&object->base);
+
+	eraft_slab_free(object->snr);
+	eraft_slab_free(object);
+}
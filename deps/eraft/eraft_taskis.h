@@ -4,12 +4,17 @@
 #include "list.h"
 #include "etask.h"
 #include "eraft_multi.h"
+#include "eraft_iobuf.h"
+#include "eraft_slab.h"
 #include "eraft_dotask.h"
 
 enum eraft_task_type
 {
+	ERAFT_TASK_GROUP_LOAD,
 	ERAFT_TASK_GROUP_ADD,
 	ERAFT_TASK_GROUP_DEL,
+	ERAFT_TASK_GROUP_DRAIN,
+	ERAFT_TASK_GROUP_FREE,
 	ERAFT_TASK_GROUP_EMPTY,
 
 	ERAFT_TASK_REQUEST_WRITE,
@@ -22,13 +27,108 @@ enum eraft_task_type
 	ERAFT_TASK_LOG_APPEND_DONE,
 	ERAFT_TASK_LOG_APPLY,
 	ERAFT_TASK_LOG_APPLY_DONE,
+	ERAFT_TASK_LOG_READ,
+	ERAFT_TASK_LOG_TRIM,
+	ERAFT_TASK_LOG_POP,
+
+	ERAFT_TASK_SNAP_SAVE,
+	ERAFT_TASK_SNAP_SAVE_DONE,
+	ERAFT_TASK_SNAP_LOAD,
+	ERAFT_TASK_SNAP_LOAD_DONE,
+	ERAFT_TASK_SNAP_RECV,
+	ERAFT_TASK_SNAP_RECV_DONE,
+	ERAFT_TASK_SNAP_READ,
+	ERAFT_TASK_SNAP_READ_DONE,
+
+	ERAFT_TASK_META_SAVE,
+	ERAFT_TASK_META_SAVE_DONE,
 
 	ERAFT_TASK_NET_APPEND,
 	ERAFT_TASK_NET_APPEND_RESPONSE,
 	ERAFT_TASK_NET_VOTE,
 	ERAFT_TASK_NET_VOTE_RESPONSE,
+	ERAFT_TASK_NET_READINDEX,
+	ERAFT_TASK_NET_READINDEX_RESPONSE,
+	ERAFT_TASK_NET_COMMITIDX,
+	ERAFT_TASK_NET_COMMITIDX_RESPONSE,
+	ERAFT_TASK_NET_SNAPSHOT,
+	ERAFT_TASK_NET_SNAPSHOT_RESPONSE,
 };
 
+/*ReadIndex心跳,确认发送者仍是leader*/
+typedef struct
+{
+	raft_term_t     term;
+	uint64_t        seq;
+} msg_readindex_t;
+
+typedef struct
+{
+	raft_term_t     term;
+	uint64_t        seq;
+	int             success;
+} msg_readindex_response_t;
+
+/*follower读,向leader查询已确认的commit_idx*/
+typedef struct
+{
+	raft_term_t     term;
+	uint64_t        seq;
+} msg_commitidx_t;
+
+typedef struct
+{
+	raft_term_t     term;
+	uint64_t        seq;
+	raft_index_t    read_idx;
+	int             success;
+} msg_commitidx_response_t;
+
+/*InstallSnapshot,快照分段发送,数据跟在消息之后*/
+typedef struct
+{
+	raft_term_t     term;
+	raft_index_t    last_idx;
+	raft_term_t     last_term;
+	uint64_t        offset;
+	uint32_t        len;
+	int             done;	/*最后一段*/
+} msg_snapshot_t;
+
+/*follower收到中间一段后回复,最后一段加载完成后以appendentries response回复*/
+typedef struct
+{
+	raft_term_t     term;
+	raft_index_t    last_idx;
+	uint64_t        offset;	/*已接收的字节数,下一段从此处发送*/
+	int             success;
+} msg_snapshot_response_t;
+
+/*=========================================================*/
+/*在日志线程中打开日志并恢复raft状态,多个group并行加载*/
+struct eraft_taskis_group_load
+{
+	struct eraft_dotask             base;
+
+	int                             selfidx;
+	char                            *db_path;
+	int                             db_size;
+	ERAFT_LOG_APPLY_WFCB            wfcb;
+	ERAFT_LOG_APPLY_RFCB            rfcb;
+	ERAFT_SNAPSHOT_SAVE_FCB         save_fcb;
+	ERAFT_SNAPSHOT_LOAD_FCB         load_fcb;
+
+	struct eraft_group              *group;	/*加载结果*/
+	struct etask                    *etask;
+};
+
+struct eraft_taskis_group_load  *eraft_taskis_group_load_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	int selfidx, char *db_path, int db_size,
+	ERAFT_LOG_APPLY_WFCB wfcb, ERAFT_LOG_APPLY_RFCB rfcb,
+	ERAFT_SNAPSHOT_SAVE_FCB save_fcb, ERAFT_SNAPSHOT_LOAD_FCB load_fcb, struct etask *etask);
+
+void eraft_taskis_group_load_free(struct eraft_taskis_group_load *object);
+
 /*=========================================================*/
 struct eraft_taskis_group_add
 {
@@ -56,19 +156,67 @@ struct eraft_taskis_group_del   *eraft_taskis_group_del_make(char *identity, ERA
 void eraft_taskis_group_del_free(struct eraft_taskis_group_del *object);
 
 /*=========================================================*/
+/*删除的group依次经过日志线程和应用线程,之前交出的任务都已处理*/
+struct eraft_taskis_group_drain
+{
+	struct eraft_dotask     base;
+
+	struct eraft_evts       *evts;
+	struct eraft_group      *group;
+	struct etask            *etask;
+};
+
+struct eraft_taskis_group_drain *eraft_taskis_group_drain_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, struct eraft_group *group, struct etask *etask);
+
+void eraft_taskis_group_drain_free(struct eraft_taskis_group_drain *object);
+
+/*=========================================================*/
+struct eraft_taskis_group_free
+{
+	struct eraft_dotask     base;
+
+	struct eraft_group      *group;
+	struct etask            *etask;
+};
+
+struct eraft_taskis_group_free  *eraft_taskis_group_free_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_group *group, struct etask *etask);
+
+void eraft_taskis_group_free_free(struct eraft_taskis_group_free *object);
+
+/*=========================================================*/
+/*同步请求的状态,调用者超时返回后由raft线程回收*/
+enum
+{
+	ERAFT_REQUEST_PENDING = 0,	/*在merge_list中排队*/
+	ERAFT_REQUEST_MERGING,		/*raft线程正在使用请求数据;读请求为等待确认或应用,仍可取消*/
+	ERAFT_REQUEST_SUBMITTED,	/*已加入raft日志,等待提交;读请求为读回调已开始执行*/
+	ERAFT_REQUEST_DONE,		/*已完成,调用者会被唤醒*/
+	ERAFT_REQUEST_DETACHED,		/*调用者已超时返回*/
+};
+
 struct eraft_taskis_request_write
 {
 	struct eraft_dotask     base;
 
 	struct iovec            *request;
-	struct etask            *etask;	/*retain done call*/
-	int                     efd;	/*entry commit call*/
-	int                     idx;
-	int                     result;
+	struct eraft_iobuf      **iobuf;	/*与request二选一,持有每个缓冲区的一个引用*/
+	int                     count;	/*request数组长度,合并为连续的count条日志*/
+	size_t                  bytes;	/*request总字节数*/
+	double                  merge_ts;	/*进入merge_list的时间*/
+	struct etask            *etask;	/*commit or failure call*/
+	int                     idx;	/*最后一条日志的索引*/
+	raft_term_t             term;	/*日志的任期,提交时与该位置的日志比较*/
+	int                     result;	/*eraft错误码*/
+	int                     state;	/*ERAFT_REQUEST_xxx*/
+
+	ERAFT_WRITE_DONE_FCB    fcb;	/*async commit call, if set etask is unused*/
+	void                    *usr;
 };
 
 struct eraft_taskis_request_write       *eraft_taskis_request_write_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
-	struct iovec *request, struct etask *etask);
+	struct iovec *request, struct eraft_iobuf **iobuf, int count, struct etask *etask, ERAFT_WRITE_DONE_FCB fcb, void *usr);
 
 void eraft_taskis_request_write_free(struct eraft_taskis_request_write *object);
 
@@ -78,12 +226,15 @@ struct eraft_taskis_request_read
 	struct eraft_dotask     base;
 
 	struct iovec            *request;
+	struct eraft_arena      *arena;		/*读结果的内存,可以为NULL*/
+	struct iovec            response;	/*读回调填写的结果*/
 	struct etask            *etask;	/*remind done call*/
 	int                     result;
+	int                     state;	/*ERAFT_REQUEST_xxx*/
 };
 
 struct eraft_taskis_request_read        *eraft_taskis_request_read_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
-	struct iovec *request, struct etask *etask);
+	struct iovec *request, struct eraft_arena *arena, struct etask *etask);
 
 void eraft_taskis_request_read_free(struct eraft_taskis_request_read *object);
 
@@ -109,13 +260,14 @@ struct eraft_taskis_log_retain_done
 {
 	struct eraft_dotask     base;
 
+	int                     result;	/*落盘结果,非0为失败*/
 	raft_batch_t            *batch;
 	raft_index_t            start_idx;
 	void                    *usr;
 };
 
 struct eraft_taskis_log_retain_done     *eraft_taskis_log_retain_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
-	raft_batch_t *batch, raft_index_t start_idx, void *usr);
+	int result, raft_batch_t *batch, raft_index_t start_idx, void *usr);
 
 void eraft_taskis_log_retain_done_free(struct eraft_taskis_log_retain_done *object);
 
@@ -161,6 +313,7 @@ struct eraft_taskis_log_append_done
 	struct eraft_dotask     base;
 
 	struct eraft_evts       *evts;
+	int                     result;	/*落盘结果,非0为失败*/
 	raft_batch_t            *batch;
 	raft_index_t            start_idx;
 	raft_node_t             *raft_node;
@@ -169,7 +322,7 @@ struct eraft_taskis_log_append_done
 };
 
 struct eraft_taskis_log_append_done     *eraft_taskis_log_append_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
-	struct eraft_evts *evts, raft_batch_t *batch, raft_index_t start_idx,
+	struct eraft_evts *evts, int result, raft_batch_t *batch, raft_index_t start_idx,
 	raft_node_t *node, raft_index_t leader_commit, raft_index_t rsp_first_idx);
 
 void eraft_taskis_log_append_done_free(struct eraft_taskis_log_append_done *object);
@@ -203,6 +356,220 @@ struct eraft_taskis_log_apply_done      *eraft_taskis_log_apply_done_make(char *
 
 void eraft_taskis_log_apply_done_free(struct eraft_taskis_log_apply_done *object);
 
+/*=========================================================*/
+struct eraft_taskis_log_read
+{
+	struct eraft_dotask     base;
+
+	struct eraft_evts       *evts;
+	raft_index_t            read_idx;	/*应用到此位置后执行读*/
+	void                    *usr;		/*读请求批次*/
+};
+
+struct eraft_taskis_log_read    *eraft_taskis_log_read_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, raft_index_t read_idx, void *usr);
+
+void eraft_taskis_log_read_free(struct eraft_taskis_log_read *object);
+
+/*=========================================================*/
+struct eraft_taskis_log_trim
+{
+	struct eraft_dotask     base;
+
+	struct eraft_evts       *evts;
+	struct eraft_journal    *journal;
+	raft_index_t            trim_idx;	/*删除此位置及之前的日志*/
+};
+
+struct eraft_taskis_log_trim    *eraft_taskis_log_trim_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, struct eraft_journal *journal, raft_index_t trim_idx);
+
+void eraft_taskis_log_trim_free(struct eraft_taskis_log_trim *object);
+
+/*=========================================================*/
+struct eraft_taskis_log_pop
+{
+	struct eraft_dotask     base;
+
+	struct eraft_evts       *evts;
+	struct eraft_journal    *journal;
+	raft_index_t            pop_idx;	/*删除此位置及之后的日志*/
+};
+
+struct eraft_taskis_log_pop     *eraft_taskis_log_pop_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, struct eraft_journal *journal, raft_index_t pop_idx);
+
+void eraft_taskis_log_pop_free(struct eraft_taskis_log_pop *object);
+
+/*=========================================================*/
+/*term,voted_for和commit_idx在日志线程中落盘*/
+struct eraft_taskis_meta_save
+{
+	struct eraft_dotask     base;
+
+	struct eraft_evts       *evts;
+	int                     fd;	/*dup出的元数据文件,写入后关闭,group删除后仍可写*/
+	uint64_t                seq;
+	raft_term_t             term;
+	raft_node_id_t          voted_for;
+	raft_index_t            commit_idx;
+};
+
+struct eraft_taskis_meta_save   *eraft_taskis_meta_save_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, int fd, uint64_t seq,
+	raft_term_t term, raft_node_id_t voted_for, raft_index_t commit_idx);
+
+void eraft_taskis_meta_save_free(struct eraft_taskis_meta_save *object);
+
+/*=========================================================*/
+struct eraft_taskis_meta_save_done
+{
+	struct eraft_dotask     base;
+
+	uint64_t                seq;
+	raft_index_t            commit_idx;
+	int                     result;
+};
+
+struct eraft_taskis_meta_save_done      *eraft_taskis_meta_save_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	uint64_t seq, raft_index_t commit_idx, int result);
+
+void eraft_taskis_meta_save_done_free(struct eraft_taskis_meta_save_done *object);
+
+/*=========================================================*/
+struct eraft_taskis_snap_save
+{
+	struct eraft_dotask     base;
+
+	struct eraft_evts       *evts;
+	raft_index_t            last_idx;
+	raft_term_t             last_term;
+};
+
+struct eraft_taskis_snap_save   *eraft_taskis_snap_save_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, raft_index_t last_idx, raft_term_t last_term);
+
+void eraft_taskis_snap_save_free(struct eraft_taskis_snap_save *object);
+
+/*=========================================================*/
+struct eraft_taskis_snap_save_done
+{
+	struct eraft_dotask     base;
+
+	raft_index_t            last_idx;
+	raft_term_t             last_term;
+	int                     result;
+};
+
+struct eraft_taskis_snap_save_done      *eraft_taskis_snap_save_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	raft_index_t last_idx, raft_term_t last_term, int result);
+
+void eraft_taskis_snap_save_done_free(struct eraft_taskis_snap_save_done *object);
+
+/*=========================================================*/
+struct eraft_taskis_snap_load
+{
+	struct eraft_dotask     base;
+
+	struct eraft_evts       *evts;
+	raft_index_t            last_idx;
+	raft_term_t             last_term;
+	raft_node_t             *node;	/*发送快照的leader*/
+};
+
+struct eraft_taskis_snap_load   *eraft_taskis_snap_load_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, raft_index_t last_idx, raft_term_t last_term, raft_node_t *node);
+
+void eraft_taskis_snap_load_free(struct eraft_taskis_snap_load *object);
+
+/*=========================================================*/
+struct eraft_taskis_snap_load_done
+{
+	struct eraft_dotask     base;
+
+	raft_index_t            last_idx;
+	raft_term_t             last_term;
+	raft_node_t             *node;
+	int                     result;
+};
+
+struct eraft_taskis_snap_load_done      *eraft_taskis_snap_load_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	raft_index_t last_idx, raft_term_t last_term, raft_node_t *node, int result);
+
+void eraft_taskis_snap_load_done_free(struct eraft_taskis_snap_load_done *object);
+
+/*=========================================================*/
+/*在应用线程中写入leader发来的一段快照*/
+struct eraft_taskis_snap_recv
+{
+	struct eraft_dotask     base;
+
+	struct eraft_evts       *evts;
+	msg_snapshot_t          sn;
+	void                    *data;	/*sn.len字节的快照数据,由本任务释放*/
+	raft_node_t             *node;	/*发送快照的leader*/
+};
+
+struct eraft_taskis_snap_recv   *eraft_taskis_snap_recv_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, msg_snapshot_t *sn, void *data, raft_node_t *node);
+
+void eraft_taskis_snap_recv_free(struct eraft_taskis_snap_recv *object);
+
+/*=========================================================*/
+struct eraft_taskis_snap_recv_done
+{
+	struct eraft_dotask     base;
+
+	raft_index_t            last_idx;
+	raft_term_t             last_term;
+	uint64_t                offset;	/*已接收的字节数*/
+	bool                    done;	/*已收完并改名为正式快照*/
+	raft_node_t             *node;
+	int                     result;
+};
+
+struct eraft_taskis_snap_recv_done      *eraft_taskis_snap_recv_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	raft_index_t last_idx, raft_term_t last_term, uint64_t offset, bool done, raft_node_t *node, int result);
+
+void eraft_taskis_snap_recv_done_free(struct eraft_taskis_snap_recv_done *object);
+
+/*=========================================================*/
+/*在应用线程中读取一段快照,发给follower*/
+struct eraft_taskis_snap_read
+{
+	struct eraft_dotask     base;
+
+	struct eraft_evts       *evts;
+	int                     node_id;
+	raft_index_t            last_idx;
+	raft_term_t             last_term;
+	uint64_t                offset;
+};
+
+struct eraft_taskis_snap_read   *eraft_taskis_snap_read_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	struct eraft_evts *evts, int node_id, raft_index_t last_idx, raft_term_t last_term, uint64_t offset);
+
+void eraft_taskis_snap_read_free(struct eraft_taskis_snap_read *object);
+
+/*=========================================================*/
+struct eraft_taskis_snap_read_done
+{
+	struct eraft_dotask     base;
+
+	int                     node_id;
+	raft_index_t            last_idx;
+	raft_term_t             last_term;
+	uint64_t                offset;
+	char                    *chunk;	/*由本任务释放*/
+	ssize_t                 len;	/*快照已被替换时为-1*/
+	uint64_t                total;
+};
+
+struct eraft_taskis_snap_read_done      *eraft_taskis_snap_read_done_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	int node_id, raft_index_t last_idx, raft_term_t last_term, uint64_t offset, char *chunk, ssize_t len, uint64_t total);
+
+void eraft_taskis_snap_read_done_free(struct eraft_taskis_snap_read_done *object);
+
 /*=========================================================*/
 struct eraft_taskis_net_append_response
 {
@@ -259,3 +626,87 @@ struct eraft_taskis_net_vote_response   *eraft_taskis_net_vote_response_make(cha
 
 void eraft_taskis_net_vote_response_free(struct eraft_taskis_net_vote_response *object);
 
+/*=========================================================*/
+struct eraft_taskis_net_readindex
+{
+	struct eraft_dotask     base;
+
+	raft_node_t             *node;
+	msg_readindex_t         *ri;
+};
+
+struct eraft_taskis_net_readindex       *eraft_taskis_net_readindex_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	msg_readindex_t *ri, raft_node_t *node);
+
+void eraft_taskis_net_readindex_free(struct eraft_taskis_net_readindex *object);
+
+/*=========================================================*/
+struct eraft_taskis_net_readindex_response
+{
+	struct eraft_dotask             base;
+
+	raft_node_t                     *node;
+	msg_readindex_response_t        *rir;
+};
+
+struct eraft_taskis_net_readindex_response      *eraft_taskis_net_readindex_response_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	msg_readindex_response_t *rir, raft_node_t *node);
+
+void eraft_taskis_net_readindex_response_free(struct eraft_taskis_net_readindex_response *object);
+
+/*=========================================================*/
+struct eraft_taskis_net_commitidx
+{
+	struct eraft_dotask     base;
+
+	raft_node_t             *node;
+	msg_commitidx_t         *ci;
+};
+
+struct eraft_taskis_net_commitidx       *eraft_taskis_net_commitidx_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	msg_commitidx_t *ci, raft_node_t *node);
+
+void eraft_taskis_net_commitidx_free(struct eraft_taskis_net_commitidx *object);
+
+/*=========================================================*/
+struct eraft_taskis_net_commitidx_response
+{
+	struct eraft_dotask             base;
+
+	raft_node_t                     *node;
+	msg_commitidx_response_t        *cir;
+};
+
+struct eraft_taskis_net_commitidx_response      *eraft_taskis_net_commitidx_response_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	msg_commitidx_response_t *cir, raft_node_t *node);
+
+void eraft_taskis_net_commitidx_response_free(struct eraft_taskis_net_commitidx_response *object);
+
+/*=========================================================*/
+struct eraft_taskis_net_snapshot
+{
+	struct eraft_dotask     base;
+
+	raft_node_t             *node;
+	msg_snapshot_t          *sn;
+	void                    *data;	/*sn->len字节的快照数据*/
+};
+
+struct eraft_taskis_net_snapshot        *eraft_taskis_net_snapshot_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	msg_snapshot_t *sn, void *data, raft_node_t *node);
+
+void eraft_taskis_net_snapshot_free(struct eraft_taskis_net_snapshot *object);
+
+/*=========================================================*/
+struct eraft_taskis_net_snapshot_response
+{
+	struct eraft_dotask             base;
+
+	raft_node_t                     *node;
+	msg_snapshot_response_t         *snr;
+};
+
+struct eraft_taskis_net_snapshot_response       *eraft_taskis_net_snapshot_response_make(char *identity, ERAFT_DOTASK_FCB _fcb, void *_usr,
+	msg_snapshot_response_t *snr, raft_node_t *node);
+
+void eraft_taskis_net_snapshot_response_free(struct eraft_taskis_net_snapshot_response *object);
@@ -5,6 +5,14 @@
 #include <poll.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#if defined(__LINUX__) || defined(__linux__)
+  #include <sys/syscall.h>
+  #include <linux/futex.h>
+  #define ETASK_USE_FUTEX
+#endif
 
 #include "etask.h"
 
@@ -101,15 +109,212 @@ int eventfd_xwait(int efds[], int nums, int timeout)
 }
 
 // --------------------------------------//
+#define ETASK_SPIN_TIMES        256
+#define ETASK_POOL_CHUNK        256
+#define ETASK_POOL_MAX_CHUNK    1024
+
+#ifdef ETASK_USE_FUTEX
+/*空闲链表头, 高32位为版本号防止ABA, 低32位为idx+1, 0表示空*/
+static uint64_t         g_pool_head = 0;
+static struct etask     *g_pool_chunks[ETASK_POOL_MAX_CHUNK];
+static int              g_pool_nchunk = 0;
+static pthread_mutex_t  g_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline struct etask *__pool_by_idx(uint32_t idx)
+{
+	return &g_pool_chunks[idx / ETASK_POOL_CHUNK][idx % ETASK_POOL_CHUNK];
+}
+
+static void __pool_push(struct etask *etask)
+{
+	uint64_t        head = 0;
+	uint64_t        next = 0;
+
+	do {
+		head = __atomic_load_n(&g_pool_head, __ATOMIC_ACQUIRE);
+		etask->pool_next = (uint32_t)head;
+		next = (((head >> 32) + 1) << 32) | (etask->pool_idx + 1);
+	} while (!__sync_bool_compare_and_swap(&g_pool_head, head, next));
+}
+
+static bool __pool_grow(void)
+{
+	bool ok = true;
+
+	pthread_mutex_lock(&g_pool_lock);
+
+	if ((uint32_t)__atomic_load_n(&g_pool_head, __ATOMIC_ACQUIRE) == 0) {
+		if (g_pool_nchunk < ETASK_POOL_MAX_CHUNK) {
+			struct etask    *chunk = calloc(ETASK_POOL_CHUNK, sizeof(*chunk));
+			int             base = g_pool_nchunk * ETASK_POOL_CHUNK;
+			assert(chunk);
+
+			g_pool_chunks[g_pool_nchunk] = chunk;
+			__atomic_store_n(&g_pool_nchunk, g_pool_nchunk + 1, __ATOMIC_RELEASE);
+
+			for (int i = 0; i < ETASK_POOL_CHUNK; i++) {
+				chunk[i].efd = -1;
+				chunk[i].pooled = true;
+				chunk[i].pool_idx = base + i;
+				__pool_push(&chunk[i]);
+			}
+		} else {
+			ok = false;
+		}
+	}
+
+	pthread_mutex_unlock(&g_pool_lock);
+	return ok;
+}
+
+static struct etask *__pool_pull(void)
+{
+	uint64_t        head = 0;
+	uint64_t        next = 0;
+	struct etask    *etask = NULL;
+
+	do {
+		head = __atomic_load_n(&g_pool_head, __ATOMIC_ACQUIRE);
+
+		if ((uint32_t)head == 0) {
+			if (!__pool_grow()) {
+				return NULL;
+			}
+
+			continue;
+		}
+
+		/*池内存不会释放,并发读取next是安全的*/
+		etask = __pool_by_idx((uint32_t)head - 1);
+		next = (((head >> 32) + 1) << 32) | __atomic_load_n(&etask->pool_next, __ATOMIC_ACQUIRE);
+	} while (!__sync_bool_compare_and_swap(&g_pool_head, head, next));
+
+	etask->value = 0;
+	etask->waiters = 0;
+	return etask;
+}
+
+static inline void __cpu_relax(void)
+{
+  #if defined(__x86_64__) || defined(__i386__)
+	__asm__ __volatile__ ("pause" ::: "memory");
+  #else
+	__asm__ __volatile__ ("" ::: "memory");
+  #endif
+}
+
+/*单核时自旋没有意义*/
+static int __spin_times(void)
+{
+	static int spin_times = -1;
+
+	if (spin_times < 0) {
+		spin_times = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? ETASK_SPIN_TIMES : 0;
+	}
+
+	return spin_times;
+}
+
+static inline bool __futex_trydown(struct etask *etask)
+{
+	int value = __atomic_load_n(&etask->value, __ATOMIC_ACQUIRE);
+
+	return (value > 0) && __sync_bool_compare_and_swap(&etask->value, value, value - 1);
+}
+
+/*msec小于0为无限等待*/
+static bool __futex_down(struct etask *etask, int msec)
+{
+	int spin_times = __spin_times();
+
+	for (int i = 0; i < spin_times; i++) {
+		if (__futex_trydown(etask)) {
+			return true;
+		}
+
+		__cpu_relax();
+	}
+
+	struct timespec deadline = {};
+
+	if (msec >= 0) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += msec / 1000;
+		deadline.tv_nsec += (msec % 1000) * 1000000;
+
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+	}
+
+	while (!__futex_trydown(etask)) {
+		struct timespec *timeout = NULL;
+		struct timespec remain = {};
+
+		if (msec >= 0) {
+			struct timespec now = {};
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			remain.tv_sec = deadline.tv_sec - now.tv_sec;
+			remain.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+
+			if (remain.tv_nsec < 0) {
+				remain.tv_sec--;
+				remain.tv_nsec += 1000000000;
+			}
+
+			if (remain.tv_sec < 0) {
+				return false;
+			}
+
+			timeout = &remain;
+		}
+
+		/*value为0时才睡眠,awake先加value再唤醒,不会丢失*/
+		__sync_add_and_fetch(&etask->waiters, 1);
+		syscall(SYS_futex, &etask->value, FUTEX_WAIT_PRIVATE, 0, timeout, NULL, 0);
+		__sync_sub_and_fetch(&etask->waiters, 1);
+	}
+
+	return true;
+}
+
+static void __futex_up(struct etask *etask)
+{
+	__sync_add_and_fetch(&etask->value, 1);
+
+	if (__atomic_load_n(&etask->waiters, __ATOMIC_ACQUIRE)) {
+		syscall(SYS_futex, &etask->value, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+	}
+}
+#endif	/* ifdef ETASK_USE_FUTEX */
+
+int etask_pool_size(void)
+{
+#ifdef ETASK_USE_FUTEX
+	return __atomic_load_n(&g_pool_nchunk, __ATOMIC_ACQUIRE) * ETASK_POOL_CHUNK;
+#else
+	return 0;
+#endif
+}
 
 struct etask *etask_make(struct etask *etask)
 {
 	if (etask) {
 		etask->freeable = false;
+		etask->pooled = false;
 	} else {
+#ifdef ETASK_USE_FUTEX
+		etask = __pool_pull();
+
+		if (etask) {
+			return etask;
+		}
+#endif
 		etask = calloc(1, sizeof(*etask));
 		assert(etask);
 		etask->freeable = true;
+		etask->pooled = false;
 	}
 
 	etask->efd = eventfd(0, EFD_SEMAPHORE | EFD_NONBLOCK);
@@ -120,6 +325,13 @@ void etask_free(struct etask *etask)
 {
 	assert(etask);
 
+#ifdef ETASK_USE_FUTEX
+	if (etask->pooled) {
+		__pool_push(etask);
+		return;
+	}
+#endif
+
 	close(etask->efd);
 
 	if (etask->freeable) {
@@ -131,6 +343,13 @@ void etask_awake(struct etask *etask)
 {
 	assert(etask);
 
+#ifdef ETASK_USE_FUTEX
+	if (etask->efd < 0) {
+		__futex_up(etask);
+		return;
+	}
+#endif
+
 	eventfd_xsend(etask->efd, 1);
 }
 
@@ -138,6 +357,13 @@ void etask_sleep(struct etask *etask)
 {
 	assert(etask);
 
+#ifdef ETASK_USE_FUTEX
+	if (etask->efd < 0) {
+		__futex_down(etask, -1);
+		return;
+	}
+#endif
+
 	eventfd_t val = 0;
 	do {
 		int efd = etask->efd;
@@ -151,6 +377,12 @@ bool etask_twait(struct etask *etask, int msec)
 {
 	assert(etask);
 
+#ifdef ETASK_USE_FUTEX
+	if (etask->efd < 0) {
+		return __futex_down(etask, msec);
+	}
+#endif
+
 	int     efd = etask->efd;
 	bool    have = eventfd_xwait(&efd, 1, msec) ? true : false;
 
@@ -165,4 +397,3 @@ bool etask_twait(struct etask *etask, int msec)
 
 	return have;
 }
-
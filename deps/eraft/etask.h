@@ -40,10 +40,20 @@ int eventfd_xsend(int efd, eventfd_t value);
 
 int eventfd_xwait(int efds[], int nums, int timeout);
 
+/*
+ * etask_make(NULL)从全局池中取对象, 先自旋再睡在futex上, 不占用fd;
+ * 传入外部etask时使用eventfd, efd可加入事件循环.
+ */
 struct etask
 {
-	int     efd;
-	bool    freeable;
+	int             efd;	/*-1时使用futex*/
+	bool            freeable;
+
+	int             value;	/*futex计数,语义同EFD_SEMAPHORE*/
+	int             waiters;
+	bool            pooled;
+	uint32_t        pool_idx;
+	uint32_t        pool_next;
 };
 
 struct etask    *etask_make(struct etask *etask);
@@ -57,3 +67,6 @@ void etask_sleep(struct etask *etask);
 /*msec小于0为无限等待*/
 bool etask_twait(struct etask *etask, int msec);
 
+/*池中已分配的etask个数*/
+int etask_pool_size(void);
+
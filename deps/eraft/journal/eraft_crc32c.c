@@ -0,0 +1,106 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "eraft_crc32c.h"
+
+#define CRC32C_POLY     0x82f63b78	/*反转后的多项式*/
+
+static uint32_t         g_crc32c_table[8][256];
+static pthread_once_t   g_crc32c_once = PTHREAD_ONCE_INIT;
+static uint32_t (*g_crc32c_func)(uint32_t crc, const unsigned char *ptr, size_t len);
+
+/*一次处理8个字节*/
+static uint32_t __crc32c_slicing8(uint32_t crc, const unsigned char *ptr, size_t len)
+{
+	while (len && ((uintptr_t)ptr & 7)) {
+		crc = g_crc32c_table[0][(crc ^ *ptr++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+
+	while (len >= 8) {
+		uint64_t word;
+		memcpy(&word, ptr, sizeof(word));
+
+		uint32_t        lo = (uint32_t)word ^ crc;
+		uint32_t        hi = (uint32_t)(word >> 32);
+
+		crc = g_crc32c_table[7][lo & 0xff] ^
+			g_crc32c_table[6][(lo >> 8) & 0xff] ^
+			g_crc32c_table[5][(lo >> 16) & 0xff] ^
+			g_crc32c_table[4][lo >> 24] ^
+			g_crc32c_table[3][hi & 0xff] ^
+			g_crc32c_table[2][(hi >> 8) & 0xff] ^
+			g_crc32c_table[1][(hi >> 16) & 0xff] ^
+			g_crc32c_table[0][hi >> 24];
+		ptr += 8;
+		len -= 8;
+	}
+
+	while (len--) {
+		crc = g_crc32c_table[0][(crc ^ *ptr++) & 0xff] ^ (crc >> 8);
+	}
+
+	return crc;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((target("sse4.2")))
+static uint32_t __crc32c_sse42(uint32_t crc, const unsigned char *ptr, size_t len)
+{
+	uint64_t crc64 = crc;
+
+	while (len && ((uintptr_t)ptr & 7)) {
+		crc64 = __builtin_ia32_crc32qi((uint32_t)crc64, *ptr++);
+		len--;
+	}
+
+	while (len >= 8) {
+		uint64_t word;
+		memcpy(&word, ptr, sizeof(word));
+		crc64 = __builtin_ia32_crc32di(crc64, word);
+		ptr += 8;
+		len -= 8;
+	}
+
+	while (len--) {
+		crc64 = __builtin_ia32_crc32qi((uint32_t)crc64, *ptr++);
+	}
+
+	return (uint32_t)crc64;
+}
+#endif
+
+static void __crc32c_init(void)
+{
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+
+		for (int k = 0; k < 8; k++) {
+			crc = (crc & 1) ? ((crc >> 1) ^ CRC32C_POLY) : (crc >> 1);
+		}
+
+		g_crc32c_table[0][i] = crc;
+	}
+
+	for (uint32_t i = 0; i < 256; i++) {
+		for (int t = 1; t < 8; t++) {
+			uint32_t prev = g_crc32c_table[t - 1][i];
+			g_crc32c_table[t][i] = g_crc32c_table[0][prev & 0xff] ^ (prev >> 8);
+		}
+	}
+
+	g_crc32c_func = __crc32c_slicing8;
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+	if (__builtin_cpu_supports("sse4.2")) {
+		g_crc32c_func = __crc32c_sse42;
+	}
+#endif
+}
+
+uint32_t eraft_crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	pthread_once(&g_crc32c_once, __crc32c_init);
+
+	return ~g_crc32c_func(~crc, buf, len);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * CRC32C(Castagnoli), 用于日志记录校验.
+ * x86支持SSE4.2时使用crc32指令, 否则使用slicing-by-8查表.
+ */
+
+/* 在crc的基础上继续计算, 初始值为0 */
+uint32_t eraft_crc32c(uint32_t crc, const void *buf, size_t len);
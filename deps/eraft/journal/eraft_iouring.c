@@ -0,0 +1,359 @@
+#ifndef _GNU_SOURCE
+  #define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "eraft_utils.h"
+#include "eraft_iouring.h"
+
+#ifdef __NR_io_uring_setup
+  #include <linux/io_uring.h>
+
+struct iouring_req;
+
+/*每个sqe的user_data, 记录所属请求和期望的返回值*/
+struct iouring_ctx
+{
+	struct iouring_req      *req;
+	size_t                  expect;
+};
+
+struct iouring_req
+{
+	int                     pending;	/*未完成的sqe个数*/
+	int                     result;
+	ERAFT_IOURING_FCB       fcb;
+	void                    *usr;
+	struct iouring_ctx      ctx[];
+};
+
+struct eraft_iouring
+{
+	int                     fd;
+
+	void                    *sq_ptr;
+	size_t                  sq_size;
+	unsigned                *sq_head;
+	unsigned                *sq_tail;
+	unsigned                *sq_mask;
+	unsigned                *sq_array;
+	unsigned                sq_entries;
+	struct io_uring_sqe     *sqes;
+	size_t                  sqes_size;
+
+	void                    *cq_ptr;
+	size_t                  cq_size;
+	unsigned                *cq_head;
+	unsigned                *cq_tail;
+	unsigned                *cq_mask;
+	struct io_uring_cqe     *cqes;
+
+	pthread_mutex_t         lock;	/*多个日志线程共用提交队列*/
+	pthread_t               pid;
+	bool                    exit;
+};
+
+static int __io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int __io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void *_iouring_reap(void *arg)
+{
+	struct eraft_iouring *ring = arg;
+
+	while (!ring->exit) {
+		unsigned        head = *ring->cq_head;
+		unsigned        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+		if (head == tail) {
+			__io_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS);
+			continue;
+		}
+
+		for (; head != tail; head++) {
+			struct io_uring_cqe     *cqe = &ring->cqes[head & *ring->cq_mask];
+			struct iouring_ctx      *ctx = (struct iouring_ctx *)(uintptr_t)cqe->user_data;
+
+			/*退出时提交的nop*/
+			if (!ctx) {
+				continue;
+			}
+
+			struct iouring_req *req = ctx->req;
+
+			if ((cqe->res < 0) || ((size_t)cqe->res != ctx->expect)) {
+				(void)ATOMIC_CAS(&req->result, 0, (cqe->res < 0) ? cqe->res : -EIO);
+			}
+
+			if (ATOMIC_SUB_F(&req->pending, 1) == 0) {
+				req->fcb(req->result, req->usr);
+				free(req);
+			}
+		}
+
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
+
+struct eraft_iouring *eraft_iouring_make(unsigned entries)
+{
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+
+	int fd = __io_uring_setup(entries, &p);
+
+	if (fd < 0) {
+		printf("io_uring unavailable: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	struct eraft_iouring *ring = calloc(1, sizeof(*ring));
+	ring->fd = fd;
+	ring->sq_entries = p.sq_entries;
+	ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->sq_size = ring->cq_size = MAX(ring->sq_size, ring->cq_size);
+	}
+
+	ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+	if (ring->sq_ptr == MAP_FAILED) {
+		goto fail;
+	}
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ptr = ring->sq_ptr;
+	} else {
+		ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+
+		if (ring->cq_ptr == MAP_FAILED) {
+			ring->cq_ptr = NULL;
+			goto fail;
+		}
+	}
+
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		goto fail;
+	}
+
+	ring->sq_head = (unsigned *)((char *)ring->sq_ptr + p.sq_off.head);
+	ring->sq_tail = (unsigned *)((char *)ring->sq_ptr + p.sq_off.tail);
+	ring->sq_mask = (unsigned *)((char *)ring->sq_ptr + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)((char *)ring->sq_ptr + p.sq_off.array);
+	ring->cq_head = (unsigned *)((char *)ring->cq_ptr + p.cq_off.head);
+	ring->cq_tail = (unsigned *)((char *)ring->cq_ptr + p.cq_off.tail);
+	ring->cq_mask = (unsigned *)((char *)ring->cq_ptr + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ptr + p.cq_off.cqes);
+
+	pthread_mutex_init(&ring->lock, NULL);
+	int e = pthread_create(&ring->pid, NULL, &_iouring_reap, ring);
+	assert(e == 0);
+
+	return ring;
+
+fail:
+	printf("io_uring mmap failed: %s\n", strerror(errno));
+
+	if (ring->sqes) {
+		munmap(ring->sqes, ring->sqes_size);
+	}
+
+	if (ring->cq_ptr && (ring->cq_ptr != ring->sq_ptr)) {
+		munmap(ring->cq_ptr, ring->cq_size);
+	}
+
+	if (ring->sq_ptr != MAP_FAILED) {
+		munmap(ring->sq_ptr, ring->sq_size);
+	}
+
+	close(fd);
+	free(ring);
+	return NULL;
+}
+
+static int __iouring_push(struct eraft_iouring *ring, unsigned count)
+{
+	unsigned done = 0;
+
+	while (done < count) {
+		int e = __io_uring_enter(ring->fd, count - done, 0, 0);
+
+		if (e < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY)) {
+				sched_yield();
+				continue;
+			}
+
+			return -errno;
+		}
+
+		done += e;
+	}
+
+	return 0;
+}
+
+void eraft_iouring_free(struct eraft_iouring *ring)
+{
+	pthread_mutex_lock(&ring->lock);
+	ring->exit = true;
+
+	/*唤醒完成线程*/
+	unsigned                tail = *ring->sq_tail;
+	unsigned                idx = tail & *ring->sq_mask;
+	struct io_uring_sqe     *sqe = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_NOP;
+	ring->sq_array[idx] = idx;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	__iouring_push(ring, 1);
+	pthread_mutex_unlock(&ring->lock);
+
+	pthread_join(ring->pid, NULL);
+	pthread_mutex_destroy(&ring->lock);
+
+	munmap(ring->sqes, ring->sqes_size);
+
+	if (ring->cq_ptr != ring->sq_ptr) {
+		munmap(ring->cq_ptr, ring->cq_size);
+	}
+
+	munmap(ring->sq_ptr, ring->sq_size);
+	close(ring->fd);
+	free(ring);
+}
+
+int eraft_iouring_submit(struct eraft_iouring *ring, struct eraft_iouring_op *ops, int count, ERAFT_IOURING_FCB fcb, void *usr)
+{
+	unsigned need = 0;
+
+	for (int i = 0; i < count; i++) {
+		need += (ops[i].iovcnt + IOV_MAX - 1) / IOV_MAX + (ops[i].sync ? 1 : 0);
+	}
+
+	if ((need == 0) || (need > ring->sq_entries)) {
+		return -EINVAL;
+	}
+
+	struct iouring_req *req = calloc(1, sizeof(*req) + need * sizeof(struct iouring_ctx));
+	req->pending = need;
+	req->fcb = fcb;
+	req->usr = usr;
+
+	pthread_mutex_lock(&ring->lock);
+
+	unsigned        tail = *ring->sq_tail;
+	unsigned        n = 0;
+
+	for (int i = 0; i < count; i++) {
+		struct eraft_iouring_op *op = &ops[i];
+		uint64_t                off = op->off;
+
+		/*同一个fd的写入和fdatasync链接执行,前一个失败后面的取消*/
+		for (int j = 0; j < op->iovcnt; j += IOV_MAX) {
+			int                     cnt = MIN(op->iovcnt - j, IOV_MAX);
+			unsigned                idx = (tail + n) & *ring->sq_mask;
+			struct io_uring_sqe     *sqe = &ring->sqes[idx];
+			size_t                  bytes = 0;
+
+			for (int k = 0; k < cnt; k++) {
+				bytes += op->iov[j + k].iov_len;
+			}
+
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_WRITEV;
+			sqe->fd = op->fd;
+			sqe->addr = (uintptr_t)&op->iov[j];
+			sqe->len = cnt;
+			sqe->off = off;
+			sqe->flags = ((j + cnt < op->iovcnt) || op->sync) ? IOSQE_IO_LINK : 0;
+			req->ctx[n].req = req;
+			req->ctx[n].expect = bytes;
+			sqe->user_data = (uintptr_t)&req->ctx[n];
+			ring->sq_array[idx] = idx;
+
+			off += bytes;
+			n++;
+		}
+
+		if (op->sync) {
+			unsigned                idx = (tail + n) & *ring->sq_mask;
+			struct io_uring_sqe     *sqe = &ring->sqes[idx];
+
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_FSYNC;
+			sqe->fd = op->fd;
+			sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+			req->ctx[n].req = req;
+			req->ctx[n].expect = 0;
+			sqe->user_data = (uintptr_t)&req->ctx[n];
+			ring->sq_array[idx] = idx;
+			n++;
+		}
+	}
+
+	__atomic_store_n(ring->sq_tail, tail + n, __ATOMIC_RELEASE);
+	int e = __iouring_push(ring, n);
+
+	if (e != 0) {
+		/*未被内核取走的sqe收回*/
+		unsigned        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+		unsigned        left = tail + n - head;
+
+		__atomic_store_n(ring->sq_tail, head, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&ring->lock);
+
+		(void)ATOMIC_CAS(&req->result, 0, e);
+
+		if (ATOMIC_SUB_F(&req->pending, left) == 0) {
+			free(req);
+			return e;
+		}
+
+		return 0;
+	}
+
+	pthread_mutex_unlock(&ring->lock);
+	return 0;
+}
+
+#else	/* ifdef __NR_io_uring_setup */
+
+struct eraft_iouring *eraft_iouring_make(unsigned entries)
+{
+	printf("io_uring unavailable: not supported by this system\n");
+	return NULL;
+}
+
+void eraft_iouring_free(struct eraft_iouring *ring)
+{}
+
+int eraft_iouring_submit(struct eraft_iouring *ring, struct eraft_iouring_op *ops, int count, ERAFT_IOURING_FCB fcb, void *usr)
+{
+	return -ENOSYS;
+}
+#endif	/* ifdef __NR_io_uring_setup */
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+
+/*
+ * 基于io_uring系统调用的异步写入, 不依赖liburing.
+ * 所有日志共用一个ring, 由一个完成线程回调.
+ */
+typedef void (*ERAFT_IOURING_FCB)(int result, void *usr);
+
+struct eraft_iouring;
+
+/*对一个fd的写入, iovcnt为0时只做fdatasync*/
+struct eraft_iouring_op
+{
+	int             fd;
+	struct iovec    *iov;
+	int             iovcnt;
+	uint64_t        off;
+	bool            sync;	/*写入完成后链接一个fdatasync*/
+};
+
+/* 创建ring和完成线程, 内核不支持或被禁止时返回NULL */
+struct eraft_iouring    *eraft_iouring_make(unsigned entries);
+
+void eraft_iouring_free(struct eraft_iouring *ring);
+
+/* 提交一组操作, 全部完成后在完成线程中调用fcb, result为0或负的errno */
+int eraft_iouring_submit(struct eraft_iouring *ring, struct eraft_iouring_op *ops, int count, ERAFT_IOURING_FCB fcb, void *usr);
@@ -35,6 +35,7 @@
 void eraft_journal_init(struct eraft_journal *store, int acceptor_id, char *dbpath, uint64_t dbsize, int type)
 {
 	store->type = type;
+	memset(&store->api, 0, sizeof(store->api));
 
 	ERAFT_JOURNAL_IMPL_INIT finit = eraft_journal_mapping_init(type);
 	finit(store, acceptor_id, dbpath, dbsize);
@@ -67,6 +68,17 @@ int eraft_journal_tx_commit(struct eraft_journal *store, void *txn)
 	return store->api.tx_commit(store->handle, txn);
 }
 
+int eraft_journal_tx_commit_async(struct eraft_journal *store, void *txn, ERAFT_JOURNAL_COMMIT_FCB fcb, void *usr)
+{
+	if (store->api.tx_commit_async) {
+		return store->api.tx_commit_async(store->handle, txn, fcb, usr);
+	}
+
+	int e = store->api.tx_commit(store->handle, txn);
+	fcb(e, usr);
+	return 0;
+}
+
 void eraft_journal_tx_abort(struct eraft_journal *store, void *txn)
 {
 	store->api.tx_abort(store->handle, txn);
@@ -82,7 +94,6 @@ int eraft_journal_set_record(struct eraft_journal *store, void *txn, iid_t iid,
 	return store->api.set(store->handle, txn, iid, eentry);
 }
 
-#if 0
 int eraft_journal_trim(struct eraft_journal *store, void *txn, iid_t iid)
 {
 	return store->api.trim(store->handle, txn, iid);
@@ -93,7 +104,15 @@ iid_t eraft_journal_get_trim_instance(struct eraft_journal *store)
 	return store->api.get_trim_instance(store->handle);
 }
 
-#endif
+int eraft_journal_pop(struct eraft_journal *store, void *txn, iid_t iid)
+{
+	return store->api.pop(store->handle, txn, iid);
+}
+
+int eraft_journal_foreach(struct eraft_journal *store, iid_t iid, ERAFT_JOURNAL_FOREACH_FCB fcb, void *usr)
+{
+	return store->api.foreach(store->handle, iid, fcb, usr);
+}
 
 int eraft_journal_set_state(struct eraft_journal *store, char *key, size_t klen, char *val, size_t vlen)
 {
@@ -67,6 +67,24 @@ static inline int eraft_entry_decode(struct eraft_entry *eentry, char *data, siz
 	return 0;
 }
 
+/*解码后数据指向data内部,不复制*/
+static inline int eraft_entry_view(struct eraft_entry *eentry, char *data, size_t size)
+{
+	if (size < sizeof(*eentry)) {
+		return -1;
+	}
+
+	memcpy(eentry, data, sizeof(*eentry));
+	eentry->entry.data.buf = NULL;
+
+	if (eraft_entry_cubage(eentry) != size) {
+		return -1;
+	}
+
+	eentry->entry.data.buf = data + sizeof(*eentry);
+	return 0;
+}
+
 static inline int eraft_journal_encode(struct eraft_entry *eentry, char *data, size_t size)
 {
 	if (eraft_entry_cubage(eentry) != size) {
@@ -79,6 +97,12 @@ static inline int eraft_journal_encode(struct eraft_entry *eentry, char *data, s
 	return 0;
 }
 
+/*异步提交完成回调, result为0表示已落盘*/
+typedef void (*ERAFT_JOURNAL_COMMIT_FCB)(int result, void *usr);
+
+/*遍历回调, entry的数据指向存储内部, 只在回调内有效*/
+typedef void (*ERAFT_JOURNAL_FOREACH_FCB)(iid_t iid, raft_entry_t *entry, void *usr);
+
 struct eraft_journal
 {
 	int     type;
@@ -91,12 +115,15 @@ struct eraft_journal
 		void    (*close) (void *handle);
 		void    *(*tx_begin) (void *handle);
 		int     (*tx_commit) (void *handle, void *txn);
+		int     (*tx_commit_async) (void *handle, void *txn, ERAFT_JOURNAL_COMMIT_FCB fcb, void *usr);	/*可为空,为空时同步提交*/
 		void    (*tx_abort) (void *handle, void *txn);
 		int     (*get) (void *handle, void *txn, iid_t iid, struct eraft_entry *eentry);	/*返回成功设置的个数*/
 		int     (*set) (void *handle, void *txn, iid_t iid, struct eraft_entry *eentry);	/*返回成功查询的个数*/
 
-		//		int     (*trim) (void *handle, iid_t iid);
-		//		iid_t   (*get_trim_instance) (void *handle);
+		int     (*trim) (void *handle, void *txn, iid_t iid);	/*删除iid及之前的日志*/
+		iid_t   (*get_trim_instance) (void *handle);		/*已删除到的iid,未删除过时为0*/
+		int     (*pop) (void *handle, void *txn, iid_t iid);	/*删除iid及之后的日志*/
+		int     (*foreach) (void *handle, iid_t iid, ERAFT_JOURNAL_FOREACH_FCB fcb, void *usr);	/*按顺序遍历iid及之后连续的日志,返回遍历的条数*/
 
 		/*for state*/
 		int     (*set_state) (void *handle, char *key, size_t klen, char *val, size_t vlen);
@@ -117,15 +144,25 @@ void *eraft_journal_tx_begin(struct eraft_journal *store);
 
 int eraft_journal_tx_commit(struct eraft_journal *store, void *txn);
 
+/*提交后fcb可能在其它线程调用,返回非0时不会调用fcb*/
+int eraft_journal_tx_commit_async(struct eraft_journal *store, void *txn, ERAFT_JOURNAL_COMMIT_FCB fcb, void *usr);
+
 void eraft_journal_tx_abort(struct eraft_journal *store, void *txn);
 
 int eraft_journal_get_record(struct eraft_journal *store, void *txn, iid_t iid, struct eraft_entry *eentry);
 
 int eraft_journal_set_record(struct eraft_journal *store, void *txn, iid_t iid, struct eraft_entry *eentry);
 
-// int eraft_journal_trim(struct eraft_journal *store, iid_t iid);
+/*日志压缩,删除已应用的旧日志*/
+int eraft_journal_trim(struct eraft_journal *store, void *txn, iid_t iid);
+
+iid_t eraft_journal_get_trim_instance(struct eraft_journal *store);
+
+/*删除与leader冲突的日志*/
+int eraft_journal_pop(struct eraft_journal *store, void *txn, iid_t iid);
 
-// iid_t eraft_journal_get_trim_instance(struct eraft_journal *store);
+/*重启时加载未应用的日志, 只在open之后, 写入之前调用*/
+int eraft_journal_foreach(struct eraft_journal *store, iid_t iid, ERAFT_JOURNAL_FOREACH_FCB fcb, void *usr);
 
 /*===for state===*/
 int eraft_journal_set_state(struct eraft_journal *store, char *key, size_t klen, char *val, size_t vlen);
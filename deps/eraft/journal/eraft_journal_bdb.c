@@ -43,7 +43,10 @@ struct bdb_eraft_journal
 	uint64_t        db_size;
 
 	DB              *dbp;
+	DB              *trimp;		/*记录号1保存已删除到的iid,记录全部删除后无法从dbp得到*/
 	DB_ENV          *dbenv;
+
+	iid_t           trim_iid;
 };
 
 /* DB的函数执行完成后，返回0代表成功，否则失败 */
@@ -102,6 +105,13 @@ static void __load_db(struct bdb_eraft_journal *bdb, char *db_path, int db_size)
 	ret = dbp->open(dbp, txnp, "entrys.db", NULL, DB_RECNO, flags, 0);
 	print_error(ret);
 
+	ret = db_create(&bdb->trimp, dbenv, 0);
+	print_error(ret);
+	assert(bdb->trimp);
+
+	ret = bdb->trimp->open(bdb->trimp, txnp, "trim.db", NULL, DB_RECNO, flags, 0);
+	print_error(ret);
+
 	ret = txnp->commit(txnp, 0);
 	txnp = NULL;
 	print_error(ret);
@@ -113,6 +123,7 @@ static void __drop_db(struct bdb_eraft_journal *bdb)
 
 	bdb->dbenv = NULL;
 	bdb->dbp = NULL;
+	bdb->trimp = NULL;
 }
 
 /*丢弃一个*/
@@ -155,6 +166,22 @@ static int bdb_eraft_journal_open(void *handle)
 	_bdb_load(s, db_env_path, s->db_size);
 
 	free(db_env_path);
+
+	/*重启前删除到的iid*/
+	db_recno_t      recno = 1;
+	DBT             key, val;
+
+	init_DBT(&key, &val);
+	key.data = &recno;
+	key.size = sizeof(recno);
+	val.data = &s->trim_iid;
+	val.ulen = sizeof(s->trim_iid);
+	val.flags = DB_DBT_USERMEM;
+
+	if (s->trimp->get(s->trimp, NULL, &key, &val, 0) != 0) {
+		s->trim_iid = 0;
+	}
+
 	return 0;
 }
 
@@ -162,6 +189,10 @@ static void bdb_eraft_journal_close(void *handle)
 {
 	struct bdb_eraft_journal *s = handle;
 
+	if (s->trimp) {
+		s->trimp->close(s->trimp, 0);
+	}
+
 	if (s->dbp) {
 		s->dbp->close(s->dbp, 0);
 	}
@@ -264,195 +295,145 @@ static int bdb_eraft_journal_set(void *handle, void *txn, iid_t iid, struct eraf
 	return 1;
 }
 
-#if 0
-static iid_t
-bdb_eraft_journal_get_trim_instance(void *handle)
-{
-	struct bdb_eraft_journal        *s = handle;
-	int                             result;
-	iid_t                           iid = 0, k = 0;
-	MDB_val                         key, data;
-
-	key.mv_data = &k;
-	key.mv_size = sizeof(iid_t);
-
-	if ((result = mdb_get(txn, s->entries, &key, &data)) != 0) {
-		if (result != MDB_NOTFOUND) {
-			paxos_log_error("mdb_get failed: %s", mdb_strerror(result));
-			assert(result == 0);
-		} else {
-			iid = 0;
-		}
-	} else {
-		iid = *(iid_t *)data.mv_data;
-	}
-
-	return iid;
-}
-
-static int
-bdb_eraft_journal_put_trim_instance(void *handle, iid_t iid)
+/*RECNO的记录号从1开始,第一条记录之前的都已删除*/
+static iid_t bdb_eraft_journal_get_trim_instance(void *handle)
 {
 	struct bdb_eraft_journal        *s = handle;
-	iid_t                           k = 0;
-	int                             result;
-	MDB_val                         key, data;
+	DBC                             *cursorp = NULL;
+	iid_t                           iid = s->trim_iid;
 
-	key.mv_data = &k;
-	key.mv_size = sizeof(iid_t);
+	if (s->dbp->cursor(s->dbp, NULL, &cursorp, 0) == 0) {
+		DBT key, val;
+		init_DBT(&key, &val);
 
-	data.mv_data = &iid;
-	data.mv_size = sizeof(iid_t);
-
-	result = mdb_put(txn, s->entries, &key, &data, 0);
+		if (cursorp->get(cursorp, &key, &val, DB_FIRST) == 0) {
+			iid = MAX(iid, *(db_recno_t *)key.data - 1);
+		}
 
-	if (result != 0) {
-		paxos_log_error("%s\n", mdb_strerror(result));
+		cursorp->close(cursorp);
 	}
 
-	assert(result == 0);
-
-	return 0;
+	return iid;
 }
 
-static int
-bdb_eraft_journal_trim(void *handle, iid_t iid)
+/*游标只经过存在的记录,落后很多时不产生大量空删除;删除到的iid与删除在同一事务中保存*/
+static int bdb_eraft_journal_trim(void *handle, void *txn, iid_t iid)
 {
 	struct bdb_eraft_journal        *s = handle;
-	int                             result;
-	iid_t                           min = 0;
-	MDB_cursor                      *cursor = NULL;
-	MDB_val                         key, data;
+	DBC                             *cursorp = NULL;
+	DBT                             key, val;
 
-	if (iid == 0) {
+	if (iid <= s->trim_iid) {
 		return 0;
 	}
 
-	bdb_eraft_journal_put_trim_instance(handle, iid);
+	int ret = s->dbp->cursor(s->dbp, (DB_TXN *)txn, &cursorp, 0);
 
-	if ((result = mdb_cursor_open(txn, s->entries, &cursor)) != 0) {
-		paxos_log_error("Could not create cursor. %s", mdb_strerror(result));
-		goto cleanup_exit;
+	if (ret != 0) {
+		print_error(ret);
+		return -1;
 	}
 
-	key.mv_data = &min;
-	key.mv_size = sizeof(iid_t);
+	init_DBT(&key, &val);
 
-	do {
-		if ((result = mdb_cursor_get(cursor, &key, &data, MDB_NEXT)) == 0) {
-			assert(key.mv_size = sizeof(iid_t));
-			min = *(iid_t *)key.mv_data;
-		} else {
-			goto cleanup_exit;
-		}
+	uint32_t flag = DB_FIRST;
 
-		if ((min != 0) && (min <= iid)) {
-			if (mdb_cursor_del(cursor, 0) != 0) {
-				paxos_log_error("mdb_cursor_del failed. %s",
-					mdb_strerror(result));
-				goto cleanup_exit;
-			}
+	while ((ret = cursorp->get(cursorp, &key, &val, flag)) == 0) {
+		flag = DB_NEXT;
+
+		if (*(db_recno_t *)key.data > iid) {
+			break;
 		}
-	} while (min <= iid);
 
-cleanup_exit:
+		ret = cursorp->del(cursorp, 0);
 
-	if (cursor) {
-		mdb_cursor_close(cursor);
+		if ((ret != 0) && (ret != DB_KEYEMPTY)) {
+			break;
+		}
 	}
 
-	return 0;
-}
+	cursorp->close(cursorp);
 
-#endif	/* if 0 */
+	if ((ret != 0) && (ret != DB_NOTFOUND)) {
+		print_error(ret);
+		return -1;
+	}
 
-static void __pop_newest_log(struct bdb_eraft_journal *bdb)
-{
-#ifdef TEST_NETWORK_ONLY
-	return;
-#endif
-	// MDB_val k, v;
+	db_recno_t recno = 1;
+	init_DBT(&key, &val);
+	key.data = &recno;
+	key.size = sizeof(recno);
+	val.data = &iid;
+	val.size = sizeof(iid);
 
-	// mdb_pop(bdb->db_env, bdb->entries, &k, &v);
-}
+	ret = s->trimp->put(s->trimp, (DB_TXN *)txn, &key, &val, 0);
 
-static void __pop_oldest_log(struct bdb_eraft_journal *bdb)
-{
-#ifdef TEST_NETWORK_ONLY
-	return;
-#endif
-	// MDB_val k, v;
+	if (ret != 0) {
+		print_error(ret);
+		return -1;
+	}
 
-	// mdb_poll(bdb->db_env, bdb->entries, &k, &v);
+	s->trim_iid = iid;
+	return 0;
 }
 
-typedef void (*ERAFT_DSTORE_LOAD_COMMIT_LOG_FCB)(struct eraft_journal *journal, raft_entry_t *entry, void *usr);
-/** Load all log entries we have persisted to disk */
-static int __load_foreach_append_log(struct bdb_eraft_journal *bdb, ERAFT_DSTORE_LOAD_COMMIT_LOG_FCB fcb, void *usr)
+static int bdb_eraft_journal_pop(void *handle, void *txn, iid_t iid)
 {
-#if 0
-	MDB_cursor      *curs;
-	MDB_txn         *txn;
-	MDB_val         k, v;
-	int             e;
-	int             n_entries = 0;
-
-	e = mdb_txn_begin(bdb->db_env, NULL, MDB_RDONLY, &txn);
-
-	if (0 != e) {
-		mdb_fatal(e);
-	}
+	struct bdb_eraft_journal *s = handle;
 
-	e = mdb_cursor_open(txn, bdb->entries, &curs);
+	/*删到最后一条记录之后为止*/
+	for (iid_t k = iid; k; k++) {
+		DBT key, val;
+		init_DBT(&key, &val);
+		key.data = &k;
+		key.size = sizeof(iid_t);
 
-	if (0 != e) {
-		mdb_fatal(e);
-	}
+		int ret = s->dbp->del(s->dbp, (DB_TXN *)txn, &key, 0);
 
-	e = mdb_cursor_get(curs, &k, &v, MDB_FIRST);
-	switch (e)
-	{
-		case 0:
+		if (ret == DB_NOTFOUND) {
 			break;
+		}
 
-		case MDB_NOTFOUND:
-			return 0;
-
-		default:
-			mdb_fatal(e);
+		if ((ret != 0) && (ret != DB_KEYEMPTY)) {
+			print_error(ret);
+			return -1;
+		}
 	}
 
-	raft_entry_t ety;
-	ety.id = 0;
+	return 0;
+}
 
-	do {
-		if (!(*(int *)k.mv_data & 1)) {
-			/* entry metadata */
-			__deserialize(&ety, v.mv_data, v.mv_size);
-		} else {
-			/* entry data for FSM */
-			ety.data.buf = v.mv_data;
-			ety.data.len = v.mv_size;
+/*所有记录共用一个按需扩大的缓冲区*/
+static int bdb_eraft_journal_foreach(void *handle, iid_t iid, ERAFT_JOURNAL_FOREACH_FCB fcb, void *usr)
+{
+	struct bdb_eraft_journal        *s = handle;
+	void                            *buf = NULL;
+	int                             n_entries = 0;
 
-			fcb(bdb, &ety, usr);
-			n_entries++;
-		}
+	for (iid_t k = MAX(iid, bdb_eraft_journal_get_trim_instance(handle) + 1); k; k++) {
+		struct eraft_entry      eentry;
+		DBT                     key, val;
 
-		e = mdb_cursor_get(curs, &k, &v, MDB_NEXT);
-	} while (0 == e);
+		init_DBT(&key, &val);
+		key.data = &k;
+		key.size = sizeof(iid_t);
+		val.data = buf;
+		val.flags = DB_DBT_REALLOC;
 
-	mdb_cursor_close(curs);
+		int ret = s->dbp->get(s->dbp, NULL, &key, &val, 0);
+		buf = val.data;
 
-	e = mdb_txn_commit(txn);
+		if ((ret != 0) || (eraft_entry_view(&eentry, val.data, val.size) != 0)) {
+			break;
+		}
 
-	if (0 != e) {
-		mdb_fatal(e);
+		fcb(k, &eentry.entry, usr);
+		n_entries++;
 	}
 
+	free(buf);
+
 	return n_entries;
-#else
-	return 0;
-#endif	/* if 0 */
 }
 
 static int bdb_eraft_journal_set_state(void *handle, char *key, size_t klen, char *val, size_t vlen)
@@ -503,8 +484,10 @@ void eraft_journal_init_bdb(struct eraft_journal *j, int acceptor_id, char *dbpa
 	j->api.tx_abort = bdb_eraft_journal_tx_abort;
 	j->api.get = bdb_eraft_journal_get;
 	j->api.set = bdb_eraft_journal_set;
-	// j->api.trim = bdb_eraft_journal_trim;
-	// j->api.get_trim_instance = bdb_eraft_journal_get_trim_instance;
+	j->api.trim = bdb_eraft_journal_trim;
+	j->api.get_trim_instance = bdb_eraft_journal_get_trim_instance;
+	j->api.pop = bdb_eraft_journal_pop;
+	j->api.foreach = bdb_eraft_journal_foreach;
 
 	j->api.set_state = bdb_eraft_journal_set_state;
 	j->api.get_state = bdb_eraft_journal_get_state;
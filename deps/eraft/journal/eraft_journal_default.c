@@ -26,64 +26,831 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifndef _GNU_SOURCE
+  #define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
 #include <assert.h>
 
+#include "eraft_confs.h"
 #include "eraft_journal.h"
+#include "eraft_journal_ext.h"
+#include "eraft_iouring.h"
+#include "eraft_crc32c.h"
+
+#define DEFAULT_STATE_KEY_LEN   32
+#define DEFAULT_STATE_VAL_LEN   32
+#define DEFAULT_STATE_MAX       16
+#define DEFAULT_TRIM_KEY        "trim_iid"
+#define DEFAULT_GEN_KEY         "gen"
+
+/*日志按固定大小分段写入,段文件以段内第一条日志的iid命名*/
+struct default_segment
+{
+	iid_t           first_iid;
+	int             fd;
+	int             dfd;	/*O_DIRECT写入,未开启时为-1*/
+	uint64_t        size;	/*已写入的字节数,文件已预分配,大小不代表数据长度*/
+};
 
-struct default_eraft_journal
+/*iid到段内位置的索引*/
+struct default_index
 {
-	int             acceptor_id;
-	char            *db_path;
-	uint64_t        db_size;
+	uint32_t        seg;	/*所在段在segs中的下标*/
+	uint32_t        len;	/*记录长度*/
+	uint64_t        off;
+};
 
-	int             fd_entries;
-	int             fd_state;
+/*
+ * 记录在文件中的格式:帧头,数据;写了一半的记录由长度和校验识别.
+ * 复用的段中残留的旧记录seg_iid不同,重启前写了一半之后残留的记录gen较小,扫描到即停止.
+ */
+struct default_frame
+{
+	uint32_t                len;	/*整条记录的长度*/
+	uint32_t                crc;	/*len,seg_iid,gen,head和数据的crc32c*/
+	iid_t                   seg_iid;	/*所在段的first_iid*/
+	uint32_t                gen;	/*写入时的打开代数*/
+	struct eraft_entry      head;
 };
 
+/*事务内待写入的记录,数据在tx_commit前由调用者保持有效*/
+struct default_record
+{
+	struct default_frame    frame;
+	void                    *data;
+};
+
+/*io_uring异步提交的一批记录,按提交顺序完成*/
+struct default_async
+{
+	struct default_eraft_journal    *s;
+	struct default_async            *next;
+	bool                            done;
+	int                             result;
+	size_t                          entries;
+	struct default_record           *records;
+	struct iovec                    *iov;
+	void                            *buf;	/*O_DIRECT时的对齐缓冲区*/
+	struct eraft_iouring_op         *ops;
+	ERAFT_JOURNAL_COMMIT_FCB        fcb;
+	void                            *usr;
+};
+
+/*一次写入的位置和内容*/
+struct default_pack
+{
+	int             fd;
+	struct iovec    *iov;
+	int             iovcnt;
+	uint64_t        off;	/*写入位置,O_DIRECT时按块对齐*/
+	uint64_t        start;	/*第一条记录的位置*/
+	void            *buf;
+};
+
+struct default_state
+{
+	char    key[DEFAULT_STATE_KEY_LEN];
+	size_t  klen;
+	char    val[DEFAULT_STATE_VAL_LEN];
+	size_t  vlen;
+};
+
+struct default_eraft_journal
+{
+	int                     acceptor_id;
+	char                    *db_path;
+	uint64_t                db_size;
+
+	char                    *dir_path;	/*段文件所在目录*/
+	uint64_t                seg_size;
+	struct default_segment  *segs;
+	int                     nsegs;
+	int                     segs_cap;
+	/*清理掉的段改名为spare留作复用,新段不必再分配磁盘空间*/
+	struct
+	{
+		iid_t           *names;
+		int             count;
+		int             cap;
+	}                       spare;
+
+	/*O_DIRECT写入按块对齐,每次从新的块开始,已落盘的块不再重写*/
+	bool                    direct;
+
+	/*只有日志线程写入,get可在其它线程调用,索引和段数组的变动需加写锁*/
+	pthread_rwlock_t        rwlock;
+	struct default_index    *index;		/*index[iid - first_iid]*/
+	iid_t                   first_iid;
+	size_t                  count;
+	size_t                  index_cap;
+	size_t                  inflight;	/*已加入索引,异步写入未完成的条数*/
+	iid_t                   trim_iid;	/*已清理到的iid,之前的记录不再需要*/
+	uint32_t                gen;		/*每次打开加一并持久化,写入的记录带上此值*/
+
+	/*一个事务的记录合并为一次pwritev,tx_commit时一次fdatasync*/
+	struct
+	{
+		struct default_record   *records;
+		int                     count;
+		int                     cap;
+		uint64_t                bytes;
+		struct iovec            *iov;
+		int                     iov_cap;
+		iid_t                   begin_iid;	/*事务开始时的下一条iid*/
+		int                     sync_seg;	/*需要fdatasync的第一个段*/
+		bool                    sync_dir;	/*新建了段文件,需要同步目录*/
+	}                       txn;
+
+	/*为空时同步写入*/
+	struct eraft_iouring    *ring;
+	pthread_mutex_t         async_lock;
+	pthread_cond_t          async_cond;
+	struct default_async    *async_head;
+	struct default_async    *async_tail;
+
+	int                     fd_state;
+	struct default_state    states[DEFAULT_STATE_MAX];
+	int                     nstates;
+};
+
+static struct eraft_iouring     *g_iouring = NULL;
+static pthread_once_t           g_iouring_once = PTHREAD_ONCE_INIT;
+
+#define ALIGN_DOWN_BLOCK(x)     ((x) / DEFAULT_JOURNAL_BLOCK_SIZE * DEFAULT_JOURNAL_BLOCK_SIZE)
+
+static char *__segment_path(struct default_eraft_journal *s, iid_t first_iid)
+{
+	size_t  path_length = strlen(s->dir_path) + 32;
+	char    *path = malloc(path_length);
+
+	snprintf(path, path_length, "%s/%010u.wal", s->dir_path, first_iid);
+	return path;
+}
+
+static char *__spare_path(struct default_eraft_journal *s, iid_t name)
+{
+	size_t  path_length = strlen(s->dir_path) + 32;
+	char    *path = malloc(path_length);
+
+	snprintf(path, path_length, "%s/%010u.spare", s->dir_path, name);
+	return path;
+}
+
+static int __pread_full(int fd, void *buf, size_t len, uint64_t off)
+{
+	while (len) {
+		ssize_t rbyte = pread(fd, buf, len, off);
+
+		if (rbyte < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return -1;
+		}
+
+		if (rbyte == 0) {
+			return -1;
+		}
+
+		buf = (char *)buf + rbyte;
+		len -= rbyte;
+		off += rbyte;
+	}
+
+	return 0;
+}
+
+static int __pwritev_full(int fd, struct iovec *wiov, int wcnt, uint64_t off)
+{
+	while (wcnt) {
+		ssize_t wbyte = pwritev(fd, wiov, MIN(wcnt, IOV_MAX), off);
+
+		if (wbyte < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return -1;
+		}
+
+		off += wbyte;
+
+		while (wcnt && ((size_t)wbyte >= wiov->iov_len)) {
+			wbyte -= wiov->iov_len;
+			wiov++;
+			wcnt--;
+		}
+
+		if (wcnt) {
+			wiov->iov_base = (char *)wiov->iov_base + wbyte;
+			wiov->iov_len -= wbyte;
+		}
+	}
+
+	return 0;
+}
+
+static uint32_t __record_crc(struct default_frame *frame, const void *data)
+{
+	uint32_t crc = eraft_crc32c(0, &frame->len, sizeof(frame->len));
+
+	crc = eraft_crc32c(crc, &frame->seg_iid, sizeof(frame->seg_iid));
+	crc = eraft_crc32c(crc, &frame->gen, sizeof(frame->gen));
+	crc = eraft_crc32c(crc, &frame->head, sizeof(frame->head));
+	return eraft_crc32c(crc, data, frame->head.entry.data.len);
+}
+
+/*帧头是否是期望的记录,不检查校验*/
+static bool __frame_match(struct default_frame *frame, iid_t iid)
+{
+	return (frame->head.iid == iid) && (frame->len == sizeof(*frame) + (uint64_t)frame->head.entry.data.len);
+}
+
+/*读取一条记录,与索引不符或校验失败时返回-1*/
+static int __record_read(int fd, uint64_t off, uint32_t len, iid_t iid, struct eraft_entry *eentry)
+{
+	struct default_frame frame;
+
+	if ((len < sizeof(frame)) || (__pread_full(fd, &frame, sizeof(frame), off) != 0)) {
+		return -1;
+	}
+
+	if (!__frame_match(&frame, iid) || (frame.len != len)) {
+		return -1;
+	}
+
+	void *data = malloc(frame.head.entry.data.len);
+
+	if ((__pread_full(fd, data, frame.head.entry.data.len, off + sizeof(frame)) != 0) || (__record_crc(&frame, data) != frame.crc)) {
+		free(data);
+		return -1;
+	}
+
+	*eentry = frame.head;
+	eentry->entry.data.buf = data;
+	return 0;
+}
+
+static struct default_segment *__segment_push(struct default_eraft_journal *s, iid_t first_iid, int fd, int dfd, uint64_t size)
+{
+	if (s->nsegs == s->segs_cap) {
+		s->segs_cap = s->segs_cap ? s->segs_cap * 2 : 8;
+		s->segs = realloc(s->segs, s->segs_cap * sizeof(struct default_segment));
+	}
+
+	struct default_segment *seg = &s->segs[s->nsegs++];
+	seg->first_iid = first_iid;
+	seg->fd = fd;
+	seg->dfd = dfd;
+	seg->size = size;
+	return seg;
+}
+
+/*打开O_DIRECT写入的fd,文件系统不支持时关闭O_DIRECT*/
+static int __segment_open_direct(struct default_eraft_journal *s, char *path)
+{
+	if (!s->direct) {
+		return -1;
+	}
+
+	int dfd = open(path, O_WRONLY | O_DIRECT);
+
+	if (dfd < 0) {
+		printf("journal %s does not support O_DIRECT: %s\n", s->dir_path, strerror(errno));
+		s->direct = false;
+	}
+
+	return dfd;
+}
+
+static void __segment_close(struct default_segment *seg)
+{
+	close(seg->fd);
+
+	if (seg->dfd >= 0) {
+		close(seg->dfd);
+	}
+}
+
+/*将[off, off + len)清零,预分配的段不能用ftruncate截断,文件系统不支持时写入零*/
+static int __segment_zero(int fd, uint64_t off, uint64_t len)
+{
+	if (len == 0) {
+		return 0;
+	}
+
+	if (fallocate(fd, FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE, off, len) == 0) {
+		return 0;
+	}
+
+	static const char       zeros[DEFAULT_JOURNAL_BLOCK_SIZE];
+	struct iovec            iov[IOV_MAX];
+
+	while (len) {
+		int             cnt = 0;
+		uint64_t        size = 0;
+
+		while ((cnt < IOV_MAX) && (size < len)) {
+			iov[cnt].iov_base = (void *)zeros;
+			iov[cnt].iov_len = MIN(len - size, sizeof(zeros));
+			size += iov[cnt++].iov_len;
+		}
+
+		if (__pwritev_full(fd, iov, cnt, off) != 0) {
+			return -1;
+		}
+
+		off += size;
+		len -= size;
+	}
+
+	return 0;
+}
+
+static struct default_segment *__segment_create(struct default_eraft_journal *s, iid_t first_iid)
+{
+	char    *path = __segment_path(s, first_iid);
+	int     fd = -1;
+
+	/*优先复用已清理的段,其中旧记录的seg_iid不同,扫描时不会被误认*/
+	while ((fd < 0) && s->spare.count) {
+		char *spare = __spare_path(s, s->spare.names[--s->spare.count]);
+
+		if (rename(spare, path) == 0) {
+			fd = open(path, O_RDWR);
+		} else {
+			unlink(spare);
+		}
+
+		free(spare);
+	}
+
+	if (fd < 0) {
+		fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+
+		/*预分配后写入不再改变文件大小,fdatasync只需同步数据块*/
+		if ((fd >= 0) && (fallocate(fd, 0, 0, s->seg_size) != 0)) {
+			printf("journal %s fallocate failed: %s\n", s->dir_path, strerror(errno));
+		}
+	}
+
+	if (unlikely(fd < 0)) {
+		free(path);
+		return NULL;
+	}
+
+	int dfd = __segment_open_direct(s, path);
+	free(path);
+
+	return __segment_push(s, first_iid, fd, dfd, 0);
+}
+
+static void __segment_unlink(struct default_eraft_journal *s, struct default_segment *seg)
+{
+	char *path = __segment_path(s, seg->first_iid);
+
+	__segment_close(seg);
+	unlink(path);
+	free(path);
+}
+
+/*只用于已清理的段,截断的段可能含有iid更大的旧日志,不能复用*/
+static void __segment_recycle(struct default_eraft_journal *s, struct default_segment *seg)
+{
+	if (s->spare.count >= DEFAULT_JOURNAL_SPARE_SEGMENTS) {
+		__segment_unlink(s, seg);
+		return;
+	}
+
+	char    *path = __segment_path(s, seg->first_iid);
+	char    *spare = __spare_path(s, seg->first_iid);
+
+	/*不清零,旧记录由seg_iid区分*/
+	__segment_close(seg);
+
+	if (rename(path, spare) == 0) {
+		if (s->spare.count == s->spare.cap) {
+			s->spare.cap = s->spare.cap ? s->spare.cap * 2 : DEFAULT_JOURNAL_SPARE_SEGMENTS;
+			s->spare.names = realloc(s->spare.names, s->spare.cap * sizeof(iid_t));
+		}
+
+		s->spare.names[s->spare.count++] = seg->first_iid;
+	} else {
+		unlink(path);
+	}
+
+	free(path);
+	free(spare);
+}
+
+static void __index_push(struct default_eraft_journal *s, iid_t iid, uint32_t seg, uint64_t off, uint32_t len)
+{
+	if (s->count == 0) {
+		s->first_iid = iid;
+	}
+
+	if (s->count == s->index_cap) {
+		s->index_cap = s->index_cap ? s->index_cap * 2 : 1024;
+		s->index = realloc(s->index, s->index_cap * sizeof(struct default_index));
+	}
+
+	struct default_index *at = &s->index[s->count++];
+	at->seg = seg;
+	at->off = off;
+	at->len = len;
+}
+
+/*丢弃iid及之后的记录,需持有写锁*/
+static void __truncate_from(struct default_eraft_journal *s, iid_t iid)
+{
+	if ((s->count == 0) || (iid >= s->first_iid + s->count)) {
+		return;
+	}
+
+	if (iid <= s->first_iid) {
+		s->count = 0;
+
+		while (s->nsegs) {
+			__segment_unlink(s, &s->segs[--s->nsegs]);
+		}
+
+		return;
+	}
+
+	struct default_index *at = &s->index[iid - s->first_iid];
+
+	while (s->nsegs > at->seg + 1) {
+		__segment_unlink(s, &s->segs[--s->nsegs]);
+	}
+
+	struct default_segment *seg = &s->segs[at->seg];
+
+	/*清零而不是截断,保留预分配的空间,也避免重启时扫描到被覆盖的日志*/
+	if ((__segment_zero(seg->fd, at->off, seg->size - at->off) != 0) || (fdatasync(seg->fd) != 0)) {
+		printf("journal %s could not zero from iid: %d\n", s->dir_path, iid);
+	}
+
+	seg->size = at->off;
+
+	s->count = iid - s->first_iid;
+}
+
+/*
+ * 扫描一个段重建索引,返回最后一条有效记录的结尾.
+ * 之后的内容是写了一半的记录或复用前的旧记录,不再清零,重新写入的记录gen更大.
+ */
+static uint64_t __segment_scan(struct default_eraft_journal *s, struct default_segment *seg, uint64_t file_size)
+{
+	uint32_t        segno = seg - s->segs;
+	uint64_t        off = 0;
+	uint64_t        end = 0;
+	iid_t           expect = seg->first_iid;
+	uint32_t        gen = 0;
+
+	if (file_size == 0) {
+		return 0;
+	}
+
+	char *map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, seg->fd, 0);
+
+	if (map == MAP_FAILED) {
+		printf("journal segment %s/%010u.wal mmap failed: %s\n", s->dir_path, seg->first_iid, strerror(errno));
+		return 0;
+	}
+
+	madvise(map, file_size, MADV_SEQUENTIAL);
+
+	while (off + sizeof(struct default_frame) <= file_size) {
+		struct default_frame frame;
+
+		memcpy(&frame, map + off, sizeof(frame));
+
+		if (__frame_match(&frame, expect) && (frame.seg_iid == seg->first_iid) && (frame.gen >= gen) &&
+			(off + frame.len <= file_size) && (__record_crc(&frame, map + off + sizeof(frame)) == frame.crc)) {
+			__index_push(s, expect, segno, off, frame.len);
+			off += frame.len;
+			end = off;
+			expect++;
+			gen = frame.gen;
+			continue;
+		}
+
+		/*O_DIRECT写入时补零的块尾*/
+		uint64_t        block_end = MIN(ADJUST_SIZE(off + 1, DEFAULT_JOURNAL_BLOCK_SIZE), file_size);
+		uint64_t        i = off;
+
+		while ((i < block_end) && !map[i]) {
+			i++;
+		}
+
+		if ((off % DEFAULT_JOURNAL_BLOCK_SIZE) && (i == block_end)) {
+			off = block_end;
+			continue;
+		}
+
+		break;
+	}
+
+	munmap(map, file_size);
+	return end;
+}
+
+static int __segment_cmp(const void *a, const void *b)
+{
+	iid_t   x = *(const iid_t *)a;
+	iid_t   y = *(const iid_t *)b;
+
+	return (x > y) - (x < y);
+}
+
 static void __load_db(struct default_eraft_journal *s, char *db_path, int db_size)
-{}
+{
+	free(s->dir_path);
+	s->dir_path = strdup(db_path);
+	s->seg_size = DEFAULT_JOURNAL_SEGMENT_SIZE;
+	s->nsegs = 0;
+	s->count = 0;
+	s->spare.count = 0;
+
+	mkdir(db_path, 0755);
+	DIR *dir = opendir(db_path);
+
+	if (!dir) {
+		return;
+	}
+
+	/*按iid排序段文件*/
+	iid_t   *names = NULL;
+	int     nnames = 0;
+	int     cap = 0;
+
+	struct dirent *ent;
+
+	while ((ent = readdir(dir)) != NULL) {
+		iid_t   first_iid;
+		char    tail[8];
+
+		if (sscanf(ent->d_name, "%10u.%7s", &first_iid, tail) != 2) {
+			continue;
+		}
+
+		if (strcmp(tail, "spare") == 0) {
+			if (s->spare.count == s->spare.cap) {
+				s->spare.cap = s->spare.cap ? s->spare.cap * 2 : DEFAULT_JOURNAL_SPARE_SEGMENTS;
+				s->spare.names = realloc(s->spare.names, s->spare.cap * sizeof(iid_t));
+			}
+
+			s->spare.names[s->spare.count++] = first_iid;
+			continue;
+		}
+
+		if (strcmp(tail, "wal") != 0) {
+			continue;
+		}
+
+		if (nnames == cap) {
+			cap = cap ? cap * 2 : 16;
+			names = realloc(names, cap * sizeof(iid_t));
+		}
+
+		names[nnames++] = first_iid;
+	}
+
+	closedir(dir);
+	qsort(names, nnames, sizeof(iid_t), __segment_cmp);
+
+	bool            broken = false;
+	struct timespec start, stop;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < nnames; i++) {
+		char *path = __segment_path(s, names[i]);
+
+		/*前面的段不完整或iid不连续,之后的段都丢弃*/
+		if (broken || (s->count && (names[i] != s->first_iid + s->count))) {
+			broken = true;
+			unlink(path);
+			free(path);
+			continue;
+		}
+
+		int fd = open(path, O_RDWR, 0644);
+
+		struct stat st;
+
+		if ((fd < 0) || (fstat(fd, &st) != 0)) {
+			if (fd >= 0) {
+				close(fd);
+			}
+
+			free(path);
+			broken = true;
+			continue;
+		}
+
+		int dfd = __segment_open_direct(s, path);
+		free(path);
+
+		struct default_segment  *seg = __segment_push(s, names[i], fd, dfd, 0);
+		uint64_t                size = __segment_scan(s, seg, st.st_size);
+
+		seg->size = size;
+	}
+
+	free(names);
+
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	printf("journal %s recovered %lu entries from %d segments in %ld usec\n",
+		s->dir_path, (unsigned long)s->count, s->nsegs,
+		(stop.tv_sec - start.tv_sec) * 1000000L + (stop.tv_nsec - start.tv_nsec) / 1000);
+}
 
 static void __drop_db(struct default_eraft_journal *s)
 {
-	/*获取存储路径*/
-	size_t  db_env_path_length = strlen(s->db_path) + 16;
-	char    *db_env_path = malloc(db_env_path_length);
+	while (s->nsegs) {
+		__segment_unlink(s, &s->segs[--s->nsegs]);
+	}
+
+	while (s->spare.count) {
+		char *spare = __spare_path(s, s->spare.names[--s->spare.count]);
+		unlink(spare);
+		free(spare);
+	}
+
+	s->count = 0;
+	rmdir(s->dir_path);
+}
+
+/*丢弃一个*/
+static void _default_drop(char *dbpath, int dbsize)
+{
+	struct default_eraft_journal s;
+
+	memset(&s, 0, sizeof(s));
+
+	/*加载存储*/
+	__load_db(&s, dbpath, dbsize);
+	__drop_db(&s);
+
+	free(s.dir_path);
+	free(s.segs);
+	free(s.index);
+	free(s.spare.names);
+}
+
+/*加载一个*/
+static int _default_load(struct default_eraft_journal *s, char *dbpath, int dbsize)
+{
+	/*加载存储*/
+	__load_db(s, dbpath, dbsize);
+	return 0;
+}
+
+/*重建一个*/
+static int _default_make(struct default_eraft_journal *s, char *dbpath, int dbsize)
+{
+	_default_drop(dbpath, dbsize);
+	return _default_load(s, dbpath, dbsize);
+}
+
+/*读取状态文件,同一个key以最后写入的为准*/
+static void __load_state(struct default_eraft_journal *s)
+{
+	struct stat st;
+
+	s->nstates = 0;
+
+	if ((fstat(s->fd_state, &st) != 0) || (st.st_size == 0)) {
+		return;
+	}
+
+	char            *data = malloc(st.st_size);
+	uint64_t        off = 0;
+
+	if (__pread_full(s->fd_state, data, st.st_size, 0) == 0) {
+		while (off + 2 * sizeof(uint32_t) <= (uint64_t)st.st_size) {
+			uint32_t        klen = ((uint32_t *)(data + off))[0];
+			uint32_t        vlen = ((uint32_t *)(data + off))[1];
+			char            *key = data + off + 2 * sizeof(uint32_t);
+
+			if ((klen > DEFAULT_STATE_KEY_LEN) || (vlen > DEFAULT_STATE_VAL_LEN) ||
+				(off + 2 * sizeof(uint32_t) + klen + vlen > (uint64_t)st.st_size)) {
+				break;
+			}
+
+			int i = 0;
+
+			while ((i < s->nstates) && ((s->states[i].klen != klen) || memcmp(s->states[i].key, key, klen))) {
+				i++;
+			}
+
+			if (i == s->nstates) {
+				if (s->nstates == DEFAULT_STATE_MAX) {
+					break;
+				}
+
+				s->nstates++;
+			}
+
+			memcpy(s->states[i].key, key, klen);
+			s->states[i].klen = klen;
+			memcpy(s->states[i].val, key + klen, vlen);
+			s->states[i].vlen = vlen;
+
+			off += 2 * sizeof(uint32_t) + klen + vlen;
+		}
+	}
+
+	free(data);
+}
+
+/*等待异步写入全部完成,截断日志前调用*/
+static void __async_drain(struct default_eraft_journal *s)
+{
+	pthread_mutex_lock(&s->async_lock);
+
+	while (s->async_head) {
+		pthread_cond_wait(&s->async_cond, &s->async_lock);
+	}
+
+	pthread_mutex_unlock(&s->async_lock);
+}
+
+/*
+ * 丢弃前drop条记录的索引,全部在其中的段复用.
+ * 最后一段仍在写入,即使全部清理也保留.
+ */
+static void __trim_head(struct default_eraft_journal *s, size_t drop)
+{
+	uint32_t keep = (drop < s->count) ? s->index[drop].seg : (uint32_t)(s->nsegs - 1);
+
+	/*异步的fdatasync可能还在使用旧段*/
+	if (keep) {
+		__async_drain(s);
+	}
+
+	struct default_segment *olds = NULL;
+
+	pthread_rwlock_wrlock(&s->rwlock);
+
+	if (keep) {
+		olds = malloc(keep * sizeof(struct default_segment));
+		memcpy(olds, s->segs, keep * sizeof(struct default_segment));
+		memmove(s->segs, s->segs + keep, (s->nsegs - keep) * sizeof(struct default_segment));
+		s->nsegs -= keep;
+	}
+
+	memmove(s->index, s->index + drop, (s->count - drop) * sizeof(struct default_index));
+	s->count -= drop;
+	s->first_iid += drop;
+
+	for (size_t i = 0; keep && (i < s->count); i++) {
+		s->index[i].seg -= keep;
+	}
+
+	pthread_rwlock_unlock(&s->rwlock);
 
-	snprintf(db_env_path, db_env_path_length, "%s_%d", s->db_path, s->acceptor_id);
-	unlink(db_env_path);
+	s->txn.sync_seg = MAX(s->txn.sync_seg - (int)keep, 0);
 
-	free(db_env_path);
+	/*清零较慢,不持有锁*/
+	for (uint32_t i = 0; i < keep; i++) {
+		__segment_recycle(s, &olds[i]);
+	}
+
+	free(olds);
 }
 
-/*丢弃一个*/
-static void _default_drop(char *dbpath, int dbsize)
+/*清理trim_iid及之前已落盘的记录*/
+static void __trim_apply(struct default_eraft_journal *s)
 {
-	struct default_eraft_journal s;
+	pthread_rwlock_rdlock(&s->rwlock);
+	size_t ready = s->count - s->inflight;
+	pthread_rwlock_unlock(&s->rwlock);
 
-	/*加载存储*/
-	__load_db(&s, dbpath, dbsize);
-	__drop_db(&s);
-}
+	if ((ready == 0) || (s->trim_iid < s->first_iid)) {
+		return;
+	}
 
-/*加载一个*/
-static int _default_load(struct default_eraft_journal *s, char *dbpath, int dbsize)
-{
-	/*加载存储*/
-	__load_db(s, dbpath, dbsize);
-	return 0;
+	__trim_head(s, MIN(s->trim_iid - s->first_iid + 1, ready));
 }
 
-/*重建一个*/
-static int _default_make(struct default_eraft_journal *s, char *dbpath, int dbsize)
-{
-	_default_drop(dbpath, dbsize);
-	return _default_load(s, dbpath, dbsize);
-}
+static int default_eraft_journal_get_state(void *handle, char *key, size_t klen, char *val, size_t vlen);
+static int default_eraft_journal_set_state(void *handle, char *key, size_t klen, char *val, size_t vlen);
 
 /************************************************************/
 
@@ -99,11 +866,11 @@ static int default_eraft_journal_open(void *handle)
 	/*加载原有数据*/
 	_default_load(s, db_env_path, s->db_size);
 
-	s->fd_entries = open(db_env_path, O_CREAT | O_APPEND | O_WRONLY | O_SYNC, 0644);
-
 	free(db_env_path);
 
-	if (unlikely(s->fd_entries < 0)) {
+	struct stat st;
+
+	if (unlikely((stat(s->dir_path, &st) != 0) || !S_ISDIR(st.st_mode))) {
 		return -1;
 	}
 
@@ -112,7 +879,8 @@ static int default_eraft_journal_open(void *handle)
 	char    *db_state_path = malloc(db_state_path_length);
 	snprintf(db_state_path, db_state_path_length, "%s_%d.s", s->db_path, s->acceptor_id);
 
-	s->fd_state = open(db_state_path, O_CREAT | O_RDWR | O_SYNC, 0644);	// TODO: fix to O_DIRECT
+	/*状态记录很小且写入很少,不使用O_DIRECT*/
+	s->fd_state = open(db_state_path, O_CREAT | O_RDWR | O_APPEND | O_SYNC, 0644);
 
 	free(db_state_path);
 
@@ -120,6 +888,27 @@ static int default_eraft_journal_open(void *handle)
 		return -1;
 	}
 
+	__load_state(s);
+
+	/*重启前已清理的记录重新丢弃*/
+	s->trim_iid = 0;
+	default_eraft_journal_get_state(s, DEFAULT_TRIM_KEY, sizeof(DEFAULT_TRIM_KEY), (char *)&s->trim_iid, sizeof(s->trim_iid));
+
+	if (s->count && (s->first_iid > s->trim_iid + 1)) {
+		s->trim_iid = s->first_iid - 1;
+	}
+
+	/*本次写入的记录gen大于重启前残留在段尾的记录*/
+	s->gen = 0;
+	default_eraft_journal_get_state(s, DEFAULT_GEN_KEY, sizeof(DEFAULT_GEN_KEY), (char *)&s->gen, sizeof(s->gen));
+	s->gen++;
+
+	if (default_eraft_journal_set_state(s, DEFAULT_GEN_KEY, sizeof(DEFAULT_GEN_KEY), (char *)&s->gen, sizeof(s->gen)) != 0) {
+		return -1;
+	}
+
+	__trim_apply(s);
+
 	return 0;
 }
 
@@ -127,307 +916,620 @@ static void default_eraft_journal_close(void *handle)
 {
 	struct default_eraft_journal *s = handle;
 
-	if (s->fd_entries) {
-		close(s->fd_entries);
+	__async_drain(s);
+
+	for (int i = 0; i < s->nsegs; i++) {
+		__segment_close(&s->segs[i]);
 	}
 
-	if (s->fd_state) {
+	s->nsegs = 0;
+	s->count = 0;
+
+	if (s->fd_state > 0) {
 		close(s->fd_state);
+		s->fd_state = -1;
 	}
 
 	printf("default eraft_journal closed successfully");
 }
 
-static void *default_eraft_journal_tx_begin(void *handle)
+/*
+ * 准备写入当前段的内容.
+ * 普通写入时头部和数据分开写入,数据不再复制;
+ * O_DIRECT时从下一个块边界开始复制到对齐的缓冲区,不足一块的部分补零.
+ * 最后一块中已确认的记录不会被重写,写入中断不影响它们,扫描时跳过补零的块尾.
+ */
+static void __txn_pack(struct default_eraft_journal *s, struct default_record *records, int count, uint64_t bytes, struct iovec *iov, struct default_pack *pack)
 {
-	// struct default_eraft_journal *s = handle;
-	return NULL;
-}
+	struct default_segment *seg = &s->segs[s->nsegs - 1];
 
-static int default_eraft_journal_tx_commit(void *handle, void *txn)
-{
-	// struct default_eraft_journal       *s = handle;
-	return 0;
-}
+	pack->iov = iov;
+	pack->buf = NULL;
 
-static void default_eraft_journal_tx_abort(void *handle, void *txn)
-{
-	// struct default_eraft_journal *s = handle;
-}
+	if (seg->dfd < 0) {
+		for (int i = 0; i < count; i++) {
+			iov[2 * i].iov_base = &records[i].frame;
+			iov[2 * i].iov_len = sizeof(struct default_frame);
+			iov[2 * i + 1].iov_base = records[i].data;
+			iov[2 * i + 1].iov_len = records[i].frame.head.entry.data.len;
+		}
 
-static int default_eraft_journal_get(void *handle, void *txn, iid_t iid, struct eraft_entry *eentry)
-{
-#if 0
-	struct default_eraft_journal *s = handle;
+		pack->fd = seg->fd;
+		pack->iovcnt = count * 2;
+		pack->off = pack->start = seg->size;
+		return;
+	}
 
-	size_t  vlen = 0;
-	char    *val = rdb_get(s->rdbs, (const char *)&iid, sizeof(iid_t), &vlen);
+	uint64_t        start = ADJUST_SIZE(seg->size, DEFAULT_JOURNAL_BLOCK_SIZE);
+	size_t          total = ADJUST_SIZE(bytes, DEFAULT_JOURNAL_BLOCK_SIZE);
+	char            *buf = NULL;
 
-	if (NULL == val) {
-		printf("There is no record for iid: %d", iid);
-		return 0;
+	int e = posix_memalign((void **)&buf, DEFAULT_JOURNAL_BLOCK_SIZE, total);
+	assert(e == 0);
+
+	char *ptr = buf;
+
+	for (int i = 0; i < count; i++) {
+		memcpy(ptr, &records[i].frame, sizeof(struct default_frame));
+		ptr += sizeof(struct default_frame);
+		memcpy(ptr, records[i].data, records[i].frame.head.entry.data.len);
+		ptr += records[i].frame.head.entry.data.len;
 	}
 
-	eraft_entry_decode(eentry, val, vlen);
-	assert(iid == eentry->iid);
+	memset(ptr, 0, buf + total - ptr);
 
-	default_free(val);
-#endif
+	iov[0].iov_base = buf;
+	iov[0].iov_len = total;
 
-	return 1;
+	pack->fd = seg->dfd;
+	pack->iovcnt = 1;
+	pack->off = start;
+	pack->start = start;
+	pack->buf = buf;
 }
 
-static int default_eraft_journal_set(void *handle, void *txn, iid_t iid, struct eraft_entry *eentry)
+/*按写入位置把记录加入索引,需持有写锁*/
+static void __txn_index(struct default_eraft_journal *s, struct default_record *records, int count, struct default_pack *pack)
 {
-	struct default_eraft_journal *s = handle;
+	struct default_segment *seg = &s->segs[s->nsegs - 1];
+
+	seg->size = pack->start;
+
+	for (int i = 0; i < count; i++) {
+		__index_push(s, records[i].frame.head.iid, s->nsegs - 1, seg->size, records[i].frame.len);
+		seg->size += records[i].frame.len;
+	}
+}
 
-	size_t  len = eraft_entry_cubage(eentry);
-	char    *buf = malloc(len);
+/*将事务内的记录一次写入当前段并更新索引*/
+static int __txn_flush(struct default_eraft_journal *s)
+{
+	if (s->txn.count == 0) {
+		return 0;
+	}
 
-	eraft_journal_encode(eentry, buf, len);
+	if (s->txn.iov_cap < s->txn.count * 2) {
+		s->txn.iov_cap = s->txn.count * 2;
+		s->txn.iov = realloc(s->txn.iov, s->txn.iov_cap * sizeof(struct iovec));
+	}
 
-	char    *wdata = buf;
-	size_t  wsize = len;
+	struct default_pack pack;
 
-	while (wsize) {
-		ssize_t wbyte = write(s->fd_entries, wdata, wsize);
+	__txn_pack(s, s->txn.records, s->txn.count, s->txn.bytes, s->txn.iov, &pack);
 
-		if (wbyte < 0) {
-			printf("There is no space for iid: %d?", iid);
-			free(buf);
-			return 0;
-		} else {
-			wdata += wbyte;
-			wsize -= wbyte;
-		}
+	int e = __pwritev_full(pack.fd, pack.iov, pack.iovcnt, pack.off);
+
+	free(pack.buf);
+
+	if (e != 0) {
+		printf("There is no space for iid: %d?", s->txn.records[0].frame.head.iid);
+		s->txn.count = 0;
+		s->txn.bytes = 0;
+		return -1;
 	}
 
-	free(buf);
+	pthread_rwlock_wrlock(&s->rwlock);
+	__txn_index(s, s->txn.records, s->txn.count, &pack);
+	pthread_rwlock_unlock(&s->rwlock);
 
-	return 1;
+	s->txn.count = 0;
+	s->txn.bytes = 0;
+	return 0;
 }
 
-#if 0
-static iid_t
-default_eraft_journal_get_trim_instance(void *handle)
+/*按提交顺序回调,后提交的批次先完成时等待前面的批次*/
+static void __async_done(struct default_eraft_journal *s, struct default_async *async, int result)
 {
-	struct default_eraft_journal    *s = handle;
-	int                             result;
-	iid_t                           iid = 0, k = 0;
-	MDB_val                         key, data;
+	pthread_mutex_lock(&s->async_lock);
+	async->result = result;
+	async->done = true;
 
-	key.mv_data = &k;
-	key.mv_size = sizeof(iid_t);
+	while (s->async_head && s->async_head->done) {
+		struct default_async *head = s->async_head;
+		s->async_head = head->next;
 
-	if ((result = mdb_get(txn, s->entries, &key, &data)) != 0) {
-		if (result != MDB_NOTFOUND) {
-			paxos_log_error("mdb_get failed: %s", mdb_strerror(result));
-			assert(result == 0);
-		} else {
-			iid = 0;
+		if (!s->async_head) {
+			s->async_tail = NULL;
 		}
-	} else {
-		iid = *(iid_t *)data.mv_data;
+
+		pthread_rwlock_wrlock(&s->rwlock);
+		s->inflight -= head->entries;
+		pthread_rwlock_unlock(&s->rwlock);
+
+		head->fcb(head->result, head->usr);
+
+		free(head->records);
+		free(head->iov);
+		free(head->buf);
+		free(head->ops);
+		free(head);
+	}
+
+	if (!s->async_head) {
+		pthread_cond_broadcast(&s->async_cond);
 	}
 
-	return iid;
+	pthread_mutex_unlock(&s->async_lock);
 }
 
-static int
-default_eraft_journal_put_trim_instance(void *handle, iid_t iid)
+static void __async_ring_fcb(int result, void *usr)
 {
-	struct default_eraft_journal    *s = handle;
-	iid_t                           k = 0;
-	int                             result;
-	MDB_val                         key, data;
+	struct default_async *async = usr;
+
+	__async_done(async->s, async, result);
+}
+
+static void *default_eraft_journal_tx_begin(void *handle)
+{
+	struct default_eraft_journal *s = handle;
 
-	key.mv_data = &k;
-	key.mv_size = sizeof(iid_t);
+	s->txn.count = 0;
+	s->txn.bytes = 0;
+	s->txn.begin_iid = s->first_iid + s->count;
+	s->txn.sync_seg = MAX(s->nsegs - 1, 0);
+	s->txn.sync_dir = false;
+	return &s->txn;
+}
 
-	data.mv_data = &iid;
-	data.mv_size = sizeof(iid_t);
+static int default_eraft_journal_tx_commit(void *handle, void *txn)
+{
+	struct default_eraft_journal *s = handle;
 
-	result = mdb_put(txn, s->entries, &key, &data, 0);
+	if (__txn_flush(s) != 0) {
+		return -1;
+	}
 
-	if (result != 0) {
-		paxos_log_error("%s\n", mdb_strerror(result));
+	for (int i = s->txn.sync_seg; i < s->nsegs; i++) {
+		if (fdatasync(s->segs[i].fd) != 0) {
+			return -1;
+		}
 	}
 
-	assert(result == 0);
+	if (s->txn.sync_dir) {
+		int fd = open(s->dir_path, O_RDONLY | O_DIRECTORY);
+
+		if (fd >= 0) {
+			fsync(fd);
+			close(fd);
+		}
+	}
 
+	s->txn.sync_seg = MAX(s->nsegs - 1, 0);
+	s->txn.sync_dir = false;
 	return 0;
 }
 
-static int
-default_eraft_journal_trim(void *handle, iid_t iid)
+/*一次提交事务内所有段的写入和fdatasync,完成后在io_uring完成线程中回调*/
+static int default_eraft_journal_tx_commit_async(void *handle, void *txn, ERAFT_JOURNAL_COMMIT_FCB fcb, void *usr)
 {
-	struct default_eraft_journal    *s = handle;
-	int                             result;
-	iid_t                           min = 0;
-	MDB_cursor                      *cursor = NULL;
-	MDB_val                         key, data;
+	struct default_eraft_journal *s = handle;
 
-	if (iid == 0) {
+	if (!s->ring || (s->nsegs == 0)) {
+		int e = default_eraft_journal_tx_commit(s, txn);
+		fcb(e, usr);
 		return 0;
 	}
 
-	default_eraft_journal_put_trim_instance(handle, iid);
+	/*新建段文件很少见,目录同步直接完成*/
+	if (s->txn.sync_dir) {
+		int fd = open(s->dir_path, O_RDONLY | O_DIRECTORY);
 
-	if ((result = mdb_cursor_open(txn, s->entries, &cursor)) != 0) {
-		paxos_log_error("Could not create cursor. %s", mdb_strerror(result));
-		goto cleanup_exit;
+		if (fd >= 0) {
+			fsync(fd);
+			close(fd);
+		}
+
+		s->txn.sync_dir = false;
 	}
 
-	key.mv_data = &min;
-	key.mv_size = sizeof(iid_t);
+	struct default_async    *async = calloc(1, sizeof(*async));
+	int                     nops = s->nsegs - s->txn.sync_seg;
+	int                     count = s->txn.count;
+	uint64_t                bytes = s->txn.bytes;
+
+	async->s = s;
+	async->fcb = fcb;
+	async->usr = usr;
+	async->entries = count;
+	async->ops = calloc(nops, sizeof(struct eraft_iouring_op));
+
+	/*记录交给异步请求,事务重新分配*/
+	async->records = s->txn.records;
+	s->txn.records = NULL;
+	s->txn.cap = 0;
+	s->txn.count = 0;
+	s->txn.bytes = 0;
+
+	/*先占用段内位置并加入索引,写入完成前get不可见*/
+	struct default_segment  *seg = &s->segs[s->nsegs - 1];
+	struct default_pack     pack;
+
+	for (int i = 0; i < nops - 1; i++) {
+		async->ops[i].fd = s->segs[s->txn.sync_seg + i].fd;
+		async->ops[i].sync = true;
+	}
 
-	do {
-		if ((result = mdb_cursor_get(cursor, &key, &data, MDB_NEXT)) == 0) {
-			assert(key.mv_size = sizeof(iid_t));
-			min = *(iid_t *)key.mv_data;
-		} else {
-			goto cleanup_exit;
-		}
+	async->ops[nops - 1].fd = seg->fd;
+	async->ops[nops - 1].sync = true;
+
+	if (count) {
+		async->iov = malloc(count * 2 * sizeof(struct iovec));
+		__txn_pack(s, async->records, count, bytes, async->iov, &pack);
+
+		async->buf = pack.buf;
+		async->ops[nops - 1].fd = pack.fd;
+		async->ops[nops - 1].iov = pack.iov;
+		async->ops[nops - 1].iovcnt = pack.iovcnt;
+		async->ops[nops - 1].off = pack.off;
+	}
+
+	pthread_rwlock_wrlock(&s->rwlock);
+
+	if (count) {
+		__txn_index(s, async->records, count, &pack);
+	}
+
+	s->inflight += count;
+	pthread_rwlock_unlock(&s->rwlock);
+
+	s->txn.sync_seg = s->nsegs - 1;
+
+	pthread_mutex_lock(&s->async_lock);
+
+	if (s->async_tail) {
+		s->async_tail->next = async;
+	} else {
+		s->async_head = async;
+	}
+
+	s->async_tail = async;
+	pthread_mutex_unlock(&s->async_lock);
+
+	if (eraft_iouring_submit(s->ring, async->ops, nops, __async_ring_fcb, async) != 0) {
+		/*提交失败时同步写入*/
+		int e = 0;
+
+		for (int i = 0; i < nops; i++) {
+			struct eraft_iouring_op *op = &async->ops[i];
 
-		if ((min != 0) && (min <= iid)) {
-			if (mdb_cursor_del(cursor, 0) != 0) {
-				paxos_log_error("mdb_cursor_del failed. %s",
-					mdb_strerror(result));
-				goto cleanup_exit;
+			if ((op->iovcnt && (__pwritev_full(op->fd, op->iov, op->iovcnt, op->off) != 0)) || (fdatasync(op->fd) != 0)) {
+				e = -1;
 			}
 		}
-	} while (min <= iid);
 
-cleanup_exit:
-
-	if (cursor) {
-		mdb_cursor_close(cursor);
+		__async_done(s, async, e);
 	}
 
 	return 0;
 }
 
-#endif	/* if 0 */
-
-static void __pop_newest_log(struct default_eraft_journal *s)
+static void default_eraft_journal_tx_abort(void *handle, void *txn)
 {
-#ifdef TEST_NETWORK_ONLY
-	return;
-#endif
-	// MDB_val k, v;
+	struct default_eraft_journal *s = handle;
 
-	// mdb_pop(s->db_env, s->entries, &k, &v);
+	/*丢弃未写入的记录,已写入的截掉*/
+	s->txn.count = 0;
+	s->txn.bytes = 0;
+
+	if (s->count && (s->first_iid + s->count > s->txn.begin_iid)) {
+		__async_drain(s);
+		pthread_rwlock_wrlock(&s->rwlock);
+		__truncate_from(s, s->txn.begin_iid);
+		pthread_rwlock_unlock(&s->rwlock);
+	}
 }
 
-static void __pop_oldest_log(struct default_eraft_journal *s)
+static int default_eraft_journal_get(void *handle, void *txn, iid_t iid, struct eraft_entry *eentry)
 {
-#ifdef TEST_NETWORK_ONLY
-	return;
-#endif
-	// MDB_val k, v;
+	struct default_eraft_journal *s = handle;
+
+	pthread_rwlock_rdlock(&s->rwlock);
+
+	if ((s->count == s->inflight) || (iid < s->first_iid) || (iid >= s->first_iid + s->count - s->inflight)) {
+		pthread_rwlock_unlock(&s->rwlock);
+		printf("There is no record for iid: %d", iid);
+		return 0;
+	}
+
+	struct default_index    *at = &s->index[iid - s->first_iid];
+	int                     e = __record_read(s->segs[at->seg].fd, at->off, at->len, iid, eentry);
+
+	pthread_rwlock_unlock(&s->rwlock);
+
+	if (e != 0) {
+		printf("Could not read record for iid: %d", iid);
+		return 0;
+	}
 
-	// mdb_poll(s->db_env, s->entries, &k, &v);
+	return 1;
 }
 
-typedef void (*ERAFT_DSTORE_LOAD_COMMIT_LOG_FCB)(struct eraft_journal *journal, raft_entry_t *entry, void *usr);
-/** Load all log entries we have persisted to disk */
-static int __load_foreach_append_log(struct default_eraft_journal *s, ERAFT_DSTORE_LOAD_COMMIT_LOG_FCB fcb, void *usr)
+static int default_eraft_journal_set(void *handle, void *txn, iid_t iid, struct eraft_entry *eentry)
 {
-	// TODO:消除不完成的数据
-#if 0
-	MDB_cursor      *curs;
-	MDB_txn         *txn;
-	MDB_val         k, v;
-	int             e;
-	int             n_entries = 0;
+	struct default_eraft_journal    *s = handle;
+	uint32_t                        len = sizeof(struct default_frame) + eentry->entry.data.len;
+	iid_t                           next = s->first_iid + s->count;
+
+	if (s->txn.count) {
+		next = s->txn.records[s->txn.count - 1].frame.head.iid + 1;
+	}
+
+	if ((s->count || s->txn.count) && (iid != next)) {
+		if (iid > next) {
+			printf("There is a gap before iid: %d", iid);
+			return 0;
+		}
+
+		/*覆盖冲突的日志*/
+		if (__txn_flush(s) != 0) {
+			return 0;
+		}
 
-	e = mdb_txn_begin(s->db_env, NULL, MDB_RDONLY, &txn);
+		__async_drain(s);
 
-	if (0 != e) {
-		mdb_fatal(e);
+		pthread_rwlock_wrlock(&s->rwlock);
+		__truncate_from(s, iid);
+		pthread_rwlock_unlock(&s->rwlock);
+		s->txn.sync_seg = MIN(s->txn.sync_seg, MAX(s->nsegs - 1, 0));
 	}
 
-	e = mdb_cursor_open(txn, s->entries, &curs);
+	struct default_segment  *seg = s->nsegs ? &s->segs[s->nsegs - 1] : NULL;
+	uint64_t                pending = s->txn.bytes;
+
+	/*记录已全部清理后不连续写入,旧段不再需要*/
+	if (seg && seg->size && (s->count == 0) && (pending == 0) && (iid != s->first_iid)) {
+		struct default_segment old = *seg;
 
-	if (0 != e) {
-		mdb_fatal(e);
+		__async_drain(s);
+		pthread_rwlock_wrlock(&s->rwlock);
+		s->nsegs--;
+		pthread_rwlock_unlock(&s->rwlock);
+		__segment_recycle(s, &old);
+		s->txn.sync_seg = MIN(s->txn.sync_seg, MAX(s->nsegs - 1, 0));
+		seg = NULL;
 	}
 
-	e = mdb_cursor_get(curs, &k, &v, MDB_FIRST);
-	switch (e)
-	{
-		case 0:
-			break;
+	/*空段的文件名须与第一条日志一致*/
+	if (seg && (seg->size == 0) && (pending == 0) && (seg->first_iid != iid)) {
+		pthread_rwlock_wrlock(&s->rwlock);
+		__segment_unlink(s, seg);
+		s->nsegs--;
+		pthread_rwlock_unlock(&s->rwlock);
+		seg = NULL;
+	}
+
+	/*O_DIRECT时从块边界开始写入并补齐到整块,不能超出预分配的大小*/
+	uint64_t need = seg ? seg->size + pending + len : 0;
+
+	if (seg && (seg->dfd >= 0)) {
+		need = ADJUST_SIZE(seg->size, DEFAULT_JOURNAL_BLOCK_SIZE) + ADJUST_SIZE(pending + len, DEFAULT_JOURNAL_BLOCK_SIZE);
+	}
 
-		case MDB_NOTFOUND:
+	if (!seg || ((seg->size + pending) && (need > s->seg_size))) {
+		/*换段前先写入当前段*/
+		if (__txn_flush(s) != 0) {
 			return 0;
+		}
+
+		pthread_rwlock_wrlock(&s->rwlock);
+		seg = __segment_create(s, iid);
+		pthread_rwlock_unlock(&s->rwlock);
+
+		if (unlikely(!seg)) {
+			printf("Could not create segment for iid: %d", iid);
+			return 0;
+		}
 
-		default:
-			mdb_fatal(e);
+		s->txn.sync_dir = true;
 	}
 
-	raft_entry_t ety;
-	ety.id = 0;
+	if (s->txn.count == s->txn.cap) {
+		s->txn.cap = s->txn.cap ? s->txn.cap * 2 : 64;
+		s->txn.records = realloc(s->txn.records, s->txn.cap * sizeof(struct default_record));
+	}
 
-	do {
-		if (!(*(int *)k.mv_data & 1)) {
-			/* entry metadata */
-			__deserialize(&ety, v.mv_data, v.mv_size);
-		} else {
-			/* entry data for FSM */
-			ety.data.buf = v.mv_data;
-			ety.data.len = v.mv_size;
+	struct default_record *record = &s->txn.records[s->txn.count++];
+	record->frame.len = len;
+	record->frame.seg_iid = seg->first_iid;
+	record->frame.gen = s->gen;
+	record->frame.head = *eentry;
+	record->frame.head.iid = iid;
+	record->frame.head.entry.data.buf = NULL;
+	record->frame.crc = __record_crc(&record->frame, eentry->entry.data.buf);
+	record->data = eentry->entry.data.buf;
+	s->txn.bytes += len;
+
+	/*不在事务中时立即落盘*/
+	if (!txn && (default_eraft_journal_tx_commit(s, NULL) != 0)) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/*段文件只读映射后直接指向记录数据,记录在open时已校验,不再逐条分配和复制*/
+static int default_eraft_journal_foreach(void *handle, iid_t iid, ERAFT_JOURNAL_FOREACH_FCB fcb, void *usr)
+{
+	struct default_eraft_journal    *s = handle;
+	int                             n_entries = 0;
+	char                            *map = NULL;
+	uint64_t                        map_size = 0;
+	uint32_t                        map_seg = 0;
+
+	pthread_rwlock_rdlock(&s->rwlock);
 
-			fcb(s, &ety, usr);
-			n_entries++;
+	for (size_t i = (iid > s->first_iid) ? iid - s->first_iid : 0; i < s->count; i++) {
+		struct default_index    *at = &s->index[i];
+		struct default_segment  *seg = &s->segs[at->seg];
+
+		if (!map || (map_seg != at->seg)) {
+			if (map) {
+				munmap(map, map_size);
+			}
+
+			map_seg = at->seg;
+			map_size = seg->size;
+			map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, seg->fd, 0);
+
+			if (map == MAP_FAILED) {
+				printf("journal segment %s/%010u.wal mmap failed: %s\n", s->dir_path, seg->first_iid, strerror(errno));
+				map = NULL;
+				break;
+			}
+
+			madvise(map, map_size, MADV_SEQUENTIAL);
 		}
 
-		e = mdb_cursor_get(curs, &k, &v, MDB_NEXT);
-	} while (0 == e);
+		struct default_frame *frame = (struct default_frame *)(map + at->off);
+
+		if ((at->off + at->len > map_size) || !__frame_match(frame, s->first_iid + i)) {
+			break;
+		}
 
-	mdb_cursor_close(curs);
+		struct eraft_entry eentry = frame->head;
+		eentry.entry.data.buf = map + at->off + sizeof(*frame);
 
-	e = mdb_txn_commit(txn);
+		fcb(s->first_iid + i, &eentry.entry, usr);
+		n_entries++;
+	}
 
-	if (0 != e) {
-		mdb_fatal(e);
+	if (map) {
+		munmap(map, map_size);
 	}
 
+	pthread_rwlock_unlock(&s->rwlock);
+
 	return n_entries;
-#else
-	return 0;
-#endif	/* if 0 */
 }
 
+/*状态以{klen, vlen, key, val}追加写入,加载时同一个key以最后一条为准*/
 static int default_eraft_journal_set_state(void *handle, char *key, size_t klen, char *val, size_t vlen)
 {
 #ifdef TEST_NETWORK_ONLY
 	return 0;
 #endif
-#if 0
 	struct default_eraft_journal *s = handle;
 
-	// FIXME:
-	ssize_t wbyte = write(s->fd_state, key, klen);
-
-	if (wbyte < 0) {
+	if ((klen > DEFAULT_STATE_KEY_LEN) || (vlen > DEFAULT_STATE_VAL_LEN)) {
 		return -1;
 	}
 
-	wbyte = write(s->fd_state, val, vlen);
+	int i = 0;
+
+	while ((i < s->nstates) && ((s->states[i].klen != klen) || memcmp(s->states[i].key, key, klen))) {
+		i++;
+	}
+
+	if (i == s->nstates) {
+		if (s->nstates == DEFAULT_STATE_MAX) {
+			return -1;
+		}
+
+		s->nstates++;
+	}
+
+	memcpy(s->states[i].key, key, klen);
+	s->states[i].klen = klen;
+	memcpy(s->states[i].val, val, vlen);
+	s->states[i].vlen = vlen;
 
-	if (wbyte < 0) {
+	uint32_t        lens[2] = { klen, vlen };
+	struct iovec    iov[3];
+	iov[0].iov_base = lens;
+	iov[0].iov_len = sizeof(lens);
+	iov[1].iov_base = key;
+	iov[1].iov_len = klen;
+	iov[2].iov_base = val;
+	iov[2].iov_len = vlen;
+
+	ssize_t wbyte = writev(s->fd_state, iov, 3);
+
+	if (wbyte != (ssize_t)(sizeof(lens) + klen + vlen)) {
 		return -1;
 	}
-#endif
 
 	return 0;
 }
 
 static int default_eraft_journal_get_state(void *handle, char *key, size_t klen, char *val, size_t vlen)
 {
-	// struct default_eraft_journal       *s = handle;
+	struct default_eraft_journal *s = handle;
+
+	for (int i = 0; i < s->nstates; i++) {
+		if ((s->states[i].klen == klen) && !memcmp(s->states[i].key, key, klen)) {
+			memcpy(val, s->states[i].val, MIN(vlen, s->states[i].vlen));
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static iid_t default_eraft_journal_get_trim_instance(void *handle)
+{
+	struct default_eraft_journal *s = handle;
+
+	return s->trim_iid;
+}
+
+/*先持久化清理位置再丢弃记录,中途重启时按清理位置重新丢弃*/
+static int default_eraft_journal_trim(void *handle, void *txn, iid_t iid)
+{
+	struct default_eraft_journal *s = handle;
+
+	if (iid <= s->trim_iid) {
+		return 0;
+	}
+
+	if (default_eraft_journal_set_state(s, DEFAULT_TRIM_KEY, sizeof(DEFAULT_TRIM_KEY), (char *)&iid, sizeof(iid)) != 0) {
+		printf("journal %s could not save trim iid: %d\n", s->dir_path, iid);
+		return -1;
+	}
+
+	s->trim_iid = iid;
+	__trim_apply(s);
+	return 0;
+}
+
+/*丢弃iid及之后的记录,用于覆盖与leader冲突的日志*/
+static int default_eraft_journal_pop(void *handle, void *txn, iid_t iid)
+{
+	struct default_eraft_journal *s = handle;
+
+	if (__txn_flush(s) != 0) {
+		return -1;
+	}
+
+	if ((s->count == 0) || (iid >= s->first_iid + s->count)) {
+		return 0;
+	}
 
+	__async_drain(s);
+
+	pthread_rwlock_wrlock(&s->rwlock);
+	__truncate_from(s, iid);
+	pthread_rwlock_unlock(&s->rwlock);
+	s->txn.sync_seg = MIN(s->txn.sync_seg, MAX(s->nsegs - 1, 0));
 	return 0;
 }
 
@@ -439,12 +1541,28 @@ static struct default_eraft_journal *default_eraft_journal_init(int acceptor_id,
 	h->acceptor_id = acceptor_id;
 	h->db_path = strdup(dbpath);
 	h->db_size = dbsize;
+	h->fd_state = -1;
+#ifdef USE_JOURNAL_DIRECT
+	h->direct = true;
+#endif
+	pthread_rwlock_init(&h->rwlock, NULL);
+	pthread_mutex_init(&h->async_lock, NULL);
+	pthread_cond_init(&h->async_cond, NULL);
 	return h;
 }
 
 static void default_eraft_journal_free(struct default_eraft_journal *h)
 {
+	pthread_rwlock_destroy(&h->rwlock);
+	pthread_mutex_destroy(&h->async_lock);
+	pthread_cond_destroy(&h->async_cond);
 	free(h->db_path);
+	free(h->dir_path);
+	free(h->segs);
+	free(h->index);
+	free(h->txn.records);
+	free(h->txn.iov);
+	free(h->spare.names);
 
 	free(h);
 }
@@ -460,8 +1578,10 @@ void eraft_journal_init_default(struct eraft_journal *j, int acceptor_id, char *
 	j->api.tx_abort = default_eraft_journal_tx_abort;
 	j->api.get = default_eraft_journal_get;
 	j->api.set = default_eraft_journal_set;
-	// j->api.trim = default_eraft_journal_trim;
-	// j->api.get_trim_instance = default_eraft_journal_get_trim_instance;
+	j->api.trim = default_eraft_journal_trim;
+	j->api.get_trim_instance = default_eraft_journal_get_trim_instance;
+	j->api.pop = default_eraft_journal_pop;
+	j->api.foreach = default_eraft_journal_foreach;
 
 	j->api.set_state = default_eraft_journal_set_state;
 	j->api.get_state = default_eraft_journal_get_state;
@@ -473,3 +1593,30 @@ void eraft_journal_free_default(struct eraft_journal *j)
 	j->handle = NULL;
 }
 
+
+static void __iouring_once(void)
+{
+	/*所有日志共用,进程退出时释放*/
+	g_iouring = eraft_iouring_make(DEFAULT_IOURING_ENTRIES);
+}
+
+void eraft_journal_init_iouring(struct eraft_journal *j, int acceptor_id, char *dbpath, uint64_t dbsize)
+{
+	eraft_journal_init_default(j, acceptor_id, dbpath, dbsize);
+
+	pthread_once(&g_iouring_once, __iouring_once);
+
+	struct default_eraft_journal *s = j->handle;
+	s->ring = g_iouring;
+
+	if (!s->ring) {
+		printf("io_uring journal falls back to synchronous writes\n");
+	}
+
+	j->api.tx_commit_async = default_eraft_journal_tx_commit_async;
+}
+
+void eraft_journal_free_iouring(struct eraft_journal *j)
+{
+	eraft_journal_free_default(j);
+}
@@ -22,6 +22,10 @@ ERAFT_JOURNAL_IMPL_INIT eraft_journal_mapping_init(enum ERAFT_JOURNAL_TYPE type)
 			finit = eraft_journal_init_bdb;
 			break;
 
+		case ERAFT_JOURNAL_TYPE_IOURING:
+			finit = eraft_journal_init_iouring;
+			break;
+
 		default:
 			abort();
 	}
@@ -50,6 +54,10 @@ ERAFT_JOURNAL_IMPL_FREE eraft_journal_mapping_free(enum ERAFT_JOURNAL_TYPE type)
 			ffree = eraft_journal_free_bdb;
 			break;
 
+		case ERAFT_JOURNAL_TYPE_IOURING:
+			ffree = eraft_journal_free_iouring;
+			break;
+
 		default:
 			abort();
 	}
@@ -11,7 +11,8 @@ enum ERAFT_JOURNAL_TYPE
 	ERAFT_JOURNAL_TYPE_DEFAULT = 0,
 	ERAFT_JOURNAL_TYPE_LMDB = 1,
 	ERAFT_JOURNAL_TYPE_ROCKSDB = 2,
-	ERAFT_JOURNAL_TYPE_BDB = 3
+	ERAFT_JOURNAL_TYPE_BDB = 3,
+	ERAFT_JOURNAL_TYPE_IOURING = 4	/*默认存储的格式,通过io_uring异步落盘,不可用时退回同步写入*/
 };
 
 ERAFT_JOURNAL_IMPL_INIT eraft_journal_mapping_init(enum ERAFT_JOURNAL_TYPE type);
@@ -34,3 +35,7 @@ void eraft_journal_init_bdb(struct eraft_journal *j, int acceptor_id, char *dbpa
 
 void eraft_journal_free_bdb(struct eraft_journal *j);
 
+void eraft_journal_init_iouring(struct eraft_journal *j, int acceptor_id, char *dbpath, uint64_t dbsize);
+
+void eraft_journal_free_iouring(struct eraft_journal *j);
+
@@ -203,23 +203,23 @@ static int lmdb_eraft_journal_set(void *handle, void *txn, iid_t iid, struct era
 {
 	struct lmdb_eraft_journal *s = handle;
 
-	size_t  len = eraft_entry_cubage(eentry);
-	char    *buf = malloc(len);
-
-	eraft_journal_encode(eentry, buf, len);
+	size_t len = eraft_entry_cubage(eentry);
 
 	MDB_val key;
 	key.mv_data = &iid;
 	key.mv_size = sizeof(iid_t);
 
 	MDB_val val;
-	val.mv_data = buf;
+	val.mv_data = NULL;
 	val.mv_size = len;
 
 	assert(txn);
-	int e = mdb_put(txn, s->entries, &key, &val, 0);
+	/*预留空间后直接编码,省去中间缓冲区*/
+	int e = mdb_put(txn, s->entries, &key, &val, MDB_RESERVE);
 
-	free(buf);
+	if (e == 0) {
+		eraft_journal_encode(eentry, val.mv_data, len);
+	}
 
 	if (e != 0) {
 		if (e == MDB_MAP_FULL) {
@@ -235,195 +235,142 @@ static int lmdb_eraft_journal_set(void *handle, void *txn, iid_t iid, struct era
 	return 1;
 }
 
-#if 0
-static iid_t
-lmdb_eraft_journal_get_trim_instance(void *handle)
+/*iid从1开始,键0保存已删除到的iid*/
+static iid_t __get_trim_instance(struct lmdb_eraft_journal *s, MDB_txn *txn)
 {
-	struct lmdb_eraft_journal       *s = handle;
-	int                             result;
-	iid_t                           iid = 0, k = 0;
-	MDB_val                         key, data;
+	iid_t   k = 0;
+	MDB_val key, data;
 
 	key.mv_data = &k;
 	key.mv_size = sizeof(iid_t);
 
-	if ((result = mdb_get(txn, s->entries, &key, &data)) != 0) {
+	int result = mdb_get(txn, s->entries, &key, &data);
+
+	if (result != 0) {
 		if (result != MDB_NOTFOUND) {
-			paxos_log_error("mdb_get failed: %s", mdb_strerror(result));
-			assert(result == 0);
-		} else {
-			iid = 0;
+			printf("mdb_get failed: %s", mdb_strerror(result));
 		}
-	} else {
-		iid = *(iid_t *)data.mv_data;
+
+		return 0;
 	}
 
-	return iid;
+	return *(iid_t *)data.mv_data;
 }
 
-static int
-lmdb_eraft_journal_put_trim_instance(void *handle, iid_t iid)
+static iid_t lmdb_eraft_journal_get_trim_instance(void *handle)
 {
 	struct lmdb_eraft_journal       *s = handle;
-	iid_t                           k = 0;
-	int                             result;
-	MDB_val                         key, data;
+	MDB_txn                         *txn;
 
-	key.mv_data = &k;
-	key.mv_size = sizeof(iid_t);
-
-	data.mv_data = &iid;
-	data.mv_size = sizeof(iid_t);
-
-	result = mdb_put(txn, s->entries, &key, &data, 0);
-
-	if (result != 0) {
-		paxos_log_error("%s\n", mdb_strerror(result));
+	if (mdb_txn_begin(s->db_env, NULL, MDB_RDONLY, &txn) != 0) {
+		return 0;
 	}
 
-	assert(result == 0);
-
-	return 0;
+	iid_t iid = __get_trim_instance(s, txn);
+	mdb_txn_abort(txn);
+	return iid;
 }
 
-static int
-lmdb_eraft_journal_trim(void *handle, iid_t iid)
+static int lmdb_eraft_journal_trim(void *handle, void *txn, iid_t iid)
 {
 	struct lmdb_eraft_journal       *s = handle;
-	int                             result;
-	iid_t                           min = 0;
-	MDB_cursor                      *cursor = NULL;
+	iid_t                           min = __get_trim_instance(s, txn);
 	MDB_val                         key, data;
 
-	if (iid == 0) {
+	if (iid <= min) {
 		return 0;
 	}
 
-	lmdb_eraft_journal_put_trim_instance(handle, iid);
+	key.mv_size = sizeof(iid_t);
 
-	if ((result = mdb_cursor_open(txn, s->entries, &cursor)) != 0) {
-		paxos_log_error("Could not create cursor. %s", mdb_strerror(result));
-		goto cleanup_exit;
-	}
+	/*键不是MDB_INTEGERKEY,游标不按iid顺序;日志从min + 1起连续,删到第一个不存在的iid为止*/
+	for (iid_t k = min + 1; k <= iid; k++) {
+		key.mv_data = &k;
 
-	key.mv_data = &min;
-	key.mv_size = sizeof(iid_t);
+		int result = mdb_del(txn, s->entries, &key, NULL);
 
-	do {
-		if ((result = mdb_cursor_get(cursor, &key, &data, MDB_NEXT)) == 0) {
-			assert(key.mv_size = sizeof(iid_t));
-			min = *(iid_t *)key.mv_data;
-		} else {
-			goto cleanup_exit;
+		if (result == MDB_NOTFOUND) {
+			break;
 		}
 
-		if ((min != 0) && (min <= iid)) {
-			if (mdb_cursor_del(cursor, 0) != 0) {
-				paxos_log_error("mdb_cursor_del failed. %s",
-					mdb_strerror(result));
-				goto cleanup_exit;
-			}
+		if (result != 0) {
+			printf("Could not trim record for iid: %d : %s", k, mdb_strerror(result));
+			return -1;
 		}
-	} while (min <= iid);
-
-cleanup_exit:
-
-	if (cursor) {
-		mdb_cursor_close(cursor);
 	}
 
-	return 0;
-}
+	iid_t k = 0;
+	key.mv_data = &k;
+	data.mv_data = &iid;
+	data.mv_size = sizeof(iid_t);
 
-#endif	/* if 0 */
+	int result = mdb_put(txn, s->entries, &key, &data, 0);
 
-void __pop_newest_log(struct lmdb_eraft_journal *lmdb)
-{
-#ifdef TEST_NETWORK_ONLY
-	return;
-#endif
-	MDB_val k, v;
+	if (result != 0) {
+		printf("Could not save trim instance: %s", mdb_strerror(result));
+		return -1;
+	}
 
-	mdb_pop(lmdb->db_env, lmdb->entries, &k, &v);
+	return 0;
 }
 
-void __pop_oldest_log(struct lmdb_eraft_journal *lmdb)
+static int lmdb_eraft_journal_pop(void *handle, void *txn, iid_t iid)
 {
-#ifdef TEST_NETWORK_ONLY
-	return;
-#endif
-	MDB_val k, v;
-
-	mdb_poll(lmdb->db_env, lmdb->entries, &k, &v);
-}
+	struct lmdb_eraft_journal       *s = handle;
+	MDB_val                         key;
 
-typedef void (*ERAFT_DSTORE_LOAD_COMMIT_LOG_FCB)(struct eraft_journal *journal, raft_entry_t *entry, void *usr);
-/** Load all log entries we have persisted to disk */
-int __load_foreach_append_log(struct lmdb_eraft_journal *lmdb, ERAFT_DSTORE_LOAD_COMMIT_LOG_FCB fcb, void *usr)
-{
-#if 0
-	MDB_cursor      *curs;
-	MDB_txn         *txn;
-	MDB_val         k, v;
-	int             e;
-	int             n_entries = 0;
+	key.mv_size = sizeof(iid_t);
 
-	e = mdb_txn_begin(lmdb->db_env, NULL, MDB_RDONLY, &txn);
+	/*日志连续,删到第一个不存在的iid为止*/
+	for (iid_t k = iid; k; k++) {
+		key.mv_data = &k;
 
-	if (0 != e) {
-		mdb_fatal(e);
-	}
+		int result = mdb_del(txn, s->entries, &key, NULL);
 
-	e = mdb_cursor_open(txn, lmdb->entries, &curs);
+		if (result == MDB_NOTFOUND) {
+			break;
+		}
 
-	if (0 != e) {
-		mdb_fatal(e);
+		if (result != 0) {
+			printf("Could not pop record for iid: %d : %s", k, mdb_strerror(result));
+			return -1;
+		}
 	}
 
-	e = mdb_cursor_get(curs, &k, &v, MDB_FIRST);
-	switch (e)
-	{
-		case 0:
-			break;
+	return 0;
+}
 
-		case MDB_NOTFOUND:
-			return 0;
+/*值在只读事务内直接指向数据库映射,不复制*/
+static int lmdb_eraft_journal_foreach(void *handle, iid_t iid, ERAFT_JOURNAL_FOREACH_FCB fcb, void *usr)
+{
+	struct lmdb_eraft_journal       *s = handle;
+	MDB_txn                         *txn;
+	MDB_val                         key, val;
+	int                             n_entries = 0;
 
-		default:
-			mdb_fatal(e);
+	if (mdb_txn_begin(s->db_env, NULL, MDB_RDONLY, &txn) != 0) {
+		return 0;
 	}
 
-	raft_entry_t ety;
-	ety.id = 0;
-
-	do {
-		if (!(*(int *)k.mv_data & 1)) {
-			/* entry metadata */
-			__deserialize(&ety, v.mv_data, v.mv_size);
-		} else {
-			/* entry data for FSM */
-			ety.data.buf = v.mv_data;
-			ety.data.len = v.mv_size;
-
-			fcb(lmdb, &ety, usr);
-			n_entries++;
-		}
+	key.mv_size = sizeof(iid_t);
 
-		e = mdb_cursor_get(curs, &k, &v, MDB_NEXT);
-	} while (0 == e);
+	/*键不是MDB_INTEGERKEY,游标不按iid顺序,逐个查找*/
+	for (iid_t k = MAX(iid, __get_trim_instance(s, txn) + 1); k; k++) {
+		struct eraft_entry eentry;
 
-	mdb_cursor_close(curs);
+		key.mv_data = &k;
 
-	e = mdb_txn_commit(txn);
+		if ((mdb_get(txn, s->entries, &key, &val) != 0) || (eraft_entry_view(&eentry, val.mv_data, val.mv_size) != 0)) {
+			break;
+		}
 
-	if (0 != e) {
-		mdb_fatal(e);
+		fcb(k, &eentry.entry, usr);
+		n_entries++;
 	}
 
+	mdb_txn_abort(txn);
+
 	return n_entries;
-#else
-	return 0;
-#endif	/* if 0 */
 }
 
 static int lmdb_eraft_journal_set_state(void *handle, char *key, size_t klen, char *val, size_t vlen)
@@ -472,8 +419,10 @@ void eraft_journal_init_lmdb(struct eraft_journal *j, int acceptor_id, char *dbp
 	j->api.tx_abort = lmdb_eraft_journal_tx_abort;
 	j->api.get = lmdb_eraft_journal_get;
 	j->api.set = lmdb_eraft_journal_set;
-	// j->api.trim = lmdb_eraft_journal_trim;
-	// j->api.get_trim_instance = lmdb_eraft_journal_get_trim_instance;
+	j->api.trim = lmdb_eraft_journal_trim;
+	j->api.get_trim_instance = lmdb_eraft_journal_get_trim_instance;
+	j->api.pop = lmdb_eraft_journal_pop;
+	j->api.foreach = lmdb_eraft_journal_foreach;
 
 	j->api.set_state = lmdb_eraft_journal_set_state;
 	j->api.get_state = lmdb_eraft_journal_get_state;
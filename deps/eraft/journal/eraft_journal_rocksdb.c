@@ -186,195 +186,83 @@ static int rocksdb_eraft_journal_set(void *handle, void *txn, iid_t iid, struct
 	return 1;
 }
 
-#if 0
-static iid_t
-rocksdb_eraft_journal_get_trim_instance(void *handle)
-{
-	struct rocksdb_eraft_journal    *s = handle;
-	int                             result;
-	iid_t                           iid = 0, k = 0;
-	MDB_val                         key, data;
-
-	key.mv_data = &k;
-	key.mv_size = sizeof(iid_t);
-
-	if ((result = mdb_get(txn, s->entries, &key, &data)) != 0) {
-		if (result != MDB_NOTFOUND) {
-			paxos_log_error("mdb_get failed: %s", mdb_strerror(result));
-			assert(result == 0);
-		} else {
-			iid = 0;
-		}
-	} else {
-		iid = *(iid_t *)data.mv_data;
-	}
-
-	return iid;
-}
-
-static int
-rocksdb_eraft_journal_put_trim_instance(void *handle, iid_t iid)
+/*iid从1开始,键0保存已删除到的iid*/
+static iid_t rocksdb_eraft_journal_get_trim_instance(void *handle)
 {
 	struct rocksdb_eraft_journal    *s = handle;
 	iid_t                           k = 0;
-	int                             result;
-	MDB_val                         key, data;
-
-	key.mv_data = &k;
-	key.mv_size = sizeof(iid_t);
-
-	data.mv_data = &iid;
-	data.mv_size = sizeof(iid_t);
+	iid_t                           iid = 0;
 
-	result = mdb_put(txn, s->entries, &key, &data, 0);
-
-	if (result != 0) {
-		paxos_log_error("%s\n", mdb_strerror(result));
+	if (rdb_pull(s->rdbs, (const char *)&k, sizeof(iid_t), (char *)&iid, sizeof(iid_t)) != 0) {
+		return 0;
 	}
 
-	assert(result == 0);
-
-	return 0;
+	return iid;
 }
 
-static int
-rocksdb_eraft_journal_trim(void *handle, iid_t iid)
+/*删除加入批次,tx_commit时一起提交*/
+static int rocksdb_eraft_journal_trim(void *handle, void *txn, iid_t iid)
 {
 	struct rocksdb_eraft_journal    *s = handle;
-	int                             result;
-	iid_t                           min = 0;
-	MDB_cursor                      *cursor = NULL;
-	MDB_val                         key, data;
+	iid_t                           min = rocksdb_eraft_journal_get_trim_instance(handle);
 
-	if (iid == 0) {
+	if (iid <= min) {
 		return 0;
 	}
 
-	rocksdb_eraft_journal_put_trim_instance(handle, iid);
-
-	if ((result = mdb_cursor_open(txn, s->entries, &cursor)) != 0) {
-		paxos_log_error("Could not create cursor. %s", mdb_strerror(result));
-		goto cleanup_exit;
-	}
-
-	key.mv_data = &min;
-	key.mv_size = sizeof(iid_t);
-
-	do {
-		if ((result = mdb_cursor_get(cursor, &key, &data, MDB_NEXT)) == 0) {
-			assert(key.mv_size = sizeof(iid_t));
-			min = *(iid_t *)key.mv_data;
-		} else {
-			goto cleanup_exit;
+	/*日志从min + 1起连续,只删除存在的记录,落后很多时不产生大量空删除*/
+	for (iid_t k = min + 1; (k <= iid) && (rdb_exists(s->rdbs, (const char *)&k, sizeof(iid_t)) == 1); k++) {
+		if (rdb_batch_delete(s->rdbs, (const char *)&k, sizeof(iid_t)) != 0) {
+			printf("Could not trim record for iid: %d", k);
+			return -1;
 		}
-
-		if ((min != 0) && (min <= iid)) {
-			if (mdb_cursor_del(cursor, 0) != 0) {
-				paxos_log_error("mdb_cursor_del failed. %s",
-					mdb_strerror(result));
-				goto cleanup_exit;
-			}
-		}
-	} while (min <= iid);
-
-cleanup_exit:
-
-	if (cursor) {
-		mdb_cursor_close(cursor);
 	}
 
-	return 0;
+	iid_t k = 0;
+	return rdb_batch_put(s->rdbs, (const char *)&k, sizeof(iid_t), (const char *)&iid, sizeof(iid_t));
 }
 
-#endif	/* if 0 */
-
-static void __pop_newest_log(struct rocksdb_eraft_journal *rocksdb)
+static int rocksdb_eraft_journal_pop(void *handle, void *txn, iid_t iid)
 {
-#ifdef TEST_NETWORK_ONLY
-	return;
-#endif
-	// MDB_val k, v;
-
-	// mdb_pop(rocksdb->db_env, rocksdb->entries, &k, &v);
-}
+	struct rocksdb_eraft_journal *s = handle;
 
-static void __pop_oldest_log(struct rocksdb_eraft_journal *rocksdb)
-{
-#ifdef TEST_NETWORK_ONLY
-	return;
-#endif
-	// MDB_val k, v;
+	/*日志连续,删到第一个不存在的iid为止*/
+	for (iid_t k = iid; k && (rdb_exists(s->rdbs, (const char *)&k, sizeof(iid_t)) == 1); k++) {
+		if (rdb_batch_delete(s->rdbs, (const char *)&k, sizeof(iid_t)) != 0) {
+			printf("Could not pop record for iid: %d", k);
+			return -1;
+		}
+	}
 
-	// mdb_poll(rocksdb->db_env, rocksdb->entries, &k, &v);
+	return 0;
 }
 
-typedef void (*ERAFT_DSTORE_LOAD_COMMIT_LOG_FCB)(struct eraft_journal *journal, raft_entry_t *entry, void *usr);
-/** Load all log entries we have persisted to disk */
-static int __load_foreach_append_log(struct rocksdb_eraft_journal *rocksdb, ERAFT_DSTORE_LOAD_COMMIT_LOG_FCB fcb, void *usr)
+static int rocksdb_eraft_journal_foreach(void *handle, iid_t iid, ERAFT_JOURNAL_FOREACH_FCB fcb, void *usr)
 {
-#if 0
-	MDB_cursor      *curs;
-	MDB_txn         *txn;
-	MDB_val         k, v;
-	int             e;
-	int             n_entries = 0;
-
-	e = mdb_txn_begin(rocksdb->db_env, NULL, MDB_RDONLY, &txn);
-
-	if (0 != e) {
-		mdb_fatal(e);
-	}
-
-	e = mdb_cursor_open(txn, rocksdb->entries, &curs);
+	struct rocksdb_eraft_journal    *s = handle;
+	int                             n_entries = 0;
 
-	if (0 != e) {
-		mdb_fatal(e);
-	}
+	for (iid_t k = MAX(iid, rocksdb_eraft_journal_get_trim_instance(handle) + 1); k; k++) {
+		struct eraft_entry      eentry;
+		size_t                  vlen = 0;
+		char                    *val = rdb_get(s->rdbs, (const char *)&k, sizeof(iid_t), &vlen);
 
-	e = mdb_cursor_get(curs, &k, &v, MDB_FIRST);
-	switch (e)
-	{
-		case 0:
+		if (NULL == val) {
 			break;
-
-		case MDB_NOTFOUND:
-			return 0;
-
-		default:
-			mdb_fatal(e);
-	}
-
-	raft_entry_t ety;
-	ety.id = 0;
-
-	do {
-		if (!(*(int *)k.mv_data & 1)) {
-			/* entry metadata */
-			__deserialize(&ety, v.mv_data, v.mv_size);
-		} else {
-			/* entry data for FSM */
-			ety.data.buf = v.mv_data;
-			ety.data.len = v.mv_size;
-
-			fcb(rocksdb, &ety, usr);
-			n_entries++;
 		}
 
-		e = mdb_cursor_get(curs, &k, &v, MDB_NEXT);
-	} while (0 == e);
-
-	mdb_cursor_close(curs);
+		if (eraft_entry_view(&eentry, val, vlen) != 0) {
+			rocksdb_free(val);
+			break;
+		}
 
-	e = mdb_txn_commit(txn);
+		fcb(k, &eentry.entry, usr);
+		n_entries++;
 
-	if (0 != e) {
-		mdb_fatal(e);
+		rocksdb_free(val);
 	}
 
 	return n_entries;
-#else
-	return 0;
-#endif	/* if 0 */
 }
 
 static int rocksdb_eraft_journal_set_state(void *handle, char *key, size_t klen, char *val, size_t vlen)
@@ -423,8 +311,10 @@ void eraft_journal_init_rocksdb(struct eraft_journal *j, int acceptor_id, char *
 	j->api.tx_abort = rocksdb_eraft_journal_tx_abort;
 	j->api.get = rocksdb_eraft_journal_get;
 	j->api.set = rocksdb_eraft_journal_set;
-	// j->api.trim = rocksdb_eraft_journal_trim;
-	// j->api.get_trim_instance = rocksdb_eraft_journal_get_trim_instance;
+	j->api.trim = rocksdb_eraft_journal_trim;
+	j->api.get_trim_instance = rocksdb_eraft_journal_get_trim_instance;
+	j->api.pop = rocksdb_eraft_journal_pop;
+	j->api.foreach = rocksdb_eraft_journal_foreach;
 
 	j->api.set_state = rocksdb_eraft_journal_set_state;
 	j->api.get_state = rocksdb_eraft_journal_get_state;
@@ -8,6 +8,7 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <semaphore.h>
 
 #include "usage.h"
 #include "timeopt.h"
@@ -31,34 +32,46 @@ static int __log_apply_wfcb(struct eraft_group *group, struct iovec *new_request
 	return 0;
 }
 
-static int __log_apply_rfcb(struct eraft_group *group, struct iovec *old_requests, int old_count, struct iovec *new_requests, int new_count)
+static int __log_apply_rfcb(struct eraft_group *group, struct iovec *old_requests, int old_count,
+	struct iovec *new_requests, struct eraft_read_result *new_results, int new_count)
 {
 	return 0;
 }
 
 static char g_send_data[4 << 10] = { 0 };
 // static char g_send_data[256] = {0};
+static struct iovec g_request = { .iov_base = (void *)g_send_data, .iov_len = sizeof(g_send_data) };
+
+#define MAX_TEST_CLI    8
+#define MAX_TEST_REQ    (4096 * 2000 / MAX_TEST_CLI)
+#define MAX_TEST_WIN    4096	/*同时在途的请求数*/
+
+static sem_t g_window;
+
+static void _on_write_done(struct iovec *request, int result, int idx, void *usr)
+{
+	sem_post(&g_window);
+}
+
 static void *_start_test(void *usr)
 {
 #ifdef TEST_TWO_NET
 	int *idx = (int *)usr;
 #endif
 
-	for (int i = 0; i < 2000; i++) {
-		struct iovec request = { .iov_base = (void *)g_send_data, .iov_len = sizeof(g_send_data) };
+	for (int i = 0; i < MAX_TEST_REQ; i++) {
+		sem_wait(&g_window);
 
-		/* block until the request is committed */
+		/* return at once, _on_write_done is called when the request is committed */
 #ifdef TEST_TWO_NET
 		if (*idx % 2) {
-			erapi_write_request(g_serv.eraft_ctx, g_opts.cluster, &request);
+			erapi_write_request_async(g_serv.eraft_ctx, g_opts.cluster, &g_request, _on_write_done, NULL);
 		} else {
-			erapi_write_request(g_serv.eraft_ctx2, "192.168.108.108:8000,192.168.108.109:8001,192.168.108.110:8002", &request);
+			erapi_write_request_async(g_serv.eraft_ctx2, "192.168.108.108:8000,192.168.108.109:8001,192.168.108.110:8002", &g_request, _on_write_done, NULL);
 		}
 #else
-		erapi_write_request(g_serv.eraft_ctx, g_opts.cluster, &request);
+		erapi_write_request_async(g_serv.eraft_ctx, g_opts.cluster, &g_request, _on_write_done, NULL);
 #endif
-		// usleep(100);
-		// printf("???????????????????????\n");
 	}
 
 	return NULL;
@@ -70,7 +83,8 @@ void test_iops(void)
 
 	time_now(&beg);
 
-#define MAX_TEST_CLI 4096
+	sem_init(&g_window, 0, MAX_TEST_WIN);
+
 	pthread_t       ptids[MAX_TEST_CLI] = { 0 };
 	int             idx[MAX_TEST_CLI] = { 0 };
 
@@ -85,10 +99,21 @@ void test_iops(void)
 		}
 	}
 
+	/*等待所有在途请求完成*/
+	for (int i = 0; i < MAX_TEST_WIN; i++) {
+		sem_wait(&g_window);
+	}
+
+	sem_destroy(&g_window);
+
 	struct timespec end;
 	time_now(&end);
 
 	printf("test use (%ld)!\n", time_diff(&beg, &end));
+
+	struct eraft_slab_stat stat;
+	erapi_get_slab_stat(&stat);
+	printf("slab allocs %lu frees %lu remote %lu sys %lu\n", stat.allocs, stat.frees, stat.remote_frees, stat.sys_allocs);
 }
 
 static void _int_handler(int dummy)
@@ -0,0 +1,84 @@
+/*
+ * etask完成对象的往返测试.
+ * legacy: 每次调用创建eventfd, poll等待后关闭, 与旧的etask_make(NULL)相同.
+ * pooled: etask_make(NULL)从池中取futex对象.
+ * 系统调用个数可用 strace -c -f ./etask_bench 对比.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "etask.h"
+
+#define MAX_TEST_REQ (200 * 1000)
+
+struct bench_slot
+{
+	struct etask    *volatile etask;
+	struct etask    *ready;	/*通知对端有新任务*/
+};
+
+static struct bench_slot g_slot;
+
+static void *_peer(void *usr)
+{
+	for (int i = 0; i < MAX_TEST_REQ * 2; i++) {
+		etask_sleep(g_slot.ready);
+		etask_awake(g_slot.etask);
+	}
+
+	return NULL;
+}
+
+static long _now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+static void _run(const char *name, bool pooled)
+{
+	struct rusage   ru0, ru1;
+	long            start = _now_usec();
+
+	getrusage(RUSAGE_SELF, &ru0);
+
+	for (int i = 0; i < MAX_TEST_REQ; i++) {
+		struct etask    legacy;
+		struct etask    *etask = pooled ? etask_make(NULL) : etask_make(&legacy);
+
+		g_slot.etask = etask;
+		etask_awake(g_slot.ready);
+		etask_sleep(etask);
+		etask_free(etask);
+	}
+
+	getrusage(RUSAGE_SELF, &ru1);
+	long usec = _now_usec() - start;
+
+	printf("%-8s %8.0f ns/op  %6ld vcsw  %6ld ivcsw\n", name, usec * 1000.0 / MAX_TEST_REQ,
+		ru1.ru_nvcsw - ru0.ru_nvcsw, ru1.ru_nivcsw - ru0.ru_nivcsw);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t pid;
+
+	g_slot.ready = etask_make(NULL);
+	pthread_create(&pid, NULL, _peer, NULL);
+
+	_run("legacy", false);
+	_run("pooled", true);
+
+	pthread_join(pid, NULL);
+	etask_free(g_slot.ready);
+
+	printf("pool size %d\n", etask_pool_size());
+	return 0;
+}
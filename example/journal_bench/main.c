@@ -0,0 +1,109 @@
+/*
+ * 各日志存储的写入与随机读取对比.
+ * write: 每批batch条日志一个事务, 与__set_append_log_batch相同.
+ * get: 随机读取已写入的日志, 模拟follower追日志.
+ * 用法: ./journal_bench [path] [entries] [size] [batch]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "eraft_journal.h"
+#include "eraft_journal_ext.h"
+
+static long _now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+static void _run(const char *name, enum ERAFT_JOURNAL_TYPE type, char *path, int entries, int size, int batch)
+{
+	struct eraft_journal    journal;
+	char                    *data = malloc(size);
+
+	memset(data, 'x', size);
+
+	eraft_journal_init(&journal, 0, path, 1UL << 32, type);
+
+	if (eraft_journal_open(&journal) != 0) {
+		printf("%-8s open failed\n", name);
+		eraft_journal_free(&journal);
+		free(data);
+		return;
+	}
+
+	long start = _now_usec();
+
+	for (int i = 1; i <= entries; i += batch) {
+		void *txn = eraft_journal_tx_begin(&journal);
+
+		for (int j = i; j < i + batch && j <= entries; j++) {
+			struct eraft_entry eentry;
+			memset(&eentry, 0, sizeof(eentry));
+			eentry.iid = j;
+			eentry.entry.term = 1;
+			eentry.entry.id = j;
+			eentry.entry.data.buf = data;
+			eentry.entry.data.len = size;
+
+			eraft_journal_set_record(&journal, txn, j, &eentry);
+		}
+
+		eraft_journal_tx_commit(&journal, txn);
+	}
+
+	long    wusec = _now_usec() - start;
+	int     found = 0;
+
+	srand(entries);
+	start = _now_usec();
+
+	for (int i = 0; i < entries; i++) {
+		struct eraft_entry      eentry;
+		void                    *txn = eraft_journal_tx_begin(&journal);
+
+		if (eraft_journal_get_record(&journal, txn, 1 + rand() % entries, &eentry)) {
+			free(eentry.entry.data.buf);
+			found++;
+		}
+
+		eraft_journal_tx_commit(&journal, txn);
+	}
+
+	long rusec = _now_usec() - start;
+
+	printf("%-8s write %8.0f entries/s %8.1f MB/s  get %8.0f entries/s  found %d/%d\n", name,
+		entries * 1000000.0 / wusec, (double)entries * size / wusec,
+		entries * 1000000.0 / rusec, found, entries);
+
+	eraft_journal_close(&journal);
+	eraft_journal_free(&journal);
+	free(data);
+}
+
+int main(int argc, char **argv)
+{
+	char    *path = (argc > 1) ? argv[1] : "/tmp/journal_bench";
+	int     entries = (argc > 2) ? atoi(argv[2]) : 100000;
+	int     size = (argc > 3) ? atoi(argv[3]) : 256;
+	int     batch = (argc > 4) ? atoi(argv[4]) : 64;
+	char    dbpath[256];
+
+	snprintf(dbpath, sizeof(dbpath), "%s_default", path);
+	_run("default", ERAFT_JOURNAL_TYPE_DEFAULT, dbpath, entries, size, batch);
+
+	snprintf(dbpath, sizeof(dbpath), "%s_lmdb", path);
+	_run("lmdb", ERAFT_JOURNAL_TYPE_LMDB, dbpath, entries, size, batch);
+
+	snprintf(dbpath, sizeof(dbpath), "%s_rocksdb", path);
+	_run("rocksdb", ERAFT_JOURNAL_TYPE_ROCKSDB, dbpath, entries, size, batch);
+
+	snprintf(dbpath, sizeof(dbpath), "%s_bdb", path);
+	_run("bdb", ERAFT_JOURNAL_TYPE_BDB, dbpath, entries, size, batch);
+
+	return 0;
+}
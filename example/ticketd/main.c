@@ -142,7 +142,8 @@ static int __log_apply_wfcb(struct eraft_group *group, struct iovec *new_request
 	return 0;
 }
 
-static int __log_apply_rfcb(struct eraft_group *group, struct iovec *old_requests, int old_count, struct iovec *new_requests, int new_count)
+static int __log_apply_rfcb(struct eraft_group *group, struct iovec *old_requests, int old_count,
+	struct iovec *new_requests, struct eraft_read_result *new_results, int new_count)
 {
 #if 0
 	assert(entry->data.len == sizeof(unsigned int));